@@ -0,0 +1,114 @@
+/*
+ * compare heap allocations of "make_shared per accept" with RecyclePool
+ * the payload mirrors HTTPConnection's members
+ */
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <service/RecyclePool.hpp>
+#include <service/TimingWheel.hpp>
+#include <string>
+#include <unordered_map>
+
+static std::atomic<std::size_t> g_allocations{0};
+
+void *operator new(std::size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::malloc(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+void *operator new(std::size_t size, std::align_val_t align) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::aligned_alloc(static_cast<std::size_t>(align),
+                                     (size + static_cast<std::size_t>(align) -
+                                      1) &
+                                         ~(static_cast<std::size_t>(align) -
+                                           1))) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+
+struct BenchConnection {
+  BenchConnection(boost::asio::io_context &ioc) : socket(ioc) {}
+
+  /*simulate one request/response cycle*/
+  void serve() {
+    auto buf = buffer.prepare(512);
+    std::memset(buf.data(), 'x', buf.size());
+    buffer.commit(buf.size());
+    boost::beast::ostream(request.body()) << "{\"email\":\"a@b.c\"}";
+    boost::beast::ostream(response.body()) << "{\"error\":0}";
+    params.emplace("k", "v");
+  }
+
+  void recycle() {
+    buffer.consume(buffer.size());
+    request.body().clear();
+    response.body().clear();
+    params.clear();
+  }
+
+  boost::asio::ip::tcp::socket socket;
+  boost::beast::flat_buffer buffer{8192};
+  boost::beast::http::request<boost::beast::http::dynamic_body> request;
+  boost::beast::http::response<boost::beast::http::dynamic_body> response;
+  connection::TimerNode deadline;
+  std::unordered_map<std::string, std::string> params;
+};
+
+template <typename _Func>
+static void report(const char *name, std::size_t rounds, _Func &&func) {
+  auto start_alloc = g_allocations.load();
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < rounds; ++i) {
+    func();
+  }
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+  auto allocs = g_allocations.load() - start_alloc;
+  std::printf("%-12s rounds=%zu allocations=%zu (%.2f/conn) %.1f ns/conn\n",
+              name, rounds, allocs, static_cast<double>(allocs) / rounds,
+              static_cast<double>(ns) / rounds);
+}
+
+int main(int argc, char **argv) {
+  const std::size_t rounds = argc > 1 ? std::strtoull(argv[1], nullptr, 10)
+                                      : 100000;
+  boost::asio::io_context ioc;
+
+  report("make_shared", rounds, [&ioc]() {
+    auto conn = std::make_shared<BenchConnection>(ioc);
+    conn->serve();
+  });
+
+  connection::RecyclePool<BenchConnection> pool(64);
+
+  /*warm up, so the pool owns one connection and its buffers*/
+  pool.acquire(ioc)->serve();
+
+  report("RecyclePool", rounds, [&ioc, &pool]() {
+    auto conn = pool.acquire(ioc);
+    conn->serve();
+  });
+
+  auto stat = pool.statistic();
+  std::printf("pool created=%zu reused=%zu recycled=%zu dropped=%zu idle=%zu\n",
+              stat.created, stat.reused, stat.recycled, stat.dropped,
+              stat.idle);
+  return 0;
+}
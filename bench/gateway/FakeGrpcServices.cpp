@@ -0,0 +1,76 @@
+#include <FakeGrpcServices.hpp>
+#include <thread>
+
+namespace {
+std::atomic<std::size_t> g_calls{0};
+
+void simulateLatency(std::chrono::microseconds delay) {
+  g_calls.fetch_add(1, std::memory_order_relaxed);
+  if (delay.count() > 0) {
+    std::this_thread::sleep_for(delay);
+  }
+}
+} // namespace
+
+bench::FakeVerificationService::FakeVerificationService(
+    FakeRedisServer &redis, std::chrono::microseconds delay)
+    : m_redis(redis), m_delay(delay) {}
+
+grpc::Status bench::FakeVerificationService::GetVerificationCode(
+    grpc::ServerContext *context,
+    const message::GetVerificationRequest *request,
+    message::GetVerificationResponse *response) {
+  simulateLatency(m_delay);
+  m_redis.set(request->email(), verification_code);
+  response->set_error(0);
+  response->set_email(request->email());
+  response->set_message(verification_code);
+  return grpc::Status::OK;
+}
+
+bench::FakeBalancerService::FakeBalancerService(
+    std::chrono::microseconds delay)
+    : m_delay(delay) {}
+
+grpc::Status bench::FakeBalancerService::AddNewUserToServer(
+    grpc::ServerContext *context, const message::RegisterToBalancer *request,
+    message::GetAllocatedChattingServer *response) {
+  simulateLatency(m_delay);
+  response->set_error(0);
+  response->set_host("127.0.0.1");
+  response->set_port("8090");
+  response->set_token("bench-token-" + std::to_string(request->uuid()));
+  return grpc::Status::OK;
+}
+
+grpc::Status bench::FakeBalancerService::UserLoginToServer(
+    grpc::ServerContext *context, const message::LoginChattingServer *request,
+    message::LoginChattingResponse *response) {
+  simulateLatency(m_delay);
+  response->set_error(0);
+  return grpc::Status::OK;
+}
+
+bench::FakeGrpcServer::FakeGrpcServer(FakeRedisServer &redis,
+                                      std::chrono::microseconds delay)
+    : m_verification(redis, delay), m_balancer(delay), m_port(0) {
+  grpc::ServerBuilder builder;
+  builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(),
+                           &m_port);
+  builder.RegisterService(&m_verification);
+  builder.RegisterService(&m_balancer);
+  m_server = builder.BuildAndStart();
+}
+
+bench::FakeGrpcServer::~FakeGrpcServer() { stop(); }
+
+std::size_t bench::FakeGrpcServer::calls() const {
+  return g_calls.load(std::memory_order_relaxed);
+}
+
+void bench::FakeGrpcServer::stop() {
+  if (m_server) {
+    m_server->Shutdown();
+    m_server.reset();
+  }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#ifndef _FAKEGRPCSERVICES_HPP_
+#define _FAKEGRPCSERVICES_HPP_
+#include <FakeRedisServer.hpp>
+#include <atomic>
+#include <chrono>
+#include <grpcpp/grpcpp.h>
+#include <memory>
+#include <message/message.grpc.pb.h>
+
+namespace bench {
+/*every email receives the same code, load generator posts it back*/
+inline constexpr const char *verification_code = "123456";
+
+/*stands for captcha-server, stores the code into redis like the real one*/
+class FakeVerificationService final
+    : public message::VerificationService::Service {
+public:
+  FakeVerificationService(FakeRedisServer &redis,
+                          std::chrono::microseconds delay);
+
+  grpc::Status
+  GetVerificationCode(grpc::ServerContext *context,
+                      const message::GetVerificationRequest *request,
+                      message::GetVerificationResponse *response) override;
+
+private:
+  FakeRedisServer &m_redis;
+  std::chrono::microseconds m_delay;
+};
+
+/*stands for balance-server, always allocates the same chatting server*/
+class FakeBalancerService final : public message::BalancerService::Service {
+public:
+  explicit FakeBalancerService(std::chrono::microseconds delay);
+
+  grpc::Status
+  AddNewUserToServer(grpc::ServerContext *context,
+                     const message::RegisterToBalancer *request,
+                     message::GetAllocatedChattingServer *response) override;
+
+  grpc::Status
+  UserLoginToServer(grpc::ServerContext *context,
+                    const message::LoginChattingServer *request,
+                    message::LoginChattingResponse *response) override;
+
+private:
+  std::chrono::microseconds m_delay;
+};
+
+/*both services share one grpc server listening on loopback*/
+class FakeGrpcServer {
+public:
+  FakeGrpcServer(FakeRedisServer &redis, std::chrono::microseconds delay =
+                                             std::chrono::microseconds(0));
+  ~FakeGrpcServer();
+
+  unsigned short port() const { return static_cast<unsigned short>(m_port); }
+
+  /*requests served by the fake services*/
+  std::size_t calls() const;
+
+  void stop();
+
+private:
+  FakeVerificationService m_verification;
+  FakeBalancerService m_balancer;
+  int m_port;
+  std::unique_ptr<grpc::Server> m_server;
+};
+} // namespace bench
+
+#endif // !_FAKEGRPCSERVICES_HPP_
@@ -0,0 +1,261 @@
+#include <FakeRedisServer.hpp>
+#include <algorithm>
+#include <cctype>
+#include <redis/RedisScript.hpp>
+
+namespace {
+std::string simple(std::string_view status) {
+  return "+" + std::string(status) + "\r\n";
+}
+std::string error(std::string_view message) {
+  return "-ERR " + std::string(message) + "\r\n";
+}
+std::string integer(long long value) {
+  return ":" + std::to_string(value) + "\r\n";
+}
+std::string bulk(const std::string &value) {
+  return "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n";
+}
+std::string nil() { return "$-1\r\n"; }
+} // namespace
+
+bench::FakeRedisServer::FakeRedisServer(unsigned short port,
+                                        std::chrono::microseconds delay)
+    : m_acceptor(m_ioc, boost::asio::ip::tcp::endpoint(
+                            boost::asio::ip::address_v4::loopback(), port)),
+      m_delay(delay) {
+  acceptLoop();
+  m_accept_thread = std::thread([this]() { m_ioc.run(); });
+}
+
+bench::FakeRedisServer::~FakeRedisServer() { stop(); }
+
+unsigned short bench::FakeRedisServer::port() const {
+  return m_acceptor.local_endpoint().port();
+}
+
+void bench::FakeRedisServer::set(const std::string &key,
+                                 const std::string &value) {
+  std::lock_guard<std::mutex> _lckg(m_mtx);
+  m_strings[key] = value;
+}
+
+void bench::FakeRedisServer::stop() {
+  if (!m_accept_thread.joinable()) {
+    return;
+  }
+
+  /*blocking accept() can't be interrupted, so accepting is asynchronous*/
+  boost::asio::post(m_ioc, [this]() {
+    boost::system::error_code ec;
+    m_acceptor.close(ec);
+  });
+  m_accept_thread.join();
+
+  {
+    std::lock_guard<std::mutex> _lckg(m_clients_mtx);
+    for (auto &client : m_clients) {
+      boost::system::error_code ec;
+      client.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+    }
+  }
+  for (auto &worker : m_workers) {
+    worker.join();
+  }
+}
+
+void bench::FakeRedisServer::acceptLoop() {
+  m_acceptor.async_accept([this](boost::system::error_code ec,
+                                 boost::asio::ip::tcp::socket socket) {
+    if (ec) {
+      return;
+    }
+    socket.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+
+    boost::asio::ip::tcp::socket *client = nullptr;
+    {
+      std::lock_guard<std::mutex> _lckg(m_clients_mtx);
+      client = &m_clients.emplace_back(std::move(socket));
+    }
+
+    /*every client is served synchronously by its own thread*/
+    m_workers.emplace_back(&FakeRedisServer::serve, this, client);
+    acceptLoop();
+  });
+}
+
+void bench::FakeRedisServer::serve(boost::asio::ip::tcp::socket *socket) {
+  boost::asio::streambuf buffer;
+  argv_type argv;
+  boost::system::error_code ec;
+
+  while (readCommand(*socket, buffer, argv)) {
+    std::string reply = execute(argv);
+    if (m_delay.count() > 0) {
+      std::this_thread::sleep_for(m_delay);
+    }
+    boost::asio::write(*socket, boost::asio::buffer(reply), ec);
+    if (ec) {
+      break;
+    }
+  }
+  socket->close(ec);
+}
+
+bool bench::FakeRedisServer::readCommand(boost::asio::ip::tcp::socket &socket,
+                                         boost::asio::streambuf &buffer,
+                                         argv_type &argv) {
+  boost::system::error_code ec;
+  std::istream is(&buffer);
+  auto read_line = [&](std::string &line) {
+    boost::asio::read_until(socket, buffer, "\r\n", ec);
+    if (ec) {
+      return false;
+    }
+    std::getline(is, line);
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    return true;
+  };
+
+  std::string line;
+  if (!read_line(line) || line.empty() || line[0] != '*') {
+    return false;
+  }
+
+  std::size_t count = std::stoul(line.substr(1));
+  argv.clear();
+  argv.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    if (!read_line(line) || line.empty() || line[0] != '$') {
+      return false;
+    }
+    std::size_t length = std::stoul(line.substr(1));
+
+    /*payload and trailing CRLF*/
+    if (buffer.size() < length + 2) {
+      boost::asio::read(socket, buffer,
+                        boost::asio::transfer_exactly(length + 2 -
+                                                      buffer.size()),
+                        ec);
+      if (ec) {
+        return false;
+      }
+    }
+    std::string arg(length, '\0');
+    is.read(arg.data(), static_cast<std::streamsize>(length));
+    is.ignore(2);
+    argv.push_back(std::move(arg));
+  }
+  return true;
+}
+
+std::string bench::FakeRedisServer::execute(argv_type &argv) {
+  if (argv.empty()) {
+    return error("empty command");
+  }
+  std::string &cmd = argv[0];
+  std::transform(cmd.begin(), cmd.end(), cmd.begin(),
+                 [](unsigned char c) { return std::toupper(c); });
+
+  std::lock_guard<std::mutex> _lckg(m_mtx);
+  if (cmd == "AUTH" || cmd == "SELECT") {
+    return simple("OK");
+  } else if (cmd == "PING") {
+    return simple("PONG");
+  } else if (cmd == "SET" && argv.size() >= 3) {
+    m_strings[argv[1]] = argv[2];
+    return simple("OK");
+  } else if (cmd == "GET" && argv.size() == 2) {
+    auto it = m_strings.find(argv[1]);
+    return it == m_strings.end() ? nil() : bulk(it->second);
+  } else if (cmd == "DEL" || cmd == "EXISTS") {
+    long long count = 0;
+    for (std::size_t i = 1; i < argv.size(); ++i) {
+      bool found = m_strings.count(argv[i]) || m_hashes.count(argv[i]) ||
+                   m_lists.count(argv[i]);
+      if (found && cmd == "DEL") {
+        m_strings.erase(argv[i]);
+        m_hashes.erase(argv[i]);
+        m_lists.erase(argv[i]);
+      }
+      count += found;
+    }
+    return integer(count);
+  } else if (cmd == "HSET" && argv.size() == 4) {
+    bool created = m_hashes[argv[1]].insert_or_assign(argv[2], argv[3]).second;
+    return integer(created);
+  } else if (cmd == "HGET" && argv.size() == 3) {
+    auto it = m_hashes.find(argv[1]);
+    if (it == m_hashes.end()) {
+      return nil();
+    }
+    auto field = it->second.find(argv[2]);
+    return field == it->second.end() ? nil() : bulk(field->second);
+  } else if (cmd == "HDEL" && argv.size() == 3) {
+    auto it = m_hashes.find(argv[1]);
+    return integer(it == m_hashes.end() ? 0 : it->second.erase(argv[2]));
+  } else if ((cmd == "LPUSH" || cmd == "RPUSH") && argv.size() == 3) {
+    auto &list = m_lists[argv[1]];
+    if (cmd == "LPUSH") {
+      list.push_front(argv[2]);
+    } else {
+      list.push_back(argv[2]);
+    }
+    return integer(static_cast<long long>(list.size()));
+  } else if ((cmd == "LPOP" || cmd == "RPOP") && argv.size() == 2) {
+    auto it = m_lists.find(argv[1]);
+    if (it == m_lists.end() || it->second.empty()) {
+      return nil();
+    }
+    std::string value;
+    if (cmd == "LPOP") {
+      value = std::move(it->second.front());
+      it->second.pop_front();
+    } else {
+      value = std::move(it->second.back());
+      it->second.pop_back();
+    }
+    return bulk(value);
+  } else if (cmd == "SCRIPT" && argv.size() == 3) {
+    for (const auto *script : redis::RedisScript::registered()) {
+      if (script->source() == argv[2]) {
+        m_scripts.emplace(script->sha());
+        return bulk(std::string(script->sha()));
+      }
+    }
+    return error("script is not emulated");
+  } else if (cmd == "EVALSHA" && argv.size() >= 4) {
+    if (m_scripts.count(argv[1]) == 0) {
+      return "-NOSCRIPT No matching script. Please use EVAL.\r\n";
+    }
+    return evalScript(argv[1], argv);
+  } else if (cmd == "EVAL" && argv.size() >= 4) {
+    for (const auto *script : redis::RedisScript::registered()) {
+      if (script->source() == argv[1]) {
+        m_scripts.emplace(script->sha());
+        return evalScript(script->sha(), argv);
+      }
+    }
+    return error("script is not emulated");
+  }
+  return error("unknown command '" + cmd + "'");
+}
+
+std::string bench::FakeRedisServer::evalScript(std::string_view sha,
+                                               argv_type &argv) {
+  /*argv: EVAL/EVALSHA, script, numkeys, KEYS[1], ARGV...*/
+  if (sha == redis::scripts::compare_and_swap.sha() && argv.size() == 6) {
+    auto it = m_strings.find(argv[3]);
+    if (it == m_strings.end()) {
+      return integer(-1);
+    }
+    if (it->second != argv[4]) {
+      return integer(0);
+    }
+    it->second = argv[5];
+    return integer(1);
+  }
+  return error("script is not emulated");
+}
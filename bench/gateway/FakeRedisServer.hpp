@@ -0,0 +1,71 @@
+#pragma once
+#ifndef _FAKEREDISSERVER_HPP_
+#define _FAKEREDISSERVER_HPP_
+#include <boost/asio.hpp>
+#include <chrono>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace bench {
+/*
+ * in-process RESP2 server which understands the commands issued by
+ * redis::RedisContext, every client connection is served by its own thread
+ */
+class FakeRedisServer {
+public:
+  /*port 0 picks an ephemeral port, delay simulates network round trip*/
+  explicit FakeRedisServer(
+      unsigned short port = 0,
+      std::chrono::microseconds delay = std::chrono::microseconds(0));
+  ~FakeRedisServer();
+
+  unsigned short port() const;
+
+  /*seed or overwrite a string key*/
+  void set(const std::string &key, const std::string &value);
+
+  void stop();
+
+private:
+  using argv_type = std::vector<std::string>;
+
+  void acceptLoop();
+  void serve(boost::asio::ip::tcp::socket *socket);
+
+  /*parse one RESP array of bulk strings*/
+  static bool readCommand(boost::asio::ip::tcp::socket &socket,
+                          boost::asio::streambuf &buffer, argv_type &argv);
+  std::string execute(argv_type &argv);
+
+  /*scripts can't be run, known ones are emulated*/
+  std::string evalScript(std::string_view sha, argv_type &argv);
+
+private:
+  boost::asio::io_context m_ioc;
+  boost::asio::ip::tcp::acceptor m_acceptor;
+  std::chrono::microseconds m_delay;
+
+  std::thread m_accept_thread;
+  std::mutex m_clients_mtx;
+  std::list<boost::asio::ip::tcp::socket> m_clients;
+  std::vector<std::thread> m_workers;
+
+  /*in-memory keyspace*/
+  std::mutex m_mtx;
+  std::unordered_map<std::string, std::string> m_strings;
+  std::unordered_map<std::string, std::unordered_map<std::string, std::string>>
+      m_hashes;
+  std::unordered_map<std::string, std::deque<std::string>> m_lists;
+
+  /*sha1 of scripts loaded by SCRIPT LOAD or EVAL*/
+  std::unordered_set<std::string> m_scripts;
+};
+} // namespace bench
+
+#endif // !_FAKEREDISSERVER_HPP_
@@ -0,0 +1,111 @@
+#include <LoadGenerator.hpp>
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <thread>
+
+bench::LoadGenerator::LoadGenerator(LoadOptions options,
+                                    std::vector<Route> routes)
+    : m_options(options), m_routes(std::move(routes)) {
+  for (const auto &route : m_routes) {
+    m_results.push_back(std::make_unique<RouteResult>());
+    m_results.back()->target = route.target;
+  }
+}
+
+double bench::LoadGenerator::run() {
+  m_start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> workers;
+  for (std::size_t i = 0; i < m_options.connections; ++i) {
+    workers.emplace_back(&LoadGenerator::worker, this, i);
+  }
+
+  std::this_thread::sleep_for(m_options.warmup);
+  m_measuring = true;
+  auto measure_start = std::chrono::steady_clock::now();
+
+  std::this_thread::sleep_for(m_options.duration);
+  m_measuring = false;
+  auto elapsed = std::chrono::steady_clock::now() - measure_start;
+
+  m_stop = true;
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  return std::chrono::duration<double>(elapsed).count();
+}
+
+void bench::LoadGenerator::worker(std::size_t index) {
+  using clock = std::chrono::steady_clock;
+
+  /*open loop: this worker owns 1/connections of the target rate*/
+  const auto interval = std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>(
+          static_cast<double>(m_options.connections) / m_options.rate));
+  auto scheduled = m_start + interval * static_cast<long>(index) /
+                                 static_cast<long>(m_options.connections);
+
+  /*spread routes across workers, every route is hit in turn*/
+  for (std::size_t seq = index; !m_stop; seq += m_options.connections) {
+    std::size_t which = seq % m_routes.size();
+    const Route &route = m_routes[which];
+    std::string body = route.body ? route.body(seq) : std::string{};
+
+    clock::time_point start = clock::now();
+    if (m_options.open_loop) {
+      std::this_thread::sleep_until(scheduled);
+      start = scheduled;
+      scheduled += interval;
+    }
+
+    bool ok = send(route, body);
+    auto latency = clock::now() - start;
+
+    if (m_measuring) {
+      auto &result = *m_results[which];
+      result.requests.fetch_add(1, std::memory_order_relaxed);
+      if (!ok) {
+        result.errors.fetch_add(1, std::memory_order_relaxed);
+      }
+      result.latency.observe(latency);
+    }
+  }
+}
+
+bool bench::LoadGenerator::send(const Route &route, const std::string &body) {
+  namespace http = boost::beast::http;
+  thread_local boost::asio::io_context ioc;
+
+  boost::system::error_code ec;
+  boost::asio::ip::tcp::socket socket(ioc);
+  socket.connect({boost::asio::ip::address_v4::loopback(), m_options.port},
+                 ec);
+  if (ec) {
+    return false;
+  }
+
+  http::request<http::string_body> req{
+      route.post ? http::verb::post : http::verb::get, route.target, 11};
+  req.set(http::field::host, "127.0.0.1");
+  req.set(http::field::content_type, "application/json");
+  req.body() = body;
+  req.prepare_payload();
+  http::write(socket, req, ec);
+  if (ec) {
+    return false;
+  }
+
+  boost::beast::flat_buffer buffer;
+  http::response<http::string_body> res;
+  http::read(socket, buffer, res, ec);
+  socket.close(ec);
+  if (res.result() != http::status::ok) {
+    return false;
+  }
+
+  /*handlers answer 200 with a non-zero "error" field on failure*/
+  const std::string &text = res.body();
+  auto pos = text.find("\"error\":");
+  return pos == std::string::npos || text.compare(pos + 8, 1, "0") == 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#ifndef _LOADGENERATOR_HPP_
+#define _LOADGENERATOR_HPP_
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <metrics/MetricsRegistry.hpp>
+#include <string>
+#include <vector>
+
+namespace bench {
+struct Route {
+  std::string target;
+  bool post = true;
+
+  /*build request body of the n-th request sent to this route*/
+  std::function<std::string(std::size_t)> body;
+};
+
+struct LoadOptions {
+  /*
+   * closed loop: every connection sends the next request after a response
+   * open loop: requests are scheduled at a fixed rate, latency is measured
+   * from the scheduled time so queueing delay is not hidden
+   */
+  bool open_loop = false;
+  std::size_t connections = 16;
+  std::chrono::seconds duration{10};
+  std::chrono::seconds warmup{1};
+  double rate = 1000.0; // requests per second, open loop only
+  unsigned short port = 8080;
+};
+
+struct RouteResult {
+  std::string target;
+  std::atomic<std::size_t> requests{0};
+  std::atomic<std::size_t> errors{0};
+  metrics::Histogram latency;
+};
+
+/*HTTP/1.1 short connections, one request per TCP connection like clients*/
+class LoadGenerator {
+public:
+  LoadGenerator(LoadOptions options, std::vector<Route> routes);
+
+  /*blocks until duration elapsed, returns measured seconds*/
+  double run();
+
+  const std::vector<std::unique_ptr<RouteResult>> &results() const {
+    return m_results;
+  }
+
+private:
+  void worker(std::size_t index);
+
+  /*returns false on transport, HTTP or service error*/
+  bool send(const Route &route, const std::string &body);
+
+private:
+  LoadOptions m_options;
+  std::vector<Route> m_routes;
+  std::vector<std::unique_ptr<RouteResult>> m_results;
+
+  std::atomic<bool> m_measuring{false};
+  std::atomic<bool> m_stop{false};
+  std::chrono::steady_clock::time_point m_start;
+};
+} // namespace bench
+
+#endif // !_LOADGENERATOR_HPP_
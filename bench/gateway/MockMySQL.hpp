@@ -0,0 +1,24 @@
+#pragma once
+#ifndef _MOCKMYSQL_HPP_
+#define _MOCKMYSQL_HPP_
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+/*
+ * MockMySQLConnection.cpp replaces src/MySQLConnection.cpp inside
+ * gateway_bench, every MySQLConnection shares one in-memory Authentication
+ * table, so no MySQL server(or container) is required
+ */
+namespace bench {
+void seedUser(const std::string &username, const std::string &password,
+              const std::string &email);
+
+/*sleep inside every query to simulate database round trip*/
+void setMySQLDelay(std::chrono::microseconds delay);
+
+/*queries served by the mock*/
+std::size_t mysqlQueries();
+} // namespace bench
+
+#endif // !_MOCKMYSQL_HPP_
@@ -0,0 +1,241 @@
+#include <MockMySQL.hpp>
+#include <atomic>
+#include <mutex>
+#include <service/IOServicePool.hpp>
+#include <shared_mutex>
+#include <sql/AccountFilter.hpp>
+#include <sql/MySQLConnectionPool.hpp>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+struct Account {
+  std::string password;
+  std::string email;
+  std::size_t uuid;
+};
+
+/*Authentication table*/
+struct Table {
+  std::shared_mutex mtx;
+  std::unordered_map<std::string, Account> by_username;
+  std::unordered_map<std::size_t, std::string> by_uuid;
+  std::unordered_set<std::string> emails;
+  std::size_t next_uuid = 1;
+};
+
+Table &table() {
+  static Table instance;
+  return instance;
+}
+
+std::atomic<long long> g_delay_us{0};
+std::atomic<std::size_t> g_queries{0};
+
+/*every public method costs one round trip*/
+void query() {
+  g_queries.fetch_add(1, std::memory_order_relaxed);
+  auto delay = g_delay_us.load(std::memory_order_relaxed);
+  if (delay > 0) {
+    std::this_thread::sleep_for(std::chrono::microseconds(delay));
+  }
+}
+
+std::size_t insert(Table &t, const std::string &username,
+                   const std::string &password, const std::string &email) {
+  std::size_t uuid = t.next_uuid++;
+  t.by_username[username] = Account{password, email, uuid};
+  t.by_uuid[uuid] = username;
+  t.emails.insert(email);
+  return uuid;
+}
+} // namespace
+
+void bench::seedUser(const std::string &username, const std::string &password,
+                     const std::string &email) {
+  auto &t = table();
+  std::unique_lock<std::shared_mutex> _lckg(t.mtx);
+  insert(t, username, password, email);
+}
+
+void bench::setMySQLDelay(std::chrono::microseconds delay) {
+  g_delay_us.store(delay.count(), std::memory_order_relaxed);
+}
+
+std::size_t bench::mysqlQueries() {
+  return g_queries.load(std::memory_order_relaxed);
+}
+
+mysql::MySQLConnection::MySQLConnection(
+    std::string_view username, std::string_view password,
+    std::string_view database, std::string_view host, std::string_view port,
+    mysql::MySQLConnectionPool *shared) noexcept
+    : m_delegator(std::shared_ptr<mysql::MySQLConnectionPool>(
+          shared, [](mysql::MySQLConnectionPool *) {})),
+      ctx(IOServicePool::get_instance()->getIOServiceContext()),
+      ssl_ctx(boost::asio::ssl::context::tls_client),
+      conn(ctx.get_executor(), ssl_ctx),
+      last_operation_time(std::chrono::steady_clock::now()), m_valid(true),
+      m_ping_armed(std::make_shared<std::atomic<bool>>(false)),
+      m_ping_timer(ctx) {}
+
+/*never connected, nothing to close*/
+mysql::MySQLConnection::~MySQLConnection() {}
+
+bool mysql::MySQLConnection::isValid() const { return m_valid; }
+
+std::optional<std::string>
+mysql::MySQLConnection::getPasswordHash(std::string_view username) {
+  query();
+  auto &t = table();
+  std::shared_lock<std::shared_mutex> _lckg(t.mtx);
+  auto it = t.by_username.find(std::string(username));
+  if (it == t.by_username.end()) {
+    return std::nullopt;
+  }
+  return it->second.password;
+}
+
+bool mysql::MySQLConnection::checkAccountAvailability(std::string_view username,
+                                                      std::string_view email) {
+  auto filter = AccountFilter::get_instance();
+  if (!filter->mayContain(username, email)) {
+    return false;
+  }
+
+  query();
+  auto &t = table();
+  std::shared_lock<std::shared_mutex> _lckg(t.mtx);
+  auto it = t.by_username.find(std::string(username));
+  if (it == t.by_username.end() || it->second.email != email) {
+    filter->falsePositive();
+    return false;
+  }
+  return true;
+}
+
+bool mysql::MySQLConnection::registerNewUser(MySQLRequestStruct &&request) {
+  if (checkAccountAvailability(request.m_username, request.m_email)) {
+    return false;
+  }
+
+  query();
+  auto &t = table();
+  std::unique_lock<std::shared_mutex> _lckg(t.mtx);
+  std::string username(request.m_username);
+  if (t.by_username.count(username) == 0) {
+    insert(t, username, std::string(request.m_password),
+           std::string(request.m_email));
+  }
+  AccountFilter::get_instance()->insert(request.m_username, request.m_email);
+  m_delegator->markWritten(request.m_username);
+  return true;
+}
+
+std::vector<std::optional<std::size_t>>
+mysql::MySQLConnection::registerNewUsers(
+    const std::vector<MySQLRequestStruct> &requests) {
+  /*availability SELECT, INSERT and uuid SELECT for the whole batch*/
+  query();
+  query();
+  query();
+
+  std::vector<std::optional<std::size_t>> uuids(requests.size());
+  auto &t = table();
+  std::unique_lock<std::shared_mutex> _lckg(t.mtx);
+  for (std::size_t i = 0; i < requests.size(); ++i) {
+    std::string username(requests[i].m_username);
+    std::string email(requests[i].m_email);
+
+    /*taken pairs are found by the SELECT, other clashes by UNIQUE indexes*/
+    if (t.by_username.count(username) != 0 || t.emails.count(email) != 0) {
+      continue;
+    }
+    uuids[i] = insert(t, username, std::string(requests[i].m_password), email);
+    AccountFilter::get_instance()->insert(username, email);
+    m_delegator->markWritten(username);
+    m_delegator->m_cache->uuid.put(username, *uuids[i]);
+    m_delegator->m_cache->username.put(*uuids[i], username);
+  }
+  return uuids;
+}
+
+bool mysql::MySQLConnection::alterUserPassword(MySQLRequestStruct &&request) {
+  if (!checkAccountAvailability(request.m_username, request.m_email)) {
+    return false;
+  }
+
+  query();
+  auto &t = table();
+  std::unique_lock<std::shared_mutex> _lckg(t.mtx);
+  t.by_username[std::string(request.m_username)].password =
+      std::string(request.m_password);
+  m_delegator->markWritten(request.m_username);
+  return true;
+}
+
+bool mysql::MySQLConnection::checkUUID(std::size_t uuid) {
+  if (m_delegator->m_cache->username.get(uuid).has_value()) {
+    return true;
+  }
+
+  query();
+  auto &t = table();
+  std::shared_lock<std::shared_mutex> _lckg(t.mtx);
+  return t.by_uuid.count(uuid) != 0;
+}
+
+std::optional<std::size_t>
+mysql::MySQLConnection::getUUIDByUsername(std::string_view username) {
+  auto cached = m_delegator->m_cache->uuid.get(username);
+  if (cached.has_value()) {
+    return cached;
+  }
+
+  query();
+  auto &t = table();
+  std::shared_lock<std::shared_mutex> _lckg(t.mtx);
+  auto it = t.by_username.find(std::string(username));
+  if (it == t.by_username.end()) {
+    return std::nullopt;
+  }
+  m_delegator->m_cache->uuid.put(it->first, it->second.uuid);
+  m_delegator->m_cache->username.put(it->second.uuid, it->first);
+  return it->second.uuid;
+}
+
+std::optional<std::string>
+mysql::MySQLConnection::getUsernameByUUID(std::size_t uuid) {
+  auto cached = m_delegator->m_cache->username.get(uuid);
+  if (cached.has_value()) {
+    return cached;
+  }
+
+  query();
+  auto &t = table();
+  std::shared_lock<std::shared_mutex> _lckg(t.mtx);
+  auto it = t.by_uuid.find(uuid);
+  if (it == t.by_uuid.end()) {
+    return std::nullopt;
+  }
+  m_delegator->m_cache->uuid.put(it->second, uuid);
+  m_delegator->m_cache->username.put(uuid, it->second);
+  return it->second;
+}
+
+bool mysql::MySQLConnection::streamAccounts(
+    const std::function<void(std::string_view, std::string_view)>
+        &callback) {
+  query();
+  auto &t = table();
+  std::shared_lock<std::shared_mutex> _lckg(t.mtx);
+  for (const auto &[username, account] : t.by_username) {
+    callback(username, account.email);
+  }
+  return true;
+}
+
+void mysql::MySQLConnection::updateTimer() {
+  last_operation_time = std::chrono::steady_clock::now();
+}
@@ -0,0 +1,264 @@
+/*
+ * end-to-end load test of GatewayServer, every backend is an in-process
+ * stand-in: fake gRPC verification/balancer services, fake RESP server and
+ * an in-memory MySQLConnection
+ *
+ * gateway_bench [--open-loop] [--rate N] [--connections N] [--duration S]
+ *               [--route /path] [--backend-delay US] [--port P]
+ *               [--scrypt-cost N] [--registration-batch]
+ *
+ * login, registration and password reset hash passwords with scrypt, lower
+ * --scrypt-cost to measure the gateway itself instead of the hashing.
+ * --registration-batch inserts concurrent registrations by one statement
+ */
+#include <FakeGrpcServices.hpp>
+#include <FakeRedisServer.hpp>
+#include <LoadGenerator.hpp>
+#include <MockMySQL.hpp>
+#include <atomic>
+#include <config/ServerConfig.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <grpc/BalanceServicePool.hpp>
+#include <grpc/VerificationServicePool.hpp>
+#include <log/LogManager.hpp>
+#include <new>
+#include <redis/RedisManager.hpp>
+#include <server/GateServer.hpp>
+#include <service/CPUWorkerPool.hpp>
+#include <service/IOServicePool.hpp>
+#include <sql/AccountFilter.hpp>
+#include <sql/MySQLConnectionPool.hpp>
+#include <sql/RegistrationBatcher.hpp>
+#include <tools/PasswordHash.hpp>
+
+/*only allocations made on gateway io threads are counted*/
+static thread_local bool t_gateway_thread = false;
+static std::atomic<std::size_t> g_allocations{0};
+
+void *operator new(std::size_t size) {
+  if (t_gateway_thread) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (void *ptr = std::malloc(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+static constexpr std::size_t seeded_users = 1000;
+
+static std::vector<bench::Route> makeRoutes(bench::FakeRedisServer &redis) {
+  auto user = [](std::size_t n) {
+    return "user" + std::to_string(n % seeded_users);
+  };
+
+  std::vector<bench::Route> routes;
+  routes.push_back({"/get_verification", true, [](std::size_t n) {
+                      return R"({"email":"verify)" + std::to_string(n) +
+                             R"(@bench.local"})";
+                    }});
+  routes.push_back({"/post_registration", true, [&redis](std::size_t n) {
+                      std::string name = "reg" + std::to_string(n);
+                      std::string email = name + "@bench.local";
+
+                      /*captcha-server would have stored this code*/
+                      redis.set(email, bench::verification_code);
+                      return R"({"username":")" + name +
+                             R"(","password":"passwd","email":")" + email +
+                             R"(","cpatcha":")" + bench::verification_code +
+                             R"("})";
+                    }});
+  routes.push_back({"/check_accountexists", true, [user](std::size_t n) {
+                      return R"({"username":")" + user(n) +
+                             R"(","email":")" + user(n) + R"(@bench.local"})";
+                    }});
+  routes.push_back({"/reset_password", true, [user](std::size_t n) {
+                      return R"({"username":")" + user(n) +
+                             R"(","password":"passwd","email":")" + user(n) +
+                             R"(@bench.local"})";
+                    }});
+  routes.push_back({"/trylogin_server", true, [user](std::size_t n) {
+                      return R"({"username":")" + user(n) +
+                             R"(","password":"passwd"})";
+                    }});
+  routes.push_back({"/metrics", false, nullptr});
+  return routes;
+}
+
+int main(int argc, char **argv) {
+  bench::LoadOptions options;
+  std::string only_route;
+  std::chrono::microseconds backend_delay{0};
+  options.port = 18080;
+  auto config = ServerConfig::get_instance();
+
+  for (int i = 1; i < argc; ++i) {
+    auto next = [&]() { return i + 1 < argc ? argv[++i] : "0"; };
+    if (!std::strcmp(argv[i], "--open-loop")) {
+      options.open_loop = true;
+    } else if (!std::strcmp(argv[i], "--rate")) {
+      options.rate = std::atof(next());
+    } else if (!std::strcmp(argv[i], "--connections")) {
+      options.connections = std::strtoull(next(), nullptr, 10);
+    } else if (!std::strcmp(argv[i], "--duration")) {
+      options.duration = std::chrono::seconds(std::atoi(next()));
+    } else if (!std::strcmp(argv[i], "--route")) {
+      only_route = next();
+    } else if (!std::strcmp(argv[i], "--backend-delay")) {
+      backend_delay = std::chrono::microseconds(std::atoi(next()));
+    } else if (!std::strcmp(argv[i], "--port")) {
+      options.port = static_cast<unsigned short>(std::atoi(next()));
+    } else if (!std::strcmp(argv[i], "--scrypt-cost")) {
+      config->Password_scrypt_cost = std::strtoull(next(), nullptr, 10);
+    } else if (!std::strcmp(argv[i], "--registration-batch")) {
+      config->RegistrationBatch_enabled = true;
+    } else {
+      std::fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  /*backends have to be ready before gateway pools connect to them*/
+  bench::FakeRedisServer redis(0, backend_delay);
+  bench::FakeGrpcServer grpc_server(redis, backend_delay);
+  bench::setMySQLDelay(backend_delay);
+
+  /*every seeded user shares one hash, computing a thousand takes too long*/
+  auto hashed = tools::hashPassword(
+      "passwd",
+      tools::ScryptParams{static_cast<uint8_t>(config->Password_scrypt_cost),
+                          static_cast<uint32_t>(
+                              config->Password_scrypt_block_size),
+                          static_cast<uint32_t>(
+                              config->Password_scrypt_parallelism)});
+  if (!hashed.has_value()) {
+    std::fprintf(stderr, "scrypt failed\n");
+    return 1;
+  }
+  for (std::size_t i = 0; i < seeded_users; ++i) {
+    std::string name = "user" + std::to_string(i);
+    bench::seedUser(name, *hashed, name + "@bench.local");
+  }
+
+  config->GateServerPort = options.port;
+  config->Redis_ip_addr = "127.0.0.1";
+  config->Redis_port = redis.port();
+  config->VerificationServerAddress =
+      "127.0.0.1:" + std::to_string(grpc_server.port());
+  config->BalanceServiceAddress = "127.0.0.1";
+  config->BalanceServicePort = std::to_string(grpc_server.port());
+  config->Log_level = config->Log_http_level = config->Log_redis_level =
+      config->Log_mysql_level = config->Log_grpc_level = "warn";
+
+  /*every client comes from 127.0.0.1 and reuses the seeded usernames*/
+  config->RateLimit_enabled = false;
+
+  [[maybe_unused]] auto &log = logger::LogManager::get_instance();
+  auto &service_pool = IOServicePool::get_instance();
+  auto &cpu_pool = CPUWorkerPool::get_instance();
+
+  /*same parallel warmup as main.cpp*/
+  std::vector<std::future<void>> warmups;
+  warmups.push_back(std::async(std::launch::async, []() {
+    mysql::MySQLConnectionPool::get_instance()->warmup();
+  }));
+  warmups.push_back(std::async(std::launch::async, []() {
+    redis::RedisConnectionPool::get_instance()->warmup();
+  }));
+  warmups.push_back(std::async(std::launch::async, []() {
+    stubpool::VerificationServicePool::get_instance()->warmup();
+  }));
+  warmups.push_back(std::async(std::launch::async, []() {
+    stubpool::BalancerServicePool::get_instance()->warmup();
+  }));
+  for (auto &warmup : warmups) {
+    warmup.get();
+  }
+  mysql::AccountFilter::get_instance()->load();
+
+  /*mark every io thread, getIOServiceContext() visits them in turn*/
+  std::vector<std::future<void>> marked;
+  for (std::size_t i = 0; i < service_pool->size(); ++i) {
+    auto task = std::make_shared<std::packaged_task<void()>>(
+        []() { t_gateway_thread = true; });
+    marked.push_back(task->get_future());
+    boost::asio::post(service_pool->getIOServiceContext(),
+                      [task]() { (*task)(); });
+  }
+  for (auto &f : marked) {
+    f.wait();
+  }
+
+  auto server = std::make_shared<GateServer>(
+      service_pool->getIOServiceContext(), options.port);
+
+  std::vector<bench::Route> routes;
+  for (auto &route : makeRoutes(redis)) {
+    if (only_route.empty() || route.target == only_route) {
+      routes.push_back(std::move(route));
+    }
+  }
+  if (routes.empty()) {
+    std::fprintf(stderr, "no such route %s\n", only_route.c_str());
+    return 1;
+  }
+
+  std::printf("mode=%s connections=%zu duration=%llds backend_delay=%lldus",
+              options.open_loop ? "open" : "closed", options.connections,
+              static_cast<long long>(options.duration.count()),
+              static_cast<long long>(backend_delay.count()));
+  if (options.open_loop) {
+    std::printf(" rate=%.0f/s", options.rate);
+  }
+  std::printf("\n");
+
+  bench::LoadGenerator generator(options, routes);
+
+  /*warmup requests are not counted, allocations neither*/
+  std::thread reset([&]() {
+    std::this_thread::sleep_for(options.warmup);
+    g_allocations = 0;
+  });
+  double seconds = generator.run();
+  reset.join();
+  std::size_t allocations = g_allocations.load();
+
+  std::printf("%-22s %10s %8s %10s %9s %9s %9s\n", "route", "requests",
+              "errors", "req/s", "p50(ms)", "p99(ms)", "p999(ms)");
+  std::size_t total = 0;
+  for (const auto &result : generator.results()) {
+    auto snap = result->latency.snapshot();
+    std::size_t requests = result->requests.load();
+    total += requests;
+    std::printf("%-22s %10zu %8zu %10.0f %9.3f %9.3f %9.3f\n",
+                result->target.c_str(), requests, result->errors.load(),
+                requests / seconds, snap.percentile(0.5) / 1000.0,
+                snap.percentile(0.99) / 1000.0,
+                snap.percentile(0.999) / 1000.0);
+  }
+  std::printf("total %zu requests, %.0f req/s, %.1f allocations/request "
+              "(gateway io threads)\n",
+              total, total / seconds,
+              total ? static_cast<double>(allocations) / total : 0.0);
+
+  /*same order as SIGTERM in main.cpp*/
+  server->stopAccept();
+  server->drain(std::chrono::seconds(1));
+  cpu_pool->shutdown();
+  mysql::RegistrationBatcher::get_instance()->shutdown();
+  service_pool->shutdown();
+  mysql::MySQLConnectionPool::get_instance()->shutdown();
+
+  /*~GateServer logs, destroy it before spdlog is shut down*/
+  server.reset();
+  grpc_server.stop();
+  redis.stop();
+  logger::LogManager::get_instance()->shutdown();
+  spdlog::shutdown();
+  return 0;
+}
@@ -0,0 +1,225 @@
+/*
+ * microbenchmarks of hot-path building blocks, every case runs in isolation
+ * so a regression points at one component
+ *
+ * micro_bench --benchmark_filter=<regex>
+ */
+#include <FakeRedisServer.hpp>
+#include <benchmark/benchmark.h>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <boost/uuid/uuid_generators.hpp>
+#include <boost/uuid/uuid_io.hpp>
+#include <config/ServerConfig.hpp>
+#include <handler/HandleMethod.hpp>
+#include <http/HttpConnection.hpp>
+#include <http/HttpConnectionPool.hpp>
+#include <json/json.h>
+#include <redis/RedisReplyRAII.hpp>
+#include <service/ConnectionPool.hpp>
+#include <service/IOServicePool.hpp>
+#include <cstring>
+#include <string>
+
+namespace {
+struct BenchStub {
+  std::size_t id;
+};
+
+class BenchPool : public connection::ConnectionPool<BenchPool, BenchStub> {
+  friend class Singleton<BenchPool>;
+  BenchPool() {
+    for (std::size_t i = 0; i < m_queue_size; ++i) {
+      m_stub_queue.push_back(std::make_unique<BenchStub>(BenchStub{i}));
+    }
+  }
+};
+
+/*request bodies posted by clients, keep in sync with HandleMethod*/
+const std::pair<const char *, const char *> payloads[] = {
+    {"/get_verification", R"({"email":"someone@example.com"})"},
+    {"/post_registration",
+     R"({"username":"someone","password":"passwd","email":)"
+     R"("someone@example.com","cpatcha":"123456"})"},
+    {"/check_accountexists",
+     R"({"username":"someone","email":"someone@example.com"})"},
+    {"/reset_password",
+     R"({"username":"someone","password":"passwd","email":)"
+     R"("someone@example.com"})"},
+    {"/trylogin_server", R"({"username":"someone","password":"passwd"})"}};
+
+const char raw_request[] =
+    "POST /trylogin_server HTTP/1.1\r\n"
+    "Host: 127.0.0.1:8080\r\n"
+    "User-Agent: Qt/6.5\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: 42\r\n"
+    "\r\n"
+    R"({"username":"someone","password":"passwd"})";
+} // namespace
+
+/*ConnectionPool acquire + release, contention grows with threads*/
+static void BM_ConnectionPool_AcquireRelease(benchmark::State &state) {
+  auto &pool = BenchPool::get_instance();
+  for (auto _ : state) {
+    auto stub = pool->acquire();
+    benchmark::DoNotOptimize(stub);
+    pool->release(std::move(stub.value()));
+  }
+}
+BENCHMARK(BM_ConnectionPool_AcquireRelease)->ThreadRange(1, 16)->UseRealTime();
+
+/*what Session used to cost on every accept, kept as a baseline*/
+static void BM_Accept_SessionUUID(benchmark::State &state) {
+  for (auto _ : state) {
+    std::string uuid =
+        boost::uuids::to_string(boost::uuids::random_generator()());
+    benchmark::DoNotOptimize(uuid);
+  }
+}
+BENCHMARK(BM_Accept_SessionUUID);
+
+/*Session is gone, accept takes a recycled HTTPConnection instead*/
+static void BM_Accept_RecycledConnection(benchmark::State &state) {
+  auto &ioc = IOServicePool::get_instance()->getIOServiceContext();
+  for (auto _ : state) {
+    auto conn = HTTPConnectionPool::get_instance()->acquire(ioc);
+    benchmark::DoNotOptimize(conn);
+  }
+}
+BENCHMARK(BM_Accept_RecycledConnection);
+
+static void BM_HandleMethod_DispatchMiss(benchmark::State &state) {
+  auto &handler = HandleMethod::get_instance();
+  std::shared_ptr<HTTPConnection> none;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(handler->handlePostMethod("/not_found", none));
+  }
+}
+BENCHMARK(BM_HandleMethod_DispatchMiss);
+
+/*/metrics never touches a backend, so the whole route can run here*/
+static void BM_HandleMethod_DispatchMetrics(benchmark::State &state) {
+  auto &handler = HandleMethod::get_instance();
+  auto &ioc = IOServicePool::get_instance()->getIOServiceContext();
+  for (auto _ : state) {
+    auto conn = HTTPConnectionPool::get_instance()->acquire(ioc);
+    benchmark::DoNotOptimize(handler->handleGetMethod("/metrics", conn));
+  }
+}
+BENCHMARK(BM_HandleMethod_DispatchMetrics);
+
+/*same reader settings as HandleMethod::parseJson*/
+static void BM_Json_Parse(benchmark::State &state) {
+  const char *body = payloads[state.range(0)].second;
+  const std::size_t length = std::strlen(body);
+  std::unique_ptr<Json::CharReader> reader(
+      Json::CharReaderBuilder().newCharReader());
+
+  for (auto _ : state) {
+    Json::Value root;
+    benchmark::DoNotOptimize(
+        reader->parse(body, body + length, &root, nullptr));
+  }
+  state.SetLabel(payloads[state.range(0)].first);
+  state.SetBytesProcessed(state.iterations() * length);
+}
+BENCHMARK(BM_Json_Parse)->DenseRange(0, std::size(payloads) - 1);
+
+/*same writer settings as HandleMethod::writeJson*/
+static void BM_Json_Serialize(benchmark::State &state) {
+  Json::StreamWriterBuilder builder;
+  builder["indentation"] = "";
+  std::unique_ptr<Json::StreamWriter> writer(builder.newStreamWriter());
+
+  Json::Value root;
+  root["error"] = 0;
+  root["uuid"] = "1024";
+  root["host"] = "127.0.0.1";
+  root["port"] = "8090";
+  root["token"] = "3fa85f64-5717-4562-b3fc-2c963f66afa6";
+
+  boost::beast::multi_buffer body;
+  for (auto _ : state) {
+    body.consume(body.size());
+    auto os = boost::beast::ostream(body);
+    writer->write(root, &os);
+  }
+}
+BENCHMARK(BM_Json_Serialize);
+
+/*parse into the same arena-backed parser type HTTPConnection uses*/
+static void BM_HTTP_ParseRequest(benchmark::State &state) {
+  std::byte storage[4096];
+  for (auto _ : state) {
+    std::pmr::monotonic_buffer_resource arena(storage, sizeof(storage));
+    HTTPConnection::request_parser parser(
+        std::piecewise_construct,
+        std::make_tuple(HTTPConnection::arena_allocator(&arena)),
+        std::make_tuple(HTTPConnection::arena_allocator(&arena)));
+    parser.eager(true);
+
+    boost::system::error_code ec;
+    parser.put(boost::asio::buffer(raw_request, sizeof(raw_request) - 1), ec);
+    benchmark::DoNotOptimize(parser.is_done());
+  }
+  state.SetBytesProcessed(state.iterations() * (sizeof(raw_request) - 1));
+}
+BENCHMARK(BM_HTTP_ParseRequest);
+
+static void BM_HTTP_SerializeResponse(benchmark::State &state) {
+  namespace http = boost::beast::http;
+  http::response<http::dynamic_body> res{http::status::ok, 11};
+  res.set(http::field::server, "Beast GateServer");
+  res.set(http::field::content_type, "text/json");
+  res.keep_alive(false);
+  boost::beast::ostream(res.body())
+      << R"({"error":0,"host":"127.0.0.1","port":"8090","token":"x"})";
+  res.prepare_payload();
+
+  for (auto _ : state) {
+    http::serializer<false, http::dynamic_body> sr{res};
+    boost::system::error_code ec;
+    std::size_t bytes = 0;
+    do {
+      sr.next(ec, [&](boost::system::error_code &, const auto &buffers) {
+        bytes += boost::asio::buffer_size(buffers);
+        sr.consume(boost::asio::buffer_size(buffers));
+      });
+    } while (!ec && !sr.is_done());
+    benchmark::DoNotOptimize(bytes);
+  }
+}
+BENCHMARK(BM_HTTP_SerializeResponse);
+
+/*
+ * RedisReply can only be filled by a real command, so this includes one
+ * loopback round trip to the in-process RESP server
+ */
+static void BM_RedisReply_GetMessage(benchmark::State &state) {
+  static bench::FakeRedisServer server;
+  server.set("bench", "123456");
+  redis::RedisContext context("127.0.0.1", server.port(), "");
+
+  for (auto _ : state) {
+    redis::RedisReply reply;
+    reply.redisCommand(context, std::string("GET %s"), "bench");
+    benchmark::DoNotOptimize(reply.getType());
+    benchmark::DoNotOptimize(reply.getMessage());
+  }
+}
+BENCHMARK(BM_RedisReply_GetMessage);
+
+int main(int argc, char **argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  /*io threads have to be joined before static singletons are destroyed*/
+  IOServicePool::get_instance()->shutdown();
+  return 0;
+}
@@ -0,0 +1,66 @@
+/*
+ * arm and cancel N connection deadlines
+ * one steady_timer per connection vs one TimingWheel per io_context
+ */
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <service/TimingWheel.hpp>
+#include <vector>
+
+template <typename _Func>
+static void report(const char *name, std::size_t count, _Func &&func) {
+  auto start = std::chrono::steady_clock::now();
+  func();
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+  std::printf("%-12s connections=%zu %.1f ns per arm+rearm+cancel\n", name,
+              count, static_cast<double>(ns) / count);
+}
+
+int main(int argc, char **argv) {
+  const std::size_t count =
+      argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+  boost::asio::io_context ioc;
+
+  std::vector<std::unique_ptr<boost::asio::steady_timer>> timers;
+  timers.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    timers.push_back(std::make_unique<boost::asio::steady_timer>(ioc));
+  }
+
+  report("steady_timer", count, [&timers]() {
+    for (auto &timer : timers) {
+      timer->expires_after(std::chrono::seconds(10));
+      timer->async_wait([](boost::system::error_code) {});
+    }
+    for (auto &timer : timers) {
+      timer->expires_after(std::chrono::seconds(30));
+      timer->async_wait([](boost::system::error_code) {});
+    }
+    for (auto &timer : timers) {
+      timer->cancel();
+    }
+  });
+  ioc.poll();
+
+  connection::TimingWheel wheel(ioc, std::chrono::milliseconds(100), 512);
+  std::unique_ptr<connection::TimerNode[]> nodes(
+      new connection::TimerNode[count]);
+
+  report("TimingWheel", count, [&wheel, &nodes, count]() {
+    for (std::size_t i = 0; i < count; ++i) {
+      wheel.arm(nodes[i], std::chrono::seconds(10));
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+      wheel.arm(nodes[i], std::chrono::seconds(30));
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+      wheel.cancel(nodes[i]);
+    }
+  });
+  return 0;
+}
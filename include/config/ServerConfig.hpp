@@ -11,6 +11,43 @@ public:
   ~ServerConfig() = default;
   unsigned short GateServerPort;
 
+  /*max idle HTTPConnection objects kept by each io_context*/
+  std::size_t GateServer_connection_pool_capacity;
+
+  /*initial block size of per-request arena inside HTTPConnection*/
+  std::size_t GateServer_request_arena_size;
+
+  /*timing wheel of each io_context, tick(ms) * slots = one rotation*/
+  std::size_t GateServer_timer_tick_ms;
+  std::size_t GateServer_timer_slots;
+
+  /*deadline of each HTTPConnection phase(ms)*/
+  std::size_t GateServer_header_timeout_ms;
+  std::size_t GateServer_body_timeout_ms;
+  std::size_t GateServer_handler_timeout_ms;
+  std::size_t GateServer_write_timeout_ms;
+
+  /*request size limits(bytes)*/
+  std::size_t GateServer_header_limit;
+  std::size_t GateServer_body_limit;
+
+  /*
+   * minimum body throughput(bytes per second), checked after grace period
+   * the body must not stall for longer than grace period either
+   */
+  std::size_t GateServer_min_body_rate;
+  std::size_t GateServer_body_rate_grace_ms;
+
+  /*how long SIGTERM waits for in-flight requests(ms)*/
+  std::size_t GateServer_drain_timeout_ms;
+
+  /*
+   * unix socket used to hand the listening socket over to a new process,
+   * keep it in a directory only this user can enter. empty disables hot
+   * restart
+   */
+  std::string GateServer_handoff_path;
+
   std::string VerificationServerAddress;
 
   std::string MySQL_host;
@@ -27,6 +64,140 @@ public:
   std::string BalanceServiceAddress;
   std::string BalanceServicePort;
 
+  /*async logger queue(messages) and overflow policy, block or overrun*/
+  std::size_t Log_queue_size;
+  std::string Log_overflow;
+  std::string Log_file;
+
+  /*default level and per-subsystem levels*/
+  std::string Log_level;
+  std::string Log_http_level;
+  std::string Log_redis_level;
+  std::string Log_mysql_level;
+  std::string Log_grpc_level;
+
+  /*log 1 of N requests, and at most M request logs per second*/
+  std::size_t Log_request_sample_rate;
+  std::size_t Log_request_rate_limit;
+
+  /*request tracing, sample_rate of new traces is between 0 and 1*/
+  bool Trace_enabled;
+  double Trace_sample_rate;
+  std::size_t Trace_ring_size;
+  std::size_t Trace_flush_interval_ms;
+  std::string Trace_file;
+
+  /*
+   * adaptive concurrency limit of route handlers, limit moves between
+   * min_limit and max_limit once per window(ms), 0 means twice the amount
+   * of io threads. normal and low priority routes only occupy their share
+   */
+  bool Admission_enabled;
+  std::size_t Admission_initial_limit;
+  std::size_t Admission_min_limit;
+  std::size_t Admission_max_limit;
+  std::size_t Admission_window_ms;
+  std::size_t Admission_long_window;
+  double Admission_smoothing;
+  double Admission_tolerance;
+  double Admission_normal_share;
+  double Admission_low_share;
+  std::size_t Admission_retry_after;
+
+  /*
+   * token buckets per client ip, email and username, rate is tokens per
+   * second and 0 disables that key. buckets are shared through redis when
+   * RateLimit_redis is true
+   */
+  bool RateLimit_enabled;
+  bool RateLimit_redis;
+  std::size_t RateLimit_max_keys;
+  double RateLimit_ip_rate;
+  double RateLimit_ip_burst;
+  double RateLimit_email_rate;
+  double RateLimit_email_burst;
+  double RateLimit_username_rate;
+  double RateLimit_username_burst;
+
+  /*
+   * identical requests arriving within this window(ms) after a backend call
+   * finished reuse its result, 0 only coalesces calls still running
+   */
+  std::size_t SingleFlight_verification_window;
+  std::size_t SingleFlight_account_window;
+
+  /*
+   * bloom filter of every username and email, sized for capacity accounts.
+   * only accounts created through this gateway are added after startup, so
+   * disable it when several gateways register users into one database
+   */
+  bool AccountFilter_enabled;
+  std::size_t AccountFilter_capacity;
+  std::size_t AccountFilter_bits_per_key;
+
+  /*entries of username -> uuid and of uuid -> username, 0 disables them*/
+  std::size_t AccountCache_capacity;
+
+  /*password hashing threads(0 means one per core) and their queue*/
+  std::size_t CPUWorker_threads;
+  std::size_t CPUWorker_queue_limit;
+
+  /*scrypt N = 2^cost, r = block_size, p = parallelism*/
+  std::size_t Password_scrypt_cost;
+  std::size_t Password_scrypt_block_size;
+  std::size_t Password_scrypt_parallelism;
+
+  /*
+   * backend pools dial their connections in parallel. lazy pools only dial
+   * minimum connections at startup and the rest on first use
+   */
+  bool Warmup_lazy;
+  std::size_t Warmup_minimum;
+  std::size_t Warmup_connect_timeout_ms;
+
+  /*broken connections are dialed again after jittered exponential backoff*/
+  std::size_t Reconnect_initial_backoff_ms;
+  std::size_t Reconnect_max_backoff_ms;
+
+  /*max wait for a healthy connection(ms), 0 waits forever*/
+  std::size_t Reconnect_acquire_timeout_ms;
+
+  /*
+   * MySQL read replicas, "host:port,host:port". empty sends every query to
+   * primary. reads of a username written within sticky window(ms) stay on
+   * primary until replicas caught up
+   */
+  std::string Replica_hosts;
+  std::size_t Replica_sticky_window_ms;
+  std::size_t Replica_sticky_capacity;
+
+  /*
+   * Redis Cluster, keys are sent to the node owning their hash slot.
+   * seeds "host:port,host:port" fall back to [Redis] host and port
+   */
+  bool RedisCluster_enabled;
+  std::string RedisCluster_seeds;
+  std::size_t RedisCluster_max_redirects;
+  std::size_t RedisCluster_refresh_interval_ms;
+
+  /*
+   * client side caching of GETs, kept coherent by RESP3 invalidation pushes.
+   * prefixes "a:,b:" names the hot keys, tracking stays off without one.
+   * an idle tracking connection is PINGed every ping_interval(ms)
+   */
+  bool RedisTracking_enabled;
+  std::string RedisTracking_prefixes;
+  std::size_t RedisTracking_max_bytes;
+  std::size_t RedisTracking_ping_interval_ms;
+
+  /*
+   * group commit of registrations, rows queued within window(ms) or up to
+   * max rows are inserted by one multi-row INSERT
+   */
+  bool RegistrationBatch_enabled;
+  std::size_t RegistrationBatch_max_rows;
+  std::size_t RegistrationBatch_window_ms;
+
 private:
   ServerConfig() {
     m_ini.load(CONFIG_HOME "config.ini");
@@ -35,10 +206,53 @@ private:
     loadMySQLInfo();
     loadRedisInfo();
     loadBalanceServiceInfo();
+    loadLogInfo();
+    loadTraceInfo();
+    loadAdmissionInfo();
+    loadRateLimitInfo();
+    loadSingleFlightInfo();
+    loadAccountFilterInfo();
+    loadAccountCacheInfo();
+    loadCPUWorkerInfo();
+    loadPasswordInfo();
+    loadWarmupInfo();
+    loadReconnectInfo();
+    loadReplicaInfo();
+    loadRedisClusterInfo();
+    loadRedisTrackingInfo();
+    loadRegistrationBatchInfo();
   }
 
   void loadGateServerInfo() {
     GateServerPort = m_ini["GateServer"]["port"].as<unsigned short>();
+    GateServer_connection_pool_capacity = loadOrDefault<std::size_t>(
+        "GateServer", "connection_pool_capacity", 1024);
+    GateServer_request_arena_size = loadOrDefault<std::size_t>(
+        "GateServer", "request_arena_size", 16384);
+    GateServer_timer_tick_ms =
+        loadOrDefault<std::size_t>("GateServer", "timer_tick", 100);
+    GateServer_timer_slots =
+        loadOrDefault<std::size_t>("GateServer", "timer_slots", 512);
+    GateServer_header_timeout_ms =
+        loadOrDefault<std::size_t>("GateServer", "header_timeout", 10000);
+    GateServer_body_timeout_ms =
+        loadOrDefault<std::size_t>("GateServer", "body_timeout", 30000);
+    GateServer_handler_timeout_ms =
+        loadOrDefault<std::size_t>("GateServer", "handler_timeout", 30000);
+    GateServer_write_timeout_ms =
+        loadOrDefault<std::size_t>("GateServer", "write_timeout", 30000);
+    GateServer_header_limit =
+        loadOrDefault<std::size_t>("GateServer", "header_limit", 8192);
+    GateServer_body_limit =
+        loadOrDefault<std::size_t>("GateServer", "body_limit", 65536);
+    GateServer_min_body_rate =
+        loadOrDefault<std::size_t>("GateServer", "min_body_rate", 1024);
+    GateServer_body_rate_grace_ms =
+        loadOrDefault<std::size_t>("GateServer", "body_rate_grace", 3000);
+    GateServer_drain_timeout_ms =
+        loadOrDefault<std::size_t>("GateServer", "drain_timeout", 10000);
+    GateServer_handoff_path =
+        loadOrDefault<std::string>("GateServer", "handoff_path", "");
   }
   void loadVerificationServerInfo() {
     VerificationServerAddress =
@@ -65,6 +279,170 @@ private:
         std::to_string(m_ini["BalanceService"]["port"].as<unsigned short>());
   }
 
+  void loadLogInfo() {
+    Log_queue_size = loadOrDefault<std::size_t>("Log", "queue_size", 8192);
+    Log_overflow = loadOrDefault<std::string>("Log", "overflow", "overrun");
+    Log_file = loadOrDefault<std::string>("Log", "file", "");
+    Log_level = loadOrDefault<std::string>("Log", "level", "info");
+    Log_http_level = loadOrDefault<std::string>("Log", "http", Log_level);
+    Log_redis_level = loadOrDefault<std::string>("Log", "redis", Log_level);
+    Log_mysql_level = loadOrDefault<std::string>("Log", "mysql", Log_level);
+    Log_grpc_level = loadOrDefault<std::string>("Log", "grpc", Log_level);
+    Log_request_sample_rate =
+        loadOrDefault<std::size_t>("Log", "request_sample_rate", 100);
+    Log_request_rate_limit =
+        loadOrDefault<std::size_t>("Log", "request_rate_limit", 50);
+  }
+
+  void loadTraceInfo() {
+    Trace_enabled = loadOrDefault<bool>("Trace", "enabled", false);
+    Trace_sample_rate = loadOrDefault<double>("Trace", "sample_rate", 0.01);
+    Trace_ring_size = loadOrDefault<std::size_t>("Trace", "ring_size", 8192);
+    Trace_flush_interval_ms =
+        loadOrDefault<std::size_t>("Trace", "flush_interval", 1000);
+    Trace_file = loadOrDefault<std::string>("Trace", "file", "trace.jsonl");
+  }
+
+  void loadAdmissionInfo() {
+    Admission_enabled = loadOrDefault<bool>("Admission", "enabled", true);
+    Admission_initial_limit =
+        loadOrDefault<std::size_t>("Admission", "initial_limit", 0);
+    Admission_min_limit =
+        loadOrDefault<std::size_t>("Admission", "min_limit", 1);
+    Admission_max_limit =
+        loadOrDefault<std::size_t>("Admission", "max_limit", 0);
+    Admission_window_ms =
+        loadOrDefault<std::size_t>("Admission", "window", 100);
+    Admission_long_window =
+        loadOrDefault<std::size_t>("Admission", "long_window", 100);
+    Admission_smoothing =
+        loadOrDefault<double>("Admission", "smoothing", 0.2);
+    Admission_tolerance =
+        loadOrDefault<double>("Admission", "tolerance", 1.5);
+    Admission_normal_share =
+        loadOrDefault<double>("Admission", "normal_share", 0.8);
+    Admission_low_share = loadOrDefault<double>("Admission", "low_share", 0.5);
+    Admission_retry_after =
+        loadOrDefault<std::size_t>("Admission", "retry_after", 1);
+  }
+
+  void loadRateLimitInfo() {
+    RateLimit_enabled = loadOrDefault<bool>("RateLimit", "enabled", true);
+    RateLimit_redis = loadOrDefault<bool>("RateLimit", "redis", false);
+    RateLimit_max_keys =
+        loadOrDefault<std::size_t>("RateLimit", "max_keys", 100000);
+    RateLimit_ip_rate = loadOrDefault<double>("RateLimit", "ip_rate", 20);
+    RateLimit_ip_burst = loadOrDefault<double>("RateLimit", "ip_burst", 40);
+    RateLimit_email_rate =
+        loadOrDefault<double>("RateLimit", "email_rate", 0.2);
+    RateLimit_email_burst =
+        loadOrDefault<double>("RateLimit", "email_burst", 3);
+    RateLimit_username_rate =
+        loadOrDefault<double>("RateLimit", "username_rate", 1);
+    RateLimit_username_burst =
+        loadOrDefault<double>("RateLimit", "username_burst", 5);
+  }
+
+  void loadSingleFlightInfo() {
+    SingleFlight_verification_window = loadOrDefault<std::size_t>(
+        "SingleFlight", "verification_window", 1000);
+    SingleFlight_account_window =
+        loadOrDefault<std::size_t>("SingleFlight", "account_window", 200);
+  }
+
+  void loadAccountFilterInfo() {
+    AccountFilter_enabled =
+        loadOrDefault<bool>("AccountFilter", "enabled", true);
+    AccountFilter_capacity =
+        loadOrDefault<std::size_t>("AccountFilter", "capacity", 1000000);
+    AccountFilter_bits_per_key =
+        loadOrDefault<std::size_t>("AccountFilter", "bits_per_key", 12);
+  }
+
+  void loadAccountCacheInfo() {
+    AccountCache_capacity =
+        loadOrDefault<std::size_t>("AccountCache", "capacity", 100000);
+  }
+
+  void loadCPUWorkerInfo() {
+    CPUWorker_threads = loadOrDefault<std::size_t>("CPUWorker", "threads", 0);
+    CPUWorker_queue_limit =
+        loadOrDefault<std::size_t>("CPUWorker", "queue_limit", 256);
+  }
+
+  void loadPasswordInfo() {
+    Password_scrypt_cost =
+        loadOrDefault<std::size_t>("Password", "scrypt_cost", 15);
+    Password_scrypt_block_size =
+        loadOrDefault<std::size_t>("Password", "scrypt_block_size", 8);
+    Password_scrypt_parallelism =
+        loadOrDefault<std::size_t>("Password", "scrypt_parallelism", 1);
+  }
+  void loadWarmupInfo() {
+    Warmup_lazy = loadOrDefault<bool>("Warmup", "lazy", false);
+    Warmup_minimum = loadOrDefault<std::size_t>("Warmup", "minimum", 1);
+    Warmup_connect_timeout_ms =
+        loadOrDefault<std::size_t>("Warmup", "connect_timeout", 3000);
+  }
+  void loadReconnectInfo() {
+    Reconnect_initial_backoff_ms =
+        loadOrDefault<std::size_t>("Reconnect", "initial_backoff", 100);
+    Reconnect_max_backoff_ms =
+        loadOrDefault<std::size_t>("Reconnect", "max_backoff", 10000);
+    Reconnect_acquire_timeout_ms =
+        loadOrDefault<std::size_t>("Reconnect", "acquire_timeout", 3000);
+  }
+  void loadReplicaInfo() {
+    Replica_hosts = loadOrDefault<std::string>("Replica", "hosts", "");
+    Replica_sticky_window_ms =
+        loadOrDefault<std::size_t>("Replica", "sticky_window", 2000);
+    Replica_sticky_capacity =
+        loadOrDefault<std::size_t>("Replica", "sticky_capacity", 65536);
+  }
+  void loadRedisClusterInfo() {
+    RedisCluster_enabled =
+        loadOrDefault<bool>("RedisCluster", "enabled", false);
+    RedisCluster_seeds =
+        loadOrDefault<std::string>("RedisCluster", "seeds", "");
+    RedisCluster_max_redirects =
+        loadOrDefault<std::size_t>("RedisCluster", "max_redirects", 5);
+    RedisCluster_refresh_interval_ms =
+        loadOrDefault<std::size_t>("RedisCluster", "refresh_interval", 1000);
+  }
+  void loadRedisTrackingInfo() {
+    RedisTracking_enabled =
+        loadOrDefault<bool>("RedisTracking", "enabled", false);
+    RedisTracking_prefixes =
+        loadOrDefault<std::string>("RedisTracking", "prefixes", "");
+    RedisTracking_max_bytes =
+        loadOrDefault<std::size_t>("RedisTracking", "max_bytes", 16777216);
+    RedisTracking_ping_interval_ms =
+        loadOrDefault<std::size_t>("RedisTracking", "ping_interval", 5000);
+  }
+  void loadRegistrationBatchInfo() {
+    RegistrationBatch_enabled =
+        loadOrDefault<bool>("RegistrationBatch", "enabled", false);
+    RegistrationBatch_max_rows =
+        loadOrDefault<std::size_t>("RegistrationBatch", "max_rows", 64);
+    RegistrationBatch_window_ms =
+        loadOrDefault<std::size_t>("RegistrationBatch", "window", 2);
+  }
+
+  /*optional settings, fall back to default_value when key is missing*/
+  template <typename _Ty>
+  _Ty loadOrDefault(const std::string &section, const std::string &key,
+                    const _Ty &default_value) {
+    auto sec = m_ini.find(section);
+    if (sec == m_ini.end()) {
+      return default_value;
+    }
+    auto field = sec->second.find(key);
+    if (field == sec->second.end()) {
+      return default_value;
+    }
+    return field->second.template as<_Ty>();
+  }
+
 private:
   ini::IniFile m_ini;
 };
@@ -30,15 +30,25 @@ class BalancerServicePool
     auto address = fmt::format("{}:{}", m_host, m_port);
     spdlog::info("Connected to balance server {}", address);
 
-    /*creating multiple stub*/
-    for (std::size_t i = 0; i < m_queue_size; ++i) {
-      m_stub_queue.push(std::move(message::BalancerService::NewStub(
-          grpc::CreateChannel(address, m_cred))));
-    }
+    /*creating multiple stub, channels are connected by warmup()*/
+    const std::chrono::milliseconds timeout(
+        ServerConfig::get_instance()->Warmup_connect_timeout_ms);
+    setFactory(
+        [this, address, timeout]() -> context_ptr {
+          auto channel = grpc::CreateChannel(address, m_cred);
+          if (!channel->WaitForConnected(std::chrono::system_clock::now() +
+                                         timeout)) {
+            return nullptr;
+          }
+          return message::BalancerService::NewStub(channel);
+        },
+        ServerConfig::get_instance()->Warmup_lazy,
+        ServerConfig::get_instance()->Warmup_minimum);
+    registerMetrics("balancer");
   }
 
 public:
-  ~BalancerServicePool() = default;
+  ~BalancerServicePool() { shutdown(); }
 };
 } // namespace stubpool
 
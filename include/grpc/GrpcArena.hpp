@@ -0,0 +1,82 @@
+#pragma once
+#ifndef _GRPCARENA_HPP_
+#define _GRPCARENA_HPP_
+#include <array>
+#include <cstddef>
+#include <google/protobuf/arena.h>
+
+namespace stubpool {
+/*
+ * every thread owns one protobuf arena, gRPC helpers allocate request and
+ * response messages on it. When the last ArenaMessage handle on this thread
+ * is destroyed, the arena is reset and its initial block is reused by the
+ * next call.
+ */
+class ThreadArena {
+  static constexpr std::size_t initial_block_size = 4096;
+
+public:
+  static ThreadArena &get() {
+    thread_local ThreadArena instance;
+    return instance;
+  }
+
+  template <typename _Ty> _Ty *create() {
+    return google::protobuf::Arena::CreateMessage<_Ty>(&m_arena);
+  }
+
+  void retain() { ++m_handles; }
+  void release() {
+    /*nested helpers share the arena, reset it when no one holds it*/
+    if (--m_handles == 0) {
+      m_arena.Reset();
+    }
+  }
+
+private:
+  ThreadArena()
+      : m_handles(0), m_arena(m_block.data(), m_block.size()) {}
+
+  ThreadArena(const ThreadArena &) = delete;
+  ThreadArena &operator=(const ThreadArena &) = delete;
+
+private:
+  std::size_t m_handles;
+  alignas(std::max_align_t) std::array<char, initial_block_size> m_block;
+  google::protobuf::Arena m_arena;
+};
+
+/*
+ * move-only handle of a message which lives on current thread's arena
+ * it must be destroyed on the same thread which created it
+ */
+template <typename _Ty> class ArenaMessage {
+public:
+  ArenaMessage() : m_msg(ThreadArena::get().create<_Ty>()) {
+    ThreadArena::get().retain();
+  }
+
+  ~ArenaMessage() {
+    if (m_msg != nullptr) {
+      ThreadArena::get().release();
+    }
+  }
+
+  ArenaMessage(ArenaMessage &&other) noexcept : m_msg(other.m_msg) {
+    other.m_msg = nullptr;
+  }
+
+  ArenaMessage(const ArenaMessage &) = delete;
+  ArenaMessage &operator=(const ArenaMessage &) = delete;
+  ArenaMessage &operator=(ArenaMessage &&) = delete;
+
+  _Ty *get() const { return m_msg; }
+  _Ty *operator->() const { return m_msg; }
+  _Ty &operator*() const { return *m_msg; }
+
+private:
+  _Ty *m_msg;
+};
+} // namespace stubpool
+
+#endif // !_GRPCARENA_HPP_
@@ -2,55 +2,96 @@
 #ifndef GRPCBALANCESERVICE_HPP_
 #define GRPCBALANCESERVICE_HPP_
 #include <grpc/BalanceServicePool.hpp>
+#include <grpc/GrpcArena.hpp>
+#include <metrics/MetricsRegistry.hpp>
 #include <grpcpp/client_context.h>
 #include <grpcpp/support/status.h>
 #include <message/message.grpc.pb.h>
 #include <message/message.pb.h>
 #include <network/def.hpp>
+#include <trace/Tracer.hpp>
 #include <service/ConnectionPool.hpp>
 
 struct gRPCBalancerService {
   // pass user's uuid parameter to the server, and returns available server
   // address to user
-  static message::GetAllocatedChattingServer
+  static stubpool::ArenaMessage<message::GetAllocatedChattingServer>
   addNewUserToServer(std::size_t uuid) {
     grpc::ClientContext context;
-    message::RegisterToBalancer request;
-    message::GetAllocatedChattingServer response;
-    request.set_uuid(uuid);
+    stubpool::ArenaMessage<message::RegisterToBalancer> request;
+    stubpool::ArenaMessage<message::GetAllocatedChattingServer> response;
+    request->set_uuid(uuid);
 
     connection::ConnectionRAII<stubpool::BalancerServicePool,
                                message::BalancerService::Stub>
         raii;
+    if (!raii) {
+      response->set_error(static_cast<int32_t>(ServiceStatus::GRPC_ERROR));
+      return response;
+    }
+
+    static metrics::Histogram &latency =
+        metrics::MetricsRegistry::get_instance()->histogram(
+            "gateway_grpc_call_duration_seconds", "gRPC client call latency",
+            "method=\"AddNewUserToServer\"");
 
-    grpc::Status status =
-        raii->get()->AddNewUserToServer(&context, request, &response);
+    /*propagate trace context to the upstream service*/
+    trace::Span span("grpc.client", "AddNewUserToServer", trace::SpanKind::CLIENT);
+    if (span.active()) {
+      context.AddMetadata("traceparent", span.context().traceparent());
+    }
+
+    grpc::Status status;
+    {
+      metrics::ScopedTimer timer(latency);
+      status = raii->get()->AddNewUserToServer(&context, *request, response.get());
+    }
 
     ///*error occured*/
     if (!status.ok()) {
-      response.set_error(static_cast<int32_t>(ServiceStatus::GRPC_ERROR));
+      span.setError();
+      response->set_error(static_cast<int32_t>(ServiceStatus::GRPC_ERROR));
     }
     return response;
   }
 
-  static message::LoginChattingResponse
+  static stubpool::ArenaMessage<message::LoginChattingResponse>
   userLoginToServer(std::size_t uuid, const std::string &token) {
     grpc::ClientContext context;
-    message::LoginChattingServer request;
-    message::LoginChattingResponse response;
-    request.set_uuid(uuid);
-    request.set_token(token);
+    stubpool::ArenaMessage<message::LoginChattingServer> request;
+    stubpool::ArenaMessage<message::LoginChattingResponse> response;
+    request->set_uuid(uuid);
+    request->set_token(token);
 
     connection::ConnectionRAII<stubpool::BalancerServicePool,
                                message::BalancerService::Stub>
         raii;
+    if (!raii) {
+      response->set_error(static_cast<int32_t>(ServiceStatus::GRPC_ERROR));
+      return response;
+    }
+
+    static metrics::Histogram &latency =
+        metrics::MetricsRegistry::get_instance()->histogram(
+            "gateway_grpc_call_duration_seconds", "gRPC client call latency",
+            "method=\"UserLoginToServer\"");
 
-    grpc::Status status =
-        raii->get()->UserLoginToServer(&context, request, &response);
+    /*propagate trace context to the upstream service*/
+    trace::Span span("grpc.client", "UserLoginToServer", trace::SpanKind::CLIENT);
+    if (span.active()) {
+      context.AddMetadata("traceparent", span.context().traceparent());
+    }
+
+    grpc::Status status;
+    {
+      metrics::ScopedTimer timer(latency);
+      status = raii->get()->UserLoginToServer(&context, *request, response.get());
+    }
 
     ///*error occured*/
     if (!status.ok()) {
-      response.set_error(static_cast<int32_t>(ServiceStatus::GRPC_ERROR));
+      span.setError();
+      response->set_error(static_cast<int32_t>(ServiceStatus::GRPC_ERROR));
     }
     return response;
   }
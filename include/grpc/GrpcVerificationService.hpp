@@ -2,27 +2,49 @@
 #ifndef GRPCVERIFICATIONSERVICE_HPP_
 #define GRPCVERIFICATIONSERVICE_HPP_
 
+#include <grpc/GrpcArena.hpp>
+#include <metrics/MetricsRegistry.hpp>
 #include <grpc/VerificationServicePool.hpp>
 #include <network/def.hpp>
+#include <trace/Tracer.hpp>
 
 struct gRPCVerificationService {
-  static message::GetVerificationResponse
-  getVerificationCode(std::string email) {
+  static stubpool::ArenaMessage<message::GetVerificationResponse>
+  getVerificationCode(std::string_view email) {
     grpc::ClientContext context;
-    message::GetVerificationRequest request;
-    message::GetVerificationResponse response;
-    request.set_email(email);
+    stubpool::ArenaMessage<message::GetVerificationRequest> request;
+    stubpool::ArenaMessage<message::GetVerificationResponse> response;
+    request->set_email(email.data(), email.size());
 
     connection::ConnectionRAII<stubpool::VerificationServicePool,
                                message::VerificationService::Stub>
         raii;
+    if (!raii) {
+      response->set_error(static_cast<int32_t>(ServiceStatus::GRPC_ERROR));
+      return response;
+    }
+
+    static metrics::Histogram &latency =
+        metrics::MetricsRegistry::get_instance()->histogram(
+            "gateway_grpc_call_duration_seconds", "gRPC client call latency",
+            "method=\"GetVerificationCode\"");
 
-    grpc::Status status =
-        raii->get()->GetVerificationCode(&context, request, &response);
+    /*propagate trace context to the upstream service*/
+    trace::Span span("grpc.client", "GetVerificationCode", trace::SpanKind::CLIENT);
+    if (span.active()) {
+      context.AddMetadata("traceparent", span.context().traceparent());
+    }
+
+    grpc::Status status;
+    {
+      metrics::ScopedTimer timer(latency);
+      status = raii->get()->GetVerificationCode(&context, *request, response.get());
+    }
 
     /*error occured*/
     if (!status.ok()) {
-      response.set_error(static_cast<int32_t>(ServiceStatus::GRPC_ERROR));
+      span.setError();
+      response->set_error(static_cast<int32_t>(ServiceStatus::GRPC_ERROR));
     }
     return response;
   }
@@ -26,15 +26,25 @@ class VerificationServicePool
         m_cred(grpc::InsecureChannelCredentials()) {
     spdlog::info("Connected to verification server addr {}", m_addr.c_str());
 
-    /*creating multiple stub*/
-    for (std::size_t i = 0; i < m_queue_size; ++i) {
-      m_stub_queue.push(std::move(message::VerificationService::NewStub(
-          grpc::CreateChannel(m_addr, m_cred))));
-    }
+    /*creating multiple stub, channels are connected by warmup()*/
+    const std::chrono::milliseconds timeout(
+        ServerConfig::get_instance()->Warmup_connect_timeout_ms);
+    setFactory(
+        [this, timeout]() -> stub_ptr {
+          auto channel = grpc::CreateChannel(m_addr, m_cred);
+          if (!channel->WaitForConnected(std::chrono::system_clock::now() +
+                                         timeout)) {
+            return nullptr;
+          }
+          return message::VerificationService::NewStub(channel);
+        },
+        ServerConfig::get_instance()->Warmup_lazy,
+        ServerConfig::get_instance()->Warmup_minimum);
+    registerMetrics("verification");
   }
 
 public:
-  ~VerificationServicePool() = default;
+  ~VerificationServicePool() { shutdown(); }
 };
 } // namespace stubpool
 
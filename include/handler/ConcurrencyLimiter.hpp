@@ -0,0 +1,116 @@
+#pragma once
+#ifndef _CONCURRENCYLIMITER_HPP_
+#define _CONCURRENCYLIMITER_HPP_
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <singleton/singleton.hpp>
+#include <string>
+
+namespace metrics {
+class Counter;
+}
+
+namespace admission {
+/*higher priority routes are allowed to occupy a larger share of the limit*/
+enum class Priority : uint8_t { HIGH, NORMAL, LOW };
+
+struct Route {
+  std::string name;
+
+  /*fraction of the global limit, in (0, 1]*/
+  double share;
+  metrics::Counter *rejected;
+};
+
+class ConcurrencyLimiter;
+
+/*one admitted request, reports its latency to the limiter when destroyed*/
+class Permit {
+  friend class ConcurrencyLimiter;
+  explicit Permit(ConcurrencyLimiter *limiter);
+
+public:
+  Permit(const Permit &) = delete;
+  Permit &operator=(const Permit &) = delete;
+  Permit(Permit &&other) noexcept;
+  Permit &operator=(Permit &&) = delete;
+  ~Permit();
+
+private:
+  /*nullptr when limiter is disabled or permit has been moved*/
+  ConcurrencyLimiter *m_limiter;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+/*
+ * gradient concurrency limiter shared by all routes
+ *
+ * every window, the average latency of that window(short rtt) is compared
+ * with a slowly moving average(long rtt). while short rtt stays within
+ * tolerance the limit grows by sqrt(limit), once backends slow down the limit
+ * shrinks by long/short ratio(at most by half), so in-flight work is bounded
+ * before latency collapses.
+ *
+ * a request of priority P is admitted only if in-flight < limit * share(P),
+ * low priority routes are rejected first and leave room for the others.
+ */
+class ConcurrencyLimiter : public Singleton<ConcurrencyLimiter> {
+  friend class Singleton<ConcurrencyLimiter>;
+  friend class Permit;
+  ConcurrencyLimiter();
+
+public:
+  ~ConcurrencyLimiter();
+
+  /*register route at startup, returned reference stays valid*/
+  const Route &route(const std::string &name, Priority priority);
+
+  /*
+   * std::nullopt means over limit, caller should respond 503
+   * nullptr route is always admitted and not counted
+   */
+  std::optional<Permit> tryAcquire(const Route *route);
+
+  std::size_t limit() const;
+  std::size_t inflight() const;
+  std::chrono::seconds retryAfter() const;
+
+private:
+  void release(std::chrono::steady_clock::duration rtt);
+
+  /*called under m_mtx when current window is closed*/
+  void updateLimit();
+
+private:
+  bool m_enabled;
+  double m_min_limit;
+  double m_max_limit;
+  double m_smoothing;
+  double m_tolerance;
+  double m_long_window;
+  double m_shares[3];
+  std::chrono::milliseconds m_window;
+  std::chrono::seconds m_retry_after;
+
+  /*read by every request without locking*/
+  std::atomic<std::size_t> m_inflight;
+  std::atomic<std::size_t> m_limit;
+
+  /*limit estimation, protected by m_mtx*/
+  std::mutex m_mtx;
+  double m_estimated_limit;
+  double m_long_rtt = 0;
+  double m_window_rtt_sum = 0;
+  std::size_t m_window_samples = 0;
+  std::size_t m_window_max_inflight = 0;
+  std::chrono::steady_clock::time_point m_window_end;
+
+  std::map<std::string, Route, std::less<>> m_routes;
+};
+} // namespace admission
+
+#endif // !_CONCURRENCYLIMITER_HPP_
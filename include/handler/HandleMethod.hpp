@@ -1,15 +1,38 @@
 #pragma once
 #ifndef _HANDLEMETHOD_HPP_
 #define _HANDLEMETHOD_HPP_
+#include <array>
+#include <chrono>
 #include <functional>
 #include <map>
 #include <memory>
 #include <network/def.hpp> //network errorcode defs
+#include <optional>
 #include <singleton/singleton.hpp>
+#include <string>
 #include <string_view>
+#include <tools/PasswordHash.hpp>
 
 class HTTPConnection;
 
+namespace Json {
+class Value;
+}
+
+namespace metrics {
+class Counter;
+class Histogram;
+}
+
+namespace admission {
+struct Route;
+enum class RateKey : uint8_t;
+}
+
+namespace connection {
+template <typename _Result> class SingleFlight;
+}
+
 class HandleMethod : public Singleton<HandleMethod> {
   friend class Singleton<HandleMethod>;
   using CallBackNoReturn = std::function<void(std::shared_ptr<HTTPConnection>)>;
@@ -21,21 +44,95 @@ private:
   void registerGetCallBacks();
   void registerPostCallBacks();
 
+  /*create metrics and admission priority for every route*/
+  void registerRouteInfo();
+
+  /*respond 429/503 with Retry-After, handler is not called*/
+  static void rejectRequest(unsigned status, ServiceStatus error,
+                            std::chrono::seconds retry_after,
+                            std::shared_ptr<HTTPConnection> conn);
+
+  /*token bucket of key, responds 429 and returns false when it is empty*/
+  static bool checkRateLimit(admission::RateKey kind, std::string_view key,
+                             std::shared_ptr<HTTPConnection> conn);
+
+  /*client ipv4 address or ipv6 /64 prefix, empty if socket is closed*/
+  static std::string_view remoteKey(const std::shared_ptr<HTTPConnection> &conn,
+                                    std::array<unsigned char, 16> &storage);
+
   void generateErrorMessage(std::string_view message, ServiceStatus status,
                             std::shared_ptr<HTTPConnection> conn);
 
+  /*parse request body directly, body is stored inside connection's arena*/
+  static bool parseJson(std::shared_ptr<HTTPConnection> conn,
+                        Json::Value &root);
+
+  /*serialize json into response body without a temporary string*/
+  static void writeJson(const Json::Value &root,
+                        std::shared_ptr<HTTPConnection> conn);
+
+  /*view string member without copying, return false if it's not a string*/
+  static bool getStringView(const Json::Value &root, const char *key,
+                            std::string_view &value);
+
+  /*
+   * run job on CPUWorkerPool, then continuation(job's result) on conn's
+   * io_context, response is written after continuation returns.
+   * job must not refer to the request, it is only valid on conn's io thread.
+   * responds 503 and returns false when worker queue is full
+   */
+  template <typename _Job, typename _Continuation>
+  bool offload(std::shared_ptr<HTTPConnection> conn, _Job &&job,
+               _Continuation &&continuation);
+
+  /*
+   * the handler(or offload continuation) returns before conn is answered,
+   * respond(status) has to be called once on conn's io_context to record the
+   * route and write the response
+   */
+  std::function<void(bool)> defer(std::shared_ptr<HTTPConnection> conn);
+
 public:
   ~HandleMethod();
   void registerCallBacks();
-  bool handleGetMethod(std::string str,
+  bool handleGetMethod(std::string_view str,
                        std::shared_ptr<HTTPConnection> extended_lifetime);
-  bool handlePostMethod(std::string str,
+  bool handlePostMethod(std::string_view str,
                         std::shared_ptr<HTTPConnection> extended_lifetime);
 
 private:
-  /*CallBack Functions*/
-  std::map</*url*/ std::string, CallBackNoReturn> get_method_callback;
-  std::map</*url*/ std::string, CallBackWithStatus> post_method_callback;
+  struct RouteInfo {
+    metrics::Counter *requests;
+    metrics::Counter *failures;
+    metrics::Histogram *latency;
+
+    /*nullptr means this route is never rejected*/
+    const admission::Route *admission;
+  };
+
+  /*record latency and failure of a finished request, release its permit*/
+  static void finishRoute(const RouteInfo &route, bool status,
+                          const std::shared_ptr<HTTPConnection> &conn);
+
+  /*CallBack Functions, std::less<> allows lookup by string_view*/
+  std::map</*url*/ std::string, CallBackNoReturn, std::less<>>
+      get_method_callback;
+  std::map</*url*/ std::string, CallBackWithStatus, std::less<>>
+      post_method_callback;
+
+  /*created after all callbacks are registered, read only afterwards*/
+  std::map</*url*/ std::string, RouteInfo, std::less<>> route_info;
+
+  /*duplicate requests share one backend call*/
+  std::unique_ptr<connection::SingleFlight<int32_t>> verification_flight;
+  /*nullopt when no MySQL connection is available*/
+  std::unique_ptr<connection::SingleFlight<std::optional<bool>>>
+      account_flight;
+
+  tools::ScryptParams scrypt_params;
+
+  /*verified instead of a stored hash when the username doesn't exist*/
+  std::string dummy_hash;
 };
 
 #endif
@@ -0,0 +1,101 @@
+#pragma once
+#ifndef _RATELIMITER_HPP_
+#define _RATELIMITER_HPP_
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <singleton/singleton.hpp>
+#include <string_view>
+#include <unordered_map>
+
+namespace metrics {
+class Counter;
+}
+
+namespace admission {
+/*what a token bucket is keyed by*/
+enum class RateKey : uint8_t { IP, EMAIL, USERNAME };
+
+/*
+ * token buckets keyed by the hash of a string, split into shards so io
+ * threads rarely wait for each other. a bucket which has been idle for long
+ * enough is full anyway, those are evicted when a shard reaches its capacity
+ */
+class TokenBuckets {
+  using clock = std::chrono::steady_clock;
+
+public:
+  /*rate: tokens per second, burst: bucket size*/
+  TokenBuckets(double rate, double burst, std::size_t max_keys);
+
+  /*take one token, std::nullopt means success, otherwise wait time*/
+  std::optional<std::chrono::milliseconds> take(std::string_view key);
+
+private:
+  struct Bucket {
+    double tokens;
+    clock::time_point last;
+  };
+
+  struct alignas(64) Shard {
+    std::mutex mtx;
+    std::unordered_map<std::size_t, Bucket> buckets;
+  };
+
+  /*called under shard.mtx*/
+  void evict(Shard &shard, clock::time_point now);
+
+private:
+  static constexpr std::size_t shard_count = 64;
+
+  double m_rate;
+  double m_burst;
+  std::size_t m_shard_capacity;
+  std::array<Shard, shard_count> m_shards;
+};
+
+/*
+ * per client ip and per email/username request rate, checked before any
+ * backend work. buckets live in this process by default, or in redis when
+ * several gateway instances have to share them
+ */
+class RateLimiter : public Singleton<RateLimiter> {
+  friend class Singleton<RateLimiter>;
+  RateLimiter();
+
+public:
+  ~RateLimiter();
+
+  /*std::nullopt means allowed, otherwise Retry-After*/
+  std::optional<std::chrono::seconds> check(RateKey kind,
+                                            std::string_view key);
+
+private:
+  struct Policy {
+    const char *name;
+
+    /*tokens per second, 0 disables this policy*/
+    double rate;
+    double burst;
+    std::unique_ptr<TokenBuckets> local;
+    metrics::Counter *limited;
+  };
+
+  /*
+   * shared bucket inside redis, zero means allowed. std::nullopt when redis
+   * is not available and local bucket has to be used instead
+   */
+  std::optional<std::chrono::milliseconds> takeShared(const Policy &policy,
+                                                      std::string_view key);
+
+private:
+  bool m_enabled;
+  bool m_shared;
+  std::array<Policy, 3> m_policies;
+};
+} // namespace admission
+
+#endif // !_RATELIMITER_HPP_
@@ -5,39 +5,116 @@
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/version.hpp>
+#include <handler/ConcurrencyLimiter.hpp>
 #include <memory>
+#include <memory_resource>
+#include <optional>
+#include <service/TimingWheel.hpp>
 #include <string>
 #include <string_view>
+#include <trace/Tracer.hpp>
 #include <unordered_map>
 
 class HandleMethod;
+class GateServer;
+
+namespace connection {
+template <typename _Ty> class RecyclePool;
+}
 
 class HTTPConnection : public std::enable_shared_from_this<HTTPConnection> {
   friend class HandleMethod;
+  friend class GateServer;
+  friend class connection::RecyclePool<HTTPConnection>;
 
 public:
-  HTTPConnection(boost::asio::ip::tcp::socket &_socket);
+  /*request header and body are allocated inside per-request arena*/
+  using arena_allocator = std::pmr::polymorphic_allocator<char>;
+  using request_body =
+      boost::beast::http::basic_string_body<char, std::char_traits<char>,
+                                            arena_allocator>;
+  using request_parser =
+      boost::beast::http::request_parser<request_body, arena_allocator>;
+  using request_type = request_parser::value_type;
+
+  HTTPConnection(boost::asio::io_context &_ioc);
   ~HTTPConnection() = default;
   void start_service();
   void return_not_found();
 
+  /*only valid during one request, everything is freed in recycle()*/
+  std::pmr::memory_resource *arena();
+  request_type &request();
+
+private:
+  /*called by RecyclePool, reset all states but keep buffers*/
+  void recycle();
+
 private:
-  void check_timeout();
+  /*every phase has its own deadline*/
+  enum class Phase : uint8_t { HEADER, BODY, HANDLER, WRITE };
+
+  void arm_deadline(Phase phase);
+  static void on_deadline(void *owner);
+
   void activate_receiver();
+  void receive_body();
+  bool is_too_slow() const;
+
+  /*header/body limit or timeout, respond 431/413/408 or drop connection*/
+  void handle_read_error(boost::system::error_code ec);
+  void return_error(boost::beast::http::status status);
   void process_request();
   void write_response();
+
+  /*mark 5xx as error and end the request span*/
+  void end_span();
   void handle_get_request(std::shared_ptr<HTTPConnection> extended_lifetime);
   void handle_post_request(std::shared_ptr<HTTPConnection> extended_lifetime);
 
 private:
-  boost::asio::ip::tcp::socket &http_socket;
+  boost::asio::ip::tcp::socket http_socket;
+
+  /*accepted by this GateServer, nullptr when connection is idle*/
+  GateServer *http_gate = nullptr;
+
+  /*deadline of current phase, managed by io_context's timing wheel*/
+  connection::TimingWheel &http_wheel;
+  connection::TimerNode http_deadline;
+  Phase http_phase = Phase::HEADER;
+  bool http_timed_out = false;
+
+  /*from start_service to response written*/
+  std::chrono::steady_clock::time_point http_request_start;
+
+  /*
+   * handler finishes on CPUWorkerPool, process_request() does not write the
+   * response and HandleMethod writes it later
+   */
+  bool http_deferred = false;
+  std::optional<admission::Permit> http_permit;
+
+  /*suspended while the request is deferred, ended once it is answered*/
+  std::optional<trace::Span> http_span;
+  std::chrono::steady_clock::time_point http_handler_start;
+
+  /*request body throughput*/
+  std::chrono::steady_clock::time_point http_body_start;
+  std::chrono::steady_clock::time_point http_body_deadline;
+  std::size_t http_body_received = 0;
+
   boost::beast::flat_buffer http_buffer{8192};
-  boost::beast::http::request<boost::beast::http::dynamic_body> http_request;
+
+  /*
+   * per-request monotonic arena, initial block is owned by this connection
+   * and reused after recycle, only oversized requests touch the heap
+   */
+  std::unique_ptr<std::byte[]> http_arena_storage;
+  std::pmr::monotonic_buffer_resource http_arena;
+
+  /*parser has to be destroyed before http_arena is released*/
+  std::optional<request_parser> http_parser;
   boost::beast::http::response<boost::beast::http::dynamic_body> http_response;
-  boost::beast::net::steady_timer http_timer{
-      http_socket.get_executor(), /*io context*/
-      std::chrono::minutes(1)     /*timer setting*/
-  };
 
   std::string_view http_url_info;
   std::unordered_map<
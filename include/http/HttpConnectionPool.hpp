@@ -0,0 +1,63 @@
+#pragma once
+#ifndef _HTTPCONNECTIONPOOL_HPP_
+#define _HTTPCONNECTIONPOOL_HPP_
+#include <config/ServerConfig.hpp>
+#include <http/HttpConnection.hpp>
+#include <service/IOServicePool.hpp>
+#include <service/RecyclePool.hpp>
+#include <singleton/singleton.hpp>
+#include <vector>
+
+/*
+ * every io_context owns a recycle pool of HTTPConnection
+ * because HTTPConnection's socket and timer are bound to that io_context
+ */
+class HTTPConnectionPool : public Singleton<HTTPConnectionPool> {
+  friend class Singleton<HTTPConnectionPool>;
+  using pool = connection::RecyclePool<HTTPConnection>;
+  using pool_ptr = std::unique_ptr<pool>;
+
+  HTTPConnectionPool() : m_service_pool(IOServicePool::get_instance()) {
+    const std::size_t ioc_count = m_service_pool->size();
+    const std::size_t capacity =
+        ServerConfig::get_instance()->GateServer_connection_pool_capacity;
+
+    m_pools.reserve(ioc_count);
+    for (std::size_t i = 0; i < ioc_count; ++i) {
+      m_pools.push_back(std::make_unique<pool>(capacity));
+    }
+  }
+
+public:
+  ~HTTPConnectionPool() = default;
+
+  std::shared_ptr<HTTPConnection> acquire(boost::asio::io_context &ioc) {
+    return m_pools
+        .at(m_service_pool->getIOServiceIndex(ioc))
+        ->acquire(ioc);
+  }
+
+  /*sum of all io_contexts' statistics*/
+  pool::Statistic statistic() {
+    pool::Statistic total{};
+    for (auto &p : m_pools) {
+      auto s = p->statistic();
+      total.created += s.created;
+      total.reused += s.reused;
+      total.recycled += s.recycled;
+      total.dropped += s.dropped;
+      total.idle += s.idle;
+    }
+    return total;
+  }
+
+private:
+  /*
+   * idle HTTPConnections close their sockets on destruction, so io_contexts
+   * have to outlive m_pools even when singletons are destroyed out of order
+   */
+  std::shared_ptr<IOServicePool> m_service_pool;
+  std::vector<pool_ptr> m_pools;
+};
+
+#endif // !_HTTPCONNECTIONPOOL_HPP_
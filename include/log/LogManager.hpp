@@ -0,0 +1,74 @@
+#pragma once
+#ifndef _LOGMANAGER_HPP_
+#define _LOGMANAGER_HPP_
+#include <array>
+#include <atomic>
+#include <memory>
+#include <singleton/singleton.hpp>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <string_view>
+
+namespace logger {
+enum class Subsystem : uint8_t {
+  GATEWAY, // default logger
+  HTTP,    // HTTPConnection & HandleMethod
+  REDIS,   // RedisContext
+  MYSQL,   // MySQLConnection
+  GRPC,    // gRPC services
+  SUBSYSTEM_COUNT
+};
+
+/*
+ * all loggers are asynchronous and share one bounded queue
+ * io threads only format and enqueue the message
+ */
+class LogManager : public Singleton<LogManager> {
+  friend class Singleton<LogManager>;
+  LogManager();
+
+public:
+  ~LogManager();
+
+  std::shared_ptr<spdlog::logger> &get(Subsystem subsystem);
+
+  /*request logs are sampled and rate limited, call this before logging*/
+  bool sampleRequest();
+
+  /*flush the queue, call it before spdlog::shutdown()*/
+  void shutdown();
+
+  /*replace values of sensitive json fields with "***"*/
+  static std::string redact(std::string_view body);
+
+private:
+  std::array<std::shared_ptr<spdlog::logger>,
+             static_cast<std::size_t>(Subsystem::SUBSYSTEM_COUNT)>
+      m_loggers;
+
+  std::size_t m_sample_rate;
+  std::size_t m_rate_limit;
+
+  /*sampling counter*/
+  std::atomic<std::size_t> m_requests;
+
+  /*rate limit window(second) and logs inside this window*/
+  std::atomic<long long> m_window;
+  std::atomic<std::size_t> m_window_logs;
+};
+
+inline std::shared_ptr<spdlog::logger> &http() {
+  return LogManager::get_instance()->get(Subsystem::HTTP);
+}
+inline std::shared_ptr<spdlog::logger> &redis() {
+  return LogManager::get_instance()->get(Subsystem::REDIS);
+}
+inline std::shared_ptr<spdlog::logger> &mysql() {
+  return LogManager::get_instance()->get(Subsystem::MYSQL);
+}
+inline std::shared_ptr<spdlog::logger> &grpc() {
+  return LogManager::get_instance()->get(Subsystem::GRPC);
+}
+} // namespace logger
+
+#endif // !_LOGMANAGER_HPP_
@@ -571,11 +571,11 @@ const char descriptor_table_protodef_message_2eproto[] PROTOBUF_SECTION_VARIABLE
   "equest\032\032.message.AuthoriseResponse\"\000\022Z\n\023"
   "SendChattingTextMsg\022\037.message.ChattingTe"
   "xtMsgRequest\032 .message.ChattingTextMsgRe"
-  "sponse\"\000b\006proto3"
+  "sponse\"\000B\003\370\001\001b\006proto3"
   ;
 static ::_pbi::once_flag descriptor_table_message_2eproto_once;
 const ::_pbi::DescriptorTable descriptor_table_message_2eproto = {
-    false, false, 2496, descriptor_table_protodef_message_2eproto,
+    false, false, 2501, descriptor_table_protodef_message_2eproto,
     "message.proto",
     &descriptor_table_message_2eproto_once, nullptr, 0, 19,
     schemas, file_default_instances, TableStruct_message_2eproto::offsets,
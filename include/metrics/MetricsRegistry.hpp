@@ -0,0 +1,142 @@
+#pragma once
+#ifndef _METRICSREGISTRY_HPP_
+#define _METRICSREGISTRY_HPP_
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <singleton/singleton.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace metrics {
+/*
+ * every metric is split into shards, every thread writes into its own shard
+ * with relaxed atomics, shards are merged when /metrics is scraped
+ */
+static constexpr std::size_t shard_count = 16;
+
+/*shard index of current thread*/
+std::size_t currentShard();
+
+class Counter {
+  struct alignas(64) Slot {
+    std::atomic<std::size_t> value{0};
+  };
+
+public:
+  void inc(std::size_t n = 1) {
+    m_slots[currentShard()].value.fetch_add(n, std::memory_order_relaxed);
+  }
+  std::size_t value() const;
+
+private:
+  std::array<Slot, shard_count> m_slots;
+};
+
+/*
+ * HDR-style log-linear histogram in microseconds
+ * every power of two is divided into 8 linear sub buckets(12.5% precision)
+ */
+class Histogram {
+public:
+  static constexpr std::size_t sub_bucket_bits = 3;
+  static constexpr std::size_t sub_buckets = 1 << sub_bucket_bits;
+  static constexpr std::size_t bucket_count = 256;
+
+  struct Snapshot {
+    std::array<std::size_t, bucket_count> buckets{};
+    std::size_t count = 0;
+    std::size_t sum = 0; // microseconds
+
+    /*q in [0, 1], returns microseconds*/
+    std::size_t percentile(double q) const;
+  };
+
+  void observe(std::chrono::nanoseconds duration);
+  void observeMicroseconds(std::size_t us);
+  Snapshot snapshot() const;
+
+  static std::size_t bucketIndex(std::size_t us);
+  static std::size_t bucketUpperBound(std::size_t index);
+
+private:
+  struct alignas(64) Shard {
+    std::array<std::atomic<std::size_t>, bucket_count> buckets{};
+    std::atomic<std::size_t> count{0};
+    std::atomic<std::size_t> sum{0};
+  };
+  std::array<Shard, shard_count> m_shards;
+};
+
+/*observe the time this object lives*/
+class ScopedTimer {
+public:
+  explicit ScopedTimer(Histogram &histogram)
+      : m_histogram(histogram), m_start(std::chrono::steady_clock::now()) {}
+  ~ScopedTimer() {
+    m_histogram.observe(std::chrono::steady_clock::now() - m_start);
+  }
+
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+  Histogram &m_histogram;
+  std::chrono::steady_clock::time_point m_start;
+};
+
+/*
+ * metrics are created once(normally during startup or in a function static)
+ * and referenced directly afterwards, hot path never searches the registry
+ */
+class MetricsRegistry : public Singleton<MetricsRegistry> {
+  friend class Singleton<MetricsRegistry>;
+  MetricsRegistry() = default;
+
+public:
+  ~MetricsRegistry() = default;
+
+  /*labels are in prometheus format, eg: route="/trylogin_server"*/
+  Counter &counter(std::string_view name, std::string_view help,
+                   std::string_view labels = {});
+  Histogram &histogram(std::string_view name, std::string_view help,
+                       std::string_view labels = {});
+
+  /*value is sampled when /metrics is scraped*/
+  void gauge(std::string_view name, std::string_view help,
+             std::string_view labels, std::function<double()> sampler);
+
+  /*prometheus text exposition format*/
+  std::string serialize();
+
+private:
+  enum class Type : uint8_t { COUNTER, GAUGE, HISTOGRAM };
+
+  struct Metric {
+    std::string name;
+    std::string help;
+    std::string labels;
+    Type type;
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Histogram> histogram;
+    std::function<double()> sampler;
+  };
+
+  Metric *find(std::string_view name, std::string_view labels);
+
+private:
+  std::mutex m_mtx;
+
+  /*metrics are never removed, keep registration order for output*/
+  std::vector<std::unique_ptr<Metric>> m_metrics;
+};
+
+/*status code counter of HTTP responses, created on first use*/
+Counter &httpResponses(unsigned status);
+} // namespace metrics
+
+#endif // !_METRICSREGISTRY_HPP_
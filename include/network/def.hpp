@@ -100,7 +100,10 @@ enum class ServiceStatus : uint8_t {
           FILE_UPLOAD_ERROR,  //file upload error
           FILE_CREATE_ERROR,
           FILE_OPEN_ERROR,
-          FILE_WRITE_ERROR
+          FILE_WRITE_ERROR,
+
+          SERVICE_OVERLOADED, // rejected by admission control, retry later
+          RATE_LIMITED        // too many requests from this client
 };
 
 #define _DEF_HPP_
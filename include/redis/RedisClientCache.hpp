@@ -0,0 +1,122 @@
+#pragma once
+#ifndef _REDISCLIENTCACHE_HPP_
+#define _REDISCLIENTCACHE_HPP_
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <metrics/MetricsRegistry.hpp>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tools/tools.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace redis {
+/*
+ * local copy of hot string keys, kept coherent by redis server-assisted client
+ * side caching. one RESP3 connection enables CLIENT TRACKING in BCAST mode for
+ * the configured prefixes, redis pushes an invalidation to it whenever one of
+ * those keys is modified by anyone, the entry is dropped locally.
+ *
+ * nothing is served while that connection is down, invalidations could have
+ * been missed, the whole cache is flushed once it is lost.
+ */
+class RedisClientCache {
+  struct Entry {
+    std::size_t hash;
+    std::string key;
+    std::string value;
+  };
+
+  struct alignas(64) Shard {
+    std::mutex mtx;
+
+    /*bumped by every invalidation, GETs older than it are not stored*/
+    std::uint64_t epoch = 0;
+    std::size_t bytes = 0;
+
+    /*front is the most recently used*/
+    std::list<Entry> order;
+    std::unordered_map<std::size_t, std::list<Entry>::iterator> index;
+  };
+
+  static constexpr std::size_t shard_count = 16;
+
+public:
+  /*
+   * prefixes "a:,b:" has to name at least one prefix, BCAST of every key
+   * would push each write to this process. max_bytes bounds keys and values
+   */
+  RedisClientCache(const std::string &ip, unsigned short port,
+                   const std::string &password, const std::string &prefixes,
+                   std::size_t max_bytes);
+  ~RedisClientCache();
+
+  RedisClientCache(const RedisClientCache &) = delete;
+  RedisClientCache &operator=(const RedisClientCache &) = delete;
+
+  /*key starts with one of the tracked prefixes*/
+  bool covers(std::string_view key) const;
+
+  std::optional<std::string> get(std::string_view key);
+
+  /*
+   * read before sending GET, the reply is only stored by put() when no
+   * invalidation of its shard arrived in between
+   */
+  std::uint64_t epoch(std::string_view key);
+  void put(std::string_view key, std::string value, std::uint64_t epoch);
+
+  /*drop key now, this process wrote it and won't wait for the push*/
+  void invalidate(std::string_view key);
+
+  std::size_t bytes();
+  void shutdown();
+
+private:
+  Shard &shard(std::size_t hash) { return m_shards[hash % shard_count]; }
+
+  /*drop everything and refuse GETs which were sent before*/
+  void flush();
+
+  /*dial, track and read invalidations until shutdown*/
+  void listen();
+  bool subscribe(redisContext *ctx);
+
+  /*handle pushes until the connection fails or stays silent after a PING*/
+  void receive(redisContext *ctx, std::chrono::milliseconds interval);
+  void handlePush(const redisReply *reply);
+
+private:
+  std::string m_ip;
+  unsigned short m_port;
+  std::string m_password;
+  std::vector<std::string> m_prefixes;
+  std::size_t m_shard_bytes;
+
+  std::array<Shard, shard_count> m_shards;
+
+  /*entries are only served while invalidations are being received*/
+  std::atomic<bool> m_tracking{false};
+
+  std::atomic<bool> m_stop{false};
+  std::mutex m_mtx;
+  std::condition_variable m_cv;
+
+  /*socket of the tracking connection, shut down to wake up the listener*/
+  int m_listener_fd = -1;
+  std::thread m_thread;
+
+  metrics::Counter *m_hits;
+  metrics::Counter *m_misses;
+  metrics::Counter *m_invalidations;
+};
+} // namespace redis
+
+#endif // !_REDISCLIENTCACHE_HPP_
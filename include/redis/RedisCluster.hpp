@@ -0,0 +1,101 @@
+#pragma once
+#ifndef _REDISCLUSTER_HPP_
+#define _REDISCLUSTER_HPP_
+#include <array>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <redis/RedisContextRAII.hpp>
+#include <service/ConnectionPool.hpp>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace redis {
+/*connections to one node of the cluster, address is "host:port"*/
+class RedisNodePool
+    : public connection::ConnectionPool<RedisNodePool, redis::RedisContext> {
+  using context = redis::RedisContext;
+  using context_ptr = std::unique_ptr<context>;
+
+public:
+  RedisNodePool(const std::string &address, const std::string &password);
+  ~RedisNodePool() { shutdown(); }
+
+  const std::string &address() const { return m_address; }
+
+private:
+  std::string m_address;
+  std::string m_host;
+  unsigned short m_port;
+  std::string m_password;
+};
+
+/*
+ * slot -> node map of a Redis Cluster. commands are sent to the node which
+ * owns the hash slot of their key, MOVED updates the map and ASK is followed
+ * once without updating it. the whole map is reloaded by CLUSTER SLOTS after
+ * MOVED or a lost node, at most once per refresh interval
+ */
+class RedisCluster {
+public:
+  static constexpr std::size_t slot_count = 16384;
+
+  /*send one command on node, asking means ASKING has to be sent first*/
+  using command = std::function<redisReply *(redisContext *node, bool asking)>;
+
+  RedisCluster(const std::string &seeds, const std::string &password,
+               std::size_t max_redirects,
+               std::chrono::milliseconds refresh_interval);
+  ~RedisCluster();
+
+  /*CRC16 of key, only the first non-empty {tag} is hashed if there is one*/
+  static std::uint16_t slot(std::string_view key);
+
+  /*load the slot map and dial every master in parallel*/
+  void warmup();
+
+  /*every slot has a master whose connections are up*/
+  bool ready();
+  void shutdown();
+
+  /*
+   * send to the master of key's slot and follow redirections. the last reply
+   * is kept by whoever send stored it in
+   */
+  void execute(std::string_view key, const command &send);
+
+private:
+  /*get or create the pool of address*/
+  RedisNodePool *node(const std::string &address);
+  RedisNodePool *owner(std::uint16_t slot);
+
+  bool refresh();
+  void refreshIfDue();
+
+private:
+  std::string m_password;
+  std::size_t m_max_redirects;
+  std::chrono::milliseconds m_refresh_interval;
+
+  /*tried in order when the slot map is loaded for the first time*/
+  std::vector<std::string> m_seeds;
+
+  std::shared_mutex m_mtx;
+  std::map<std::string, std::unique_ptr<RedisNodePool>> m_nodes;
+  std::array<RedisNodePool *, slot_count> m_slots{};
+  std::vector<RedisNodePool *> m_masters;
+
+  /*only one thread reloads the map, the others keep following redirects*/
+  std::mutex m_refresh_mtx;
+  std::chrono::steady_clock::time_point m_last_refresh;
+
+  metrics::Counter *m_moved;
+  metrics::Counter *m_asked;
+  metrics::Counter *m_refreshes;
+};
+} // namespace redis
+
+#endif // !_REDISCLUSTER_HPP_
@@ -1,13 +1,19 @@
 #pragma once
 #ifndef _REDISCONTEXTRAII_HPP_
 #define _REDISCONTEXTRAII_HPP_
+#include <initializer_list>
+#include <redis/RedisScript.hpp>
 #include <string>
 #include <string_view>
 #include <tools/tools.hpp>
 
 namespace redis {
+class RedisCluster;
+class RedisClientCache;
+
 class RedisContext {
   friend class RedisReply;
+  friend class RedisCluster;
 
   /*also remove copy ctor*/
   RedisContext(const RedisContext &) = delete;
@@ -20,9 +26,16 @@ public:
   ~RedisContext() = default;
   RedisContext() noexcept;
 
-  /*connect to redis automatically*/
+  /*connect to redis automatically, GETs of tracked keys go through cache*/
   RedisContext(const std::string &ip, unsigned short port,
-               const std::string &password) noexcept;
+               const std::string &password,
+               RedisClientCache *cache = nullptr) noexcept;
+
+  /*
+   * cluster mode, holds no connection itself. every command is sent to the
+   * node owning its key
+   */
+  explicit RedisContext(RedisCluster *cluster) noexcept;
 
   /*RedisTools will shutdown connection automatically!*/
   void close() = delete;
@@ -45,14 +58,40 @@ public:
   std::optional<std::string> getValueFromHash(const std::string &key,
                                               const std::string &field);
 
+  /*
+   * EVALSHA a lua script on one key, script has to return an integer. the
+   * source is sent by EVAL only when the server has lost its script cache
+   */
+  std::optional<long long>
+  evalInteger(const RedisScript &script, std::string_view key,
+              std::initializer_list<std::string_view> args);
+
+  /*
+   * replace value by desired when it equals expected, in one round trip
+   * 1: replaced, 0: value differs, -1: no such key, nullopt when redis failed
+   */
+  std::optional<int> swapValue(const std::string &key,
+                               std::string_view expected,
+                               std::string_view desired);
+
   std::optional<tools::RedisContextWrapper> operator->();
 
+private:
+  /*SCRIPT LOAD every registered script, connection setup only*/
+  void loadScripts();
+
 private:
   /*if check error failed, m_valid will be set to false*/
   bool m_valid;
 
   /*redis context*/
   tools::RedisSmartPtr<redisContext> m_redisContext;
+
+  /*nullptr unless cluster mode*/
+  RedisCluster *m_cluster = nullptr;
+
+  /*nullptr unless client tracking is enabled*/
+  RedisClientCache *m_cache = nullptr;
 };
 } // namespace redis
 
@@ -2,6 +2,8 @@
 #ifndef _REDISMANAGER_HPP_
 #define _REDISMANAGER_HPP_
 #include <config/ServerConfig.hpp>
+#include <redis/RedisClientCache.hpp>
+#include <redis/RedisCluster.hpp>
 #include <redis/RedisReplyRAII.hpp>
 #include <service/ConnectionPool.hpp>
 #include <spdlog/spdlog.h>
@@ -16,20 +18,95 @@ class RedisConnectionPool
   friend class Singleton<RedisConnectionPool>;
 
   RedisConnectionPool() {
+    auto config = ServerConfig::get_instance();
+    if (config->RedisCluster_enabled) {
+      if (config->RedisTracking_enabled) {
+        spdlog::warn("Redis client tracking is not supported by cluster mode");
+      }
+      const std::string seeds =
+          config->RedisCluster_seeds.empty()
+              ? config->Redis_ip_addr + ':' + std::to_string(config->Redis_port)
+              : config->RedisCluster_seeds;
+      spdlog::info("Connecting to Redis Cluster seeds: {}", seeds);
+      m_cluster = std::make_unique<RedisCluster>(
+          seeds, config->Redis_passwd, config->RedisCluster_max_redirects,
+          std::chrono::milliseconds(config->RedisCluster_refresh_interval_ms));
+
+      /*contexts only route commands, connections belong to node pools*/
+      setFactory(
+          [this]() -> context_ptr {
+            return std::make_unique<context>(m_cluster.get());
+          },
+          config->Warmup_lazy, config->Warmup_minimum);
+      registerMetrics("redis");
+      return;
+    }
+
     spdlog::info("Connecting to Redis service ip: {0}, port: {1}",
                  ServerConfig::get_instance()->Redis_ip_addr.c_str(),
                  ServerConfig::get_instance()->Redis_port);
 
-    for (std::size_t i = 0; i < m_queue_size; ++i) {
-      m_stub_queue.push(std::move(std::make_unique<context>(
-          ServerConfig::get_instance()->Redis_ip_addr,
-          ServerConfig::get_instance()->Redis_port,
-          ServerConfig::get_instance()->Redis_passwd)));
+    /*one more connection which only receives invalidations*/
+    if (config->RedisTracking_enabled &&
+        config->RedisTracking_prefixes.find_first_not_of(", ") ==
+            std::string::npos) {
+      spdlog::warn("Redis client tracking needs at least one prefix, it "
+                   "stays disabled");
+    } else if (config->RedisTracking_enabled) {
+      m_tracking = std::make_unique<RedisClientCache>(
+          config->Redis_ip_addr, config->Redis_port, config->Redis_passwd,
+          config->RedisTracking_prefixes, config->RedisTracking_max_bytes);
     }
+
+    /*connections are dialed by warmup() and acquire()*/
+    setFactory(
+        [this]() -> context_ptr {
+          auto config = ServerConfig::get_instance();
+          auto ctx = std::make_unique<context>(
+              config->Redis_ip_addr, config->Redis_port, config->Redis_passwd,
+              m_tracking.get());
+          return ctx->isValid() ? std::move(ctx) : nullptr;
+        },
+        ServerConfig::get_instance()->Warmup_lazy,
+        ServerConfig::get_instance()->Warmup_minimum);
+
+    /*hiredis contexts can not be used anymore after an I/O error*/
+    setHealthCheck([](context &ctx) { return ctx.isValid(); });
+    registerMetrics("redis");
   }
 
 public:
-  ~RedisConnectionPool() = default;
+  ~RedisConnectionPool() { shutdown(); }
+
+  /*cluster mode loads the slot map before dialing every master*/
+  void warmup() {
+    if (m_cluster != nullptr) {
+      m_cluster->warmup();
+    }
+    ConnectionPool::warmup();
+  }
+
+  bool ready() {
+    return ConnectionPool::ready() &&
+           (m_cluster == nullptr || m_cluster->ready());
+  }
+
+  void shutdown() {
+    ConnectionPool::shutdown();
+    if (m_cluster != nullptr) {
+      m_cluster->shutdown();
+    }
+    if (m_tracking != nullptr) {
+      m_tracking->shutdown();
+    }
+  }
+
+private:
+  /*nullptr unless [RedisCluster] is enabled*/
+  std::unique_ptr<RedisCluster> m_cluster;
+
+  /*nullptr unless [RedisTracking] is enabled*/
+  std::unique_ptr<RedisClientCache> m_tracking;
 };
 } // namespace redis
 #endif
@@ -1,8 +1,13 @@
 #pragma once
 #ifndef _REDISREPLYRAII_HPP_
 #define _REDISREPLYRAII_HPP_
+#include <functional>
+#include <metrics/MetricsRegistry.hpp>
 #include <redis/RedisContextRAII.hpp>
 #include <tools/tools.hpp>
+#include <string_view>
+#include <trace/Tracer.hpp>
+#include <vector>
 
 namespace redis {
 class RedisReply {
@@ -19,12 +24,30 @@ public:
   template <typename... Args>
   bool redisCommand(RedisContext &context, const std::string &command,
                     Args &&...args) {
+    trace::Span span("redis.command",
+                     std::string_view(command).substr(0, command.find(' ')),
+                     trace::SpanKind::CLIENT);
+    metrics::ScopedTimer timer(commandLatency(command));
+    if (context.m_cluster != nullptr) {
+      routeCommand(context, firstKey(args...), [&](redisContext *node) {
+        return ::redisCommand(node, command.c_str(), args...);
+      });
+      return isSuccessful();
+    }
     m_redisReply.reset(reinterpret_cast<redisReply *>(
         ::redisCommand(context.m_redisContext.get(), command.c_str(),
                        std::forward<Args>(args)...)));
     return isSuccessful();
   }
 
+  /*
+   * binary safe, every argument is sent as it is, argv[0] is the command.
+   * key decides which node serves it in cluster mode
+   */
+  bool redisCommandArgv(RedisContext &context,
+                        const std::vector<std::string_view> &argv,
+                        std::string_view key = {});
+
 public:
   std::optional<long long> getInterger() const;
   std::optional<int> getType() const;
@@ -33,6 +56,20 @@ public:
 private:
   bool isSuccessful() const;
 
+  /*every keyed command passes its key as the first argument*/
+  template <typename... Rest>
+  static std::string_view firstKey(const char *key, Rest &&...) {
+    return key;
+  }
+  static std::string_view firstKey() { return {}; }
+
+  /*send by RedisCluster, the reply of the last node is kept*/
+  void routeCommand(RedisContext &context, std::string_view key,
+                    const std::function<void *(redisContext *)> &send);
+
+  /*latency histogram labeled by command name, eg: "GET %s" -> GET*/
+  static metrics::Histogram &commandLatency(std::string_view command);
+
 private:
   tools::RedisSmartPtr<redisReply> m_redisReply;
 };
@@ -0,0 +1,44 @@
+#pragma once
+#ifndef _REDISSCRIPT_HPP_
+#define _REDISSCRIPT_HPP_
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace redis {
+/*
+ * lua script which every RedisContext loads by SCRIPT LOAD once connected,
+ * afterwards only its sha1 is sent by EVALSHA. has to be a static object so
+ * it is registered before the first connection is dialed
+ */
+class RedisScript {
+public:
+  explicit RedisScript(std::string_view source);
+
+  RedisScript(const RedisScript &) = delete;
+  RedisScript &operator=(const RedisScript &) = delete;
+
+  std::string_view source() const { return m_source; }
+  std::string_view sha() const { return m_sha; }
+
+  /*every script constructed so far*/
+  static const std::vector<const RedisScript *> &registered();
+
+private:
+  static std::vector<const RedisScript *> &registry();
+
+private:
+  std::string_view m_source;
+  std::string m_sha;
+};
+
+namespace scripts {
+/*
+ * set KEYS[1] to ARGV[2] only when its value equals ARGV[1], keeping its time
+ * to live. 1: replaced, 0: value differs, -1: no such key
+ */
+extern const RedisScript compare_and_swap;
+} // namespace scripts
+} // namespace redis
+
+#endif // !_REDISSCRIPT_HPP_
@@ -1,31 +1,72 @@
 #pragma once
 #ifndef _GATESERVER_HPP_
 #define _GATESERVER_HPP_
-#include <map>
-#include <server/session.hpp>
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <memory>
+
+class HTTPConnection;
+
+namespace metrics {
+class Counter;
+}
 
 class GateServer : public std::enable_shared_from_this<GateServer> {
+  friend class HTTPConnection;
+
 public:
+  using native_handle_type =
+      boost::asio::ip::tcp::acceptor::native_handle_type;
+
   GateServer(boost::asio::io_context &_ioc, unsigned short port);
+
+  /*adopt a listening socket handed over by the previous process*/
+  GateServer(boost::asio::io_context &_ioc, native_handle_type listener);
   ~GateServer();
 
 public:
   void serverStart();
 
+  /*
+   * stop accepting new connections, connections which have been accepted
+   * are still served. the listening socket is closed in this process only
+   */
+  void stopAccept();
+
+  /*
+   * block until every accepted connection is recycled or timeout expires
+   * return false when some connections are still alive
+   */
+  bool drain(std::chrono::milliseconds timeout);
+
+  /*listening socket, passed to the next process by hot restart*/
+  native_handle_type listener();
+
+  /*amount of HTTPConnection which is still alive*/
+  std::size_t openConnections() const;
+
 private:
-  void handleAccept(std::shared_ptr<Session<GateServer>> session,
+  void handleAccept(std::shared_ptr<HTTPConnection> http,
                     boost::system::error_code ec);
-  void terminateSession(const std::string &uuid);
+
+  /*called by HTTPConnection when it is recycled*/
+  void releaseConnection();
+
+  /*accept counter and open connection gauges*/
+  void registerMetrics();
 
 private:
-  /*create a mutex to protect m_sessions*/
-  std::mutex m_mtx;
   boost::asio::io_context &m_ioc;
   boost::asio::ip::tcp::acceptor m_acceptor;
-  std::map<
-      /*uuid            */ std::string,
-      /*connections*/ std::shared_ptr<Session<GateServer>>>
-      m_sessions;
+
+  /*increase after accept, decrease when HTTPConnection recycled*/
+  std::atomic<std::size_t> m_connections;
+
+  /*cleared by stopAccept(), pending accepts are not issued again*/
+  std::atomic<bool> m_accepting;
+
+  metrics::Counter *m_accepted = nullptr;
 };
 
 #endif // !_GATESERVER_HPP_
@@ -0,0 +1,58 @@
+#pragma once
+#ifndef _LISTENERHANDOFF_HPP_
+#define _LISTENERHANDOFF_HPP_
+#include <boost/asio.hpp>
+#include <functional>
+#include <optional>
+#include <string>
+
+/*
+ * hot restart without a connection refused window.
+ * the running process serves a unix socket, a new process connects to it and
+ * receives the listening socket by SCM_RIGHTS. both processes accept from the
+ * same socket until the new one acknowledges, then the old one drains.
+ */
+class ListenerHandoff {
+public:
+  using native_handle_type = int;
+  using callback = std::function<void()>;
+
+  /*empty path disables hot restart*/
+  ListenerHandoff(boost::asio::io_context &_ioc, const std::string &path);
+  ~ListenerHandoff();
+
+  /*
+   * new process: fetch the listening socket from the running process
+   * nullopt when no process is serving the path
+   */
+  std::optional<native_handle_type> receive();
+
+  /*new process: tell previous process that this process is accepting*/
+  void acknowledge();
+
+  /*
+   * running process: pass listener to whoever connects to the path,
+   * on_handoff is called on _ioc after the new process acknowledges
+   */
+  void serve(native_handle_type listener, callback on_handoff);
+
+  /*stop serving, the path is left to the process which replaces us*/
+  void close();
+
+private:
+  void accept();
+  void transfer(std::shared_ptr<boost::asio::local::stream_protocol::socket>
+                    peer);
+
+private:
+  std::string m_path;
+  boost::asio::local::stream_protocol::acceptor m_acceptor;
+
+  /*connection to the previous process, kept until acknowledge()*/
+  native_handle_type m_previous = -1;
+
+  native_handle_type m_listener = -1;
+  callback m_on_handoff;
+};
+
+#endif // !_LISTENERHANDOFF_HPP_
@@ -0,0 +1,61 @@
+#pragma once
+#ifndef _CPUWORKERPOOL_HPP_
+#define _CPUWORKERPOOL_HPP_
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <singleton/singleton.hpp>
+#include <thread>
+#include <vector>
+
+namespace metrics {
+class Counter;
+class Histogram;
+} // namespace metrics
+
+/*
+ * threads for cpu bound work(password hashing), separated from IOServicePool
+ * so a burst of logins never delays reading and writing sockets. tasks post
+ * their result back to the io_context they came from.
+ */
+class CPUWorkerPool : public Singleton<CPUWorkerPool> {
+  friend class Singleton<CPUWorkerPool>;
+  using task = std::function<void()>;
+
+public:
+  ~CPUWorkerPool();
+  void shutdown();
+
+  /*false when queue is full or pool is stopped, task is not run then*/
+  bool submit(task &&fn);
+
+  std::size_t size() const;
+  std::size_t pending();
+
+private:
+  CPUWorkerPool();
+  CPUWorkerPool(std::size_t threads, std::size_t queue_limit);
+
+  void run();
+
+private:
+  struct Pending {
+    task fn;
+    std::chrono::steady_clock::time_point queued;
+  };
+
+  std::size_t m_queue_limit;
+  bool m_stop = false;
+
+  std::mutex m_mtx;
+  std::condition_variable m_cv;
+  std::deque<Pending> m_queue;
+  std::vector<std::thread> m_threads;
+
+  metrics::Counter *m_rejected;
+  metrics::Histogram *m_queue_wait;
+};
+
+#endif // !_CPUWORKERPOOL_HPP_
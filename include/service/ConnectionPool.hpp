@@ -2,14 +2,21 @@
 #ifndef _CONNECTIONPOOOL_HPP_
 #define _CONNECTIONPOOOL_HPP_
 
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
+#include <config/ServerConfig.hpp>
+#include <deque>
+#include <functional>
+#include <metrics/MetricsRegistry.hpp>
 #include <mutex>
 #include <optional>
-#include <queue>
+#include <random>
 #include <singleton/singleton.hpp>
 #include <thread>
 #include <tools/tools.hpp>
+#include <trace/Tracer.hpp>
+#include <vector>
 
 namespace connection {
 /*please pass your new pool as template parameter*/
@@ -34,35 +41,275 @@ public:
     /*set stop flag to true*/
     m_stop = true;
     m_cv.notify_all();
+    m_reconnect_cv.notify_all();
 
-    std::lock_guard<std::mutex> _lckg(m_mtx);
-    while (!m_stub_queue.empty()) {
-      m_stub_queue.pop();
+    {
+      std::lock_guard<std::mutex> _lckg(m_mtx);
+      m_stub_queue.clear();
+    }
+
+    /*an ongoing dial is finished before reconnector exits*/
+    if (m_reconnector.joinable()) {
+      m_reconnector.join();
     }
   }
 
+  /*
+   * nullopt when pool is stopped, or when no connection is released within
+   * acquire timeout, e.g. while every connection is reconnecting
+   */
   std::optional<stub_ptr> acquire() {
+    auto start = std::chrono::steady_clock::now();
     std::unique_lock<std::mutex> _lckg(m_mtx);
-    m_cv.wait(_lckg, [this]() { return !m_stub_queue.empty() || m_stop; });
+    for (;;) {
+      /*check m_stop flag*/
+      if (m_stop) {
+        observeWait(start);
+        return std::nullopt;
+      }
+      if (!m_stub_queue.empty()) {
+        stub_ptr temp = std::move(m_stub_queue.front());
+        m_stub_queue.pop_front();
+        observeWait(start);
+        return temp;
+      }
 
-    /*check m_stop flag*/
-    if (m_stop) {
-      return std::nullopt;
+      /*lazy mode, dial one of the connections which warmup() skipped*/
+      if (m_factory && m_created < m_queue_size) {
+        ++m_created;
+        _lckg.unlock();
+        stub_ptr temp = m_factory();
+        _lckg.lock();
+        if (temp != nullptr) {
+          m_connected.fetch_add(1, std::memory_order_relaxed);
+          observeWait(start);
+          return temp;
+        }
+
+        /*leave it to reconnector, wait for a healthy one instead*/
+        markBroken();
+        continue;
+      }
+
+      if (m_acquire_timeout.count() == 0) {
+        m_cv.wait(_lckg);
+      } else if (m_cv.wait_until(_lckg, start + m_acquire_timeout) ==
+                     std::cv_status::timeout &&
+                 m_stub_queue.empty() && !m_stop) {
+        observeWait(start);
+        if (m_acquire_timeouts != nullptr) {
+          m_acquire_timeouts->inc();
+        }
+        return std::nullopt;
+      }
     }
-    stub_ptr temp = std::move(m_stub_queue.front());
-    m_stub_queue.pop();
-    return temp;
   }
 
+  /*
+   * dial minimum connections in parallel and block until all of them are
+   * finished, the rest are dialed by acquire() on demand
+   */
+  void warmup() {
+    std::vector<std::thread> dialers;
+    {
+      std::lock_guard<std::mutex> _lckg(m_mtx);
+      while (dialers.size() < m_minimum && m_created < m_queue_size) {
+        ++m_created;
+        dialers.emplace_back([this]() {
+          stub_ptr stub = m_factory();
+          std::lock_guard<std::mutex> _lckg(m_mtx);
+          if (stub == nullptr) {
+            markBroken();
+            return;
+          }
+          m_connected.fetch_add(1, std::memory_order_relaxed);
+          m_stub_queue.push_back(std::move(stub));
+          m_cv.notify_one();
+        });
+      }
+    }
+    for (auto &dialer : dialers) {
+      dialer.join();
+    }
+  }
+
+  /*minimum connections are established*/
+  bool ready() const {
+    return m_connected.load(std::memory_order_relaxed) >= m_minimum;
+  }
+
+  const std::string &name() const { return m_name; }
+
   void release(stub_ptr stub) {
     if (m_stop) {
       return;
     }
+
+    /*drop broken connection, reconnector dials a replacement*/
+    if (m_healthy && !m_healthy(*stub)) {
+      m_connected.fetch_sub(1, std::memory_order_relaxed);
+      {
+        std::lock_guard<std::mutex> _lckg(m_mtx);
+        markBroken();
+      }
+      stub.reset();
+      return;
+    }
+
     std::lock_guard<std::mutex> _lckg(m_mtx);
-    m_stub_queue.push(std::move(stub));
+    m_stub_queue.push_back(std::move(stub));
     m_cv.notify_one();
   }
 
+  /*
+   * take one specific connection out of the pool, only when it is idle
+   * inside the queue. which is compared, never dereferenced
+   */
+  std::optional<stub_ptr> claim(const stub *which) {
+    std::lock_guard<std::mutex> _lckg(m_mtx);
+    auto it = std::find_if(
+        m_stub_queue.begin(), m_stub_queue.end(),
+        [which](const stub_ptr &idle) { return idle.get() == which; });
+    if (m_stop || it == m_stub_queue.end()) {
+      return std::nullopt;
+    }
+    stub_ptr temp = std::move(*it);
+    m_stub_queue.erase(it);
+    return temp;
+  }
+
+  /*connections which are being reconnected*/
+  std::size_t broken() {
+    std::lock_guard<std::mutex> _lckg(m_mtx);
+    return m_broken;
+  }
+
+protected:
+  /*
+   * connections are dialed by factory instead of being pushed by the
+   * constructor, nullptr means dialing failed. lazy pools only dial minimum
+   * connections in warmup(), the others dial all of them
+   */
+  void setFactory(std::function<stub_ptr()> factory, bool lazy,
+                  std::size_t minimum) {
+    auto config = ServerConfig::get_instance();
+    m_factory = std::move(factory);
+    m_minimum = lazy ? std::min(minimum, m_queue_size) : m_queue_size;
+    m_initial_backoff =
+        std::chrono::milliseconds(config->Reconnect_initial_backoff_ms);
+    m_max_backoff = std::chrono::milliseconds(
+        std::max(config->Reconnect_max_backoff_ms,
+                 config->Reconnect_initial_backoff_ms));
+    m_acquire_timeout =
+        std::chrono::milliseconds(config->Reconnect_acquire_timeout_ms);
+  }
+
+  /*
+   * released connections which fail the check are dropped and dialed again,
+   * pools without it(gRPC channels reconnect by themselves) keep all of them
+   */
+  void setHealthCheck(std::function<bool(stub &)> healthy) {
+    m_healthy = std::move(healthy);
+  }
+
+  /*export acquire wait time and idle stubs, labeled by pool name*/
+  void registerMetrics(const std::string &pool) {
+    m_name = pool;
+    auto registry = metrics::MetricsRegistry::get_instance();
+    const std::string labels = "pool=\"" + pool + "\"";
+
+    m_acquire_wait = &registry->histogram(
+        "gateway_pool_acquire_wait_seconds",
+        "Time spent waiting for a pooled connection", labels);
+
+    registry->gauge("gateway_pool_idle", "Idle connections inside the pool",
+                    labels, [this]() {
+                      std::lock_guard<std::mutex> _lckg(m_mtx);
+                      return static_cast<double>(m_stub_queue.size());
+                    });
+    registry->gauge("gateway_pool_size", "Configured connections of the pool",
+                    labels,
+                    [this]() { return static_cast<double>(m_queue_size); });
+    registry->gauge("gateway_pool_ready",
+                    "1 once minimum connections are established", labels,
+                    [this]() { return ready() ? 1.0 : 0.0; });
+    registry->gauge("gateway_pool_broken",
+                    "Connections waiting to be reconnected", labels,
+                    [this]() { return static_cast<double>(broken()); });
+
+    m_reconnects = &registry->counter(
+        "gateway_pool_reconnects_total",
+        "Reconnect attempts of broken connections",
+        labels + ",result=\"success\"");
+    m_reconnect_failures = &registry->counter(
+        "gateway_pool_reconnects_total",
+        "Reconnect attempts of broken connections",
+        labels + ",result=\"failure\"");
+    m_acquire_timeouts = &registry->counter(
+        "gateway_pool_acquire_timeouts_total",
+        "Acquires which found no healthy connection in time", labels);
+  }
+
+private:
+  /*m_mtx is held, the slot stays reserved until reconnector fills it*/
+  void markBroken() {
+    ++m_broken;
+    if (!m_reconnector.joinable() && !m_stop) {
+      m_reconnector = std::thread([this]() { reconnect(); });
+    }
+    m_reconnect_cv.notify_one();
+  }
+
+  /*
+   * dial broken connections one by one, wait with exponential backoff after
+   * each failure. full jitter keeps gateways from reconnecting in lockstep
+   */
+  void reconnect() {
+    thread_local std::mt19937 engine{std::random_device{}()};
+    std::chrono::milliseconds backoff = m_initial_backoff;
+
+    std::unique_lock<std::mutex> _lckg(m_mtx);
+    for (;;) {
+      m_reconnect_cv.wait(_lckg, [this]() { return m_stop || m_broken > 0; });
+      if (m_stop) {
+        return;
+      }
+
+      _lckg.unlock();
+      stub_ptr stub = m_factory();
+      _lckg.lock();
+      if (m_stop) {
+        return;
+      }
+
+      if (stub != nullptr) {
+        --m_broken;
+        m_connected.fetch_add(1, std::memory_order_relaxed);
+        m_stub_queue.push_back(std::move(stub));
+        m_cv.notify_one();
+        if (m_reconnects != nullptr) {
+          m_reconnects->inc();
+        }
+        backoff = m_initial_backoff;
+        continue;
+      }
+
+      if (m_reconnect_failures != nullptr) {
+        m_reconnect_failures->inc();
+      }
+      std::uniform_int_distribution<long long> jitter(0, backoff.count());
+      m_reconnect_cv.wait_for(_lckg, std::chrono::milliseconds(jitter(engine)),
+                              [this]() { return m_stop.load(); });
+      backoff = std::min(backoff * 2, m_max_backoff);
+    }
+  }
+
+  void observeWait(std::chrono::steady_clock::time_point start) {
+    if (m_acquire_wait != nullptr) {
+      m_acquire_wait->observe(std::chrono::steady_clock::now() - start);
+    }
+  }
+
 protected:
   /*Stubpool stop flag*/
   std::atomic<bool> m_stop;
@@ -74,8 +321,39 @@ protected:
   std::mutex m_mtx;
   std::condition_variable m_cv;
 
-  /*stub queue*/
-  std::queue<stub_ptr> m_stub_queue;
+  /*stub queue, front is the least recently released*/
+  std::deque<stub_ptr> m_stub_queue;
+
+  /*pool name, used by metrics and tracing*/
+  std::string m_name;
+
+  /*nullptr until registerMetrics() is called*/
+  metrics::Histogram *m_acquire_wait = nullptr;
+
+  /*empty when the constructor pushes stubs itself*/
+  std::function<stub_ptr()> m_factory;
+
+  /*nullptr keeps every released connection*/
+  std::function<bool(stub &)> m_healthy;
+
+  /*dialed or being dialed by factory, guarded by m_mtx*/
+  std::size_t m_created = 0;
+  std::size_t m_minimum = 0;
+  std::atomic<std::size_t> m_connected{0};
+
+  /*slots whose connection failed, reconnector dials them again*/
+  std::size_t m_broken = 0;
+  std::thread m_reconnector;
+  std::condition_variable m_reconnect_cv;
+  std::chrono::milliseconds m_initial_backoff{100};
+  std::chrono::milliseconds m_max_backoff{10000};
+
+  /*0 waits until a connection is released*/
+  std::chrono::milliseconds m_acquire_timeout{0};
+
+  metrics::Counter *m_reconnects = nullptr;
+  metrics::Counter *m_reconnect_failures = nullptr;
+  metrics::Counter *m_acquire_timeouts = nullptr;
 };
 
 /*
@@ -85,9 +363,14 @@ template <typename WhichPool, typename _Type> class ConnectionRAII {
   using wrapper = tools::ResourcesWrapper<_Type>;
 
 public:
-  ConnectionRAII() : status(true) {
-    auto optional = WhichPool::get_instance()->acquire();
+  ConnectionRAII() : ConnectionRAII(WhichPool::get_instance().get()) {}
+
+  /*acquire from one specific instance of WhichPool, e.g. a replica*/
+  explicit ConnectionRAII(WhichPool *pool) : status(true), m_pool(pool) {
+    trace::Span span("pool.acquire", m_pool->name());
+    auto optional = m_pool->acquire();
     if (!optional.has_value()) {
+      span.setError();
       status = false;
     } else {
       m_stub = std::move(optional.value());
@@ -95,7 +378,7 @@ public:
   }
   virtual ~ConnectionRAII() {
     if (status) {
-      WhichPool::get_instance()->release(std::move(m_stub));
+      m_pool->release(std::move(m_stub));
 
       /*StubRAII failed!!*/
       status = false;
@@ -108,8 +391,12 @@ public:
     return std::nullopt;
   }
 
+  /*false when no connection is acquired, check it before operator->*/
+  explicit operator bool() const { return status; }
+
 private:
   std::atomic<bool> status; // load stub success flag
+  WhichPool *m_pool;
   std::unique_ptr<_Type> m_stub;
 };
 } // namespace connection
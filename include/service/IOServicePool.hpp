@@ -3,6 +3,7 @@
 #define _IOSERVICEPOOL_HPP_
 #include <atomic>
 #include <boost/asio.hpp>
+#include <service/TimingWheel.hpp>
 #include <singleton/singleton.hpp>
 
 class IOServicePool : public Singleton<IOServicePool> {
@@ -16,6 +17,18 @@ public:
   void shutdown();
   boost::asio::io_context &getIOServiceContext();
 
+  /*amount of io_context inside this pool*/
+  std::size_t size() const;
+
+  /*
+   * locate io_context's position in this pool, used by per io_context states
+   * size() when ioc doesn't belong to this pool
+   */
+  std::size_t getIOServiceIndex(const boost::asio::io_context &ioc) const;
+
+  /*every io_context owns one timing wheel, only use it on that io_context*/
+  connection::TimingWheel &getTimingWheel(const boost::asio::io_context &ioc);
+
 private:
   IOServicePool();
   IOServicePool(std::size_t threads);
@@ -34,6 +47,9 @@ private:
 
   /*preventing io_context from exitting*/
   std::vector<work_ptr> m_work_pool;
+
+  /*destroyed before m_ioc_pool*/
+  std::vector<std::unique_ptr<connection::TimingWheel>> m_wheels;
 };
 
 #endif // !_IOSERVICEPOOL_HPP_
@@ -0,0 +1,191 @@
+#pragma once
+#ifndef _RECYCLEPOOL_HPP_
+#define _RECYCLEPOOL_HPP_
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace connection {
+/*
+ * Recycle objects instead of destroying them.
+ * _Ty has to provide void recycle(), which resets its state but keeps all the
+ * buffers it already owns, so the next user could reuse them directly.
+ *
+ * Objects are handed out as std::shared_ptr, the control block is also
+ * allocated from this pool, so steady-state acquire/release does not touch
+ * the heap at all.
+ */
+template <typename _Ty> class RecyclePool {
+  /*shared_ptr control block storage (pointer + deleter + allocator)*/
+  static constexpr std::size_t block_size = 64;
+  static constexpr std::size_t block_align = alignof(std::max_align_t);
+
+  struct Deleter {
+    void operator()(_Ty *ptr) const { pool->recycle(ptr); }
+    RecyclePool *pool;
+  };
+
+  template <typename _Block> struct BlockAllocator {
+    using value_type = _Block;
+
+    BlockAllocator(RecyclePool *_pool) noexcept : pool(_pool) {}
+    template <typename _Other>
+    BlockAllocator(const BlockAllocator<_Other> &other) noexcept
+        : pool(other.pool) {}
+
+    _Block *allocate(std::size_t n) {
+      return static_cast<_Block *>(pool->allocateBlock(n * sizeof(_Block)));
+    }
+    void deallocate(_Block *ptr, std::size_t n) noexcept {
+      pool->deallocateBlock(ptr, n * sizeof(_Block));
+    }
+
+    template <typename _Other>
+    bool operator==(const BlockAllocator<_Other> &other) const noexcept {
+      return pool == other.pool;
+    }
+    template <typename _Other>
+    bool operator!=(const BlockAllocator<_Other> &other) const noexcept {
+      return pool != other.pool;
+    }
+
+    RecyclePool *pool;
+  };
+
+public:
+  struct Statistic {
+    std::size_t created;  // objects allocated by operator new
+    std::size_t reused;   // objects handed out from free list
+    std::size_t recycled; // objects returned back to free list
+    std::size_t dropped;  // objects deleted because pool was full
+    std::size_t idle;     // objects inside free list right now
+  };
+
+  /*capacity: the max amount of idle objects this pool keeps*/
+  RecyclePool(std::size_t capacity)
+      : m_capacity(capacity), m_created(0), m_reused(0), m_recycled(0),
+        m_dropped(0) {
+    m_objects.reserve(m_capacity);
+    m_blocks.reserve(m_capacity);
+  }
+
+  ~RecyclePool() {
+    /*
+     * an object derived from enable_shared_from_this still holds a weak
+     * reference, deleting it returns that control block through
+     * deallocateBlock(), so m_mtx must not be held and blocks go last
+     */
+    std::vector<_Ty *> objects;
+    {
+      std::lock_guard<std::mutex> _lckg(m_mtx);
+      objects.swap(m_objects);
+    }
+    for (auto *obj : objects) {
+      delete obj;
+    }
+
+    std::lock_guard<std::mutex> _lckg(m_mtx);
+    for (auto *block : m_blocks) {
+      ::operator delete(block, std::align_val_t(block_align));
+    }
+  }
+
+  RecyclePool(const RecyclePool &) = delete;
+  RecyclePool &operator=(const RecyclePool &) = delete;
+
+  /*args are only used when a brand new object has to be created*/
+  template <typename... Args> std::shared_ptr<_Ty> acquire(Args &&...args) {
+    _Ty *obj = nullptr;
+    {
+      std::lock_guard<std::mutex> _lckg(m_mtx);
+      if (!m_objects.empty()) {
+        obj = m_objects.back();
+        m_objects.pop_back();
+      }
+    }
+
+    if (obj != nullptr) {
+      m_reused.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      obj = new _Ty(std::forward<Args>(args)...);
+      m_created.fetch_add(1, std::memory_order_relaxed);
+    }
+    return std::shared_ptr<_Ty>(obj, Deleter{this},
+                                BlockAllocator<char>(this));
+  }
+
+  Statistic statistic() {
+    std::lock_guard<std::mutex> _lckg(m_mtx);
+    return Statistic{m_created.load(std::memory_order_relaxed),
+                     m_reused.load(std::memory_order_relaxed),
+                     m_recycled.load(std::memory_order_relaxed),
+                     m_dropped.load(std::memory_order_relaxed),
+                     m_objects.size()};
+  }
+
+  std::size_t capacity() const { return m_capacity; }
+
+private:
+  void recycle(_Ty *obj) {
+    /*reset object state, but keep its buffers*/
+    obj->recycle();
+
+    {
+      std::lock_guard<std::mutex> _lckg(m_mtx);
+      if (m_objects.size() < m_capacity) {
+        m_objects.push_back(obj);
+        m_recycled.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+    }
+
+    /*pool is full*/
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+    delete obj;
+  }
+
+  void *allocateBlock(std::size_t size) {
+    if (size <= block_size) {
+      std::lock_guard<std::mutex> _lckg(m_mtx);
+      if (!m_blocks.empty()) {
+        void *block = m_blocks.back();
+        m_blocks.pop_back();
+        return block;
+      }
+    }
+    return ::operator new(size < block_size ? block_size : size,
+                          std::align_val_t(block_align));
+  }
+
+  void deallocateBlock(void *block, std::size_t size) noexcept {
+    if (size <= block_size) {
+      std::lock_guard<std::mutex> _lckg(m_mtx);
+      if (m_blocks.size() < m_capacity) {
+        m_blocks.push_back(block);
+        return;
+      }
+    }
+    ::operator delete(block, std::align_val_t(block_align));
+  }
+
+private:
+  /*max idle objects*/
+  std::size_t m_capacity;
+
+  std::atomic<std::size_t> m_created;
+  std::atomic<std::size_t> m_reused;
+  std::atomic<std::size_t> m_recycled;
+  std::atomic<std::size_t> m_dropped;
+
+  std::mutex m_mtx;
+
+  /*idle objects and shared_ptr control blocks*/
+  std::vector<_Ty *> m_objects;
+  std::vector<void *> m_blocks;
+};
+} // namespace connection
+
+#endif // !_RECYCLEPOOL_HPP_
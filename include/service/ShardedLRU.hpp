@@ -0,0 +1,135 @@
+#pragma once
+#ifndef _SHARDEDLRU_HPP_
+#define _SHARDEDLRU_HPP_
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <list>
+#include <metrics/MetricsRegistry.hpp>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace connection {
+/*
+ * bounded least recently used cache split into shards, each shard has its own
+ * mutex so io threads rarely wait for each other.
+ *
+ * entries are indexed by the hash of _View, so looking up a std::string key by
+ * std::string_view never copies it. stored key is compared before a hit is
+ * returned, colliding keys simply replace each other.
+ */
+template <typename _Key, typename _Value, typename _View = _Key>
+class ShardedLRU {
+  struct Entry {
+    std::size_t hash;
+    _Key key;
+    _Value value;
+  };
+
+  struct alignas(64) Shard {
+    std::mutex mtx;
+
+    /*front is the most recently used*/
+    std::list<Entry> order;
+    std::unordered_map<std::size_t, typename std::list<Entry>::iterator> index;
+  };
+
+  static constexpr std::size_t shard_count = 16;
+
+public:
+  /*capacity 0 disables this cache*/
+  ShardedLRU(const std::string &name, std::size_t capacity)
+      : m_shard_capacity(capacity == 0 ? 0
+                                       : std::max<std::size_t>(
+                                             1, capacity / shard_count)) {
+    auto registry = metrics::MetricsRegistry::get_instance();
+    const std::string cache = "cache=\"" + name + "\"";
+    m_hits = &registry->counter("gateway_cache_requests_total",
+                                "Lookups of in-memory caches",
+                                cache + ",result=\"hit\"");
+    m_misses = &registry->counter("gateway_cache_requests_total",
+                                  "Lookups of in-memory caches",
+                                  cache + ",result=\"miss\"");
+    registry->gauge("gateway_cache_entries", "Entries of in-memory caches",
+                    cache, [this]() { return static_cast<double>(size()); });
+  }
+
+  ShardedLRU(const ShardedLRU &) = delete;
+  ShardedLRU &operator=(const ShardedLRU &) = delete;
+
+  std::optional<_Value> get(const _View &key) {
+    if (m_shard_capacity == 0) {
+      return std::nullopt;
+    }
+
+    const std::size_t hash = std::hash<_View>{}(key);
+    Shard &shard = m_shards[hash % shard_count];
+    {
+      std::lock_guard<std::mutex> _lckg(shard.mtx);
+      auto it = shard.index.find(hash);
+      if (it != shard.index.end() && it->second->key == key) {
+        shard.order.splice(shard.order.begin(), shard.order, it->second);
+        m_hits->inc();
+        return it->second->value;
+      }
+    }
+    m_misses->inc();
+    return std::nullopt;
+  }
+
+  void put(const _View &key, _Value value) {
+    if (m_shard_capacity == 0) {
+      return;
+    }
+
+    const std::size_t hash = std::hash<_View>{}(key);
+    Shard &shard = m_shards[hash % shard_count];
+    std::lock_guard<std::mutex> _lckg(shard.mtx);
+    auto it = shard.index.find(hash);
+    if (it != shard.index.end()) {
+      it->second->key = _Key(key);
+      it->second->value = std::move(value);
+      shard.order.splice(shard.order.begin(), shard.order, it->second);
+      return;
+    }
+
+    if (shard.order.size() >= m_shard_capacity) {
+      shard.index.erase(shard.order.back().hash);
+      shard.order.pop_back();
+    }
+    shard.order.push_front(Entry{hash, _Key(key), std::move(value)});
+    shard.index.emplace(hash, shard.order.begin());
+  }
+
+  void erase(const _View &key) {
+    const std::size_t hash = std::hash<_View>{}(key);
+    Shard &shard = m_shards[hash % shard_count];
+    std::lock_guard<std::mutex> _lckg(shard.mtx);
+    auto it = shard.index.find(hash);
+    if (it != shard.index.end() && it->second->key == key) {
+      shard.order.erase(it->second);
+      shard.index.erase(it);
+    }
+  }
+
+  std::size_t size() {
+    std::size_t total = 0;
+    for (auto &shard : m_shards) {
+      std::lock_guard<std::mutex> _lckg(shard.mtx);
+      total += shard.order.size();
+    }
+    return total;
+  }
+
+private:
+  std::size_t m_shard_capacity;
+  std::array<Shard, shard_count> m_shards;
+
+  metrics::Counter *m_hits;
+  metrics::Counter *m_misses;
+};
+} // namespace connection
+
+#endif // !_SHARDEDLRU_HPP_
@@ -0,0 +1,157 @@
+#pragma once
+#ifndef _SINGLEFLIGHT_HPP_
+#define _SINGLEFLIGHT_HPP_
+#include <array>
+#include <boost/asio/post.hpp>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <metrics/MetricsRegistry.hpp>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace connection {
+/*
+ * coalesce concurrent calls of the same key into one backend call.
+ * callers arriving while that call is running leave a handler which is posted
+ * to their executor once it finishes, no io thread waits for another one.
+ * callers arriving within window after it finished take the result directly.
+ *
+ * _Result is copied to every caller, so it should be small and must not refer
+ * to anything thread local(eg: protobuf messages on ThreadArena)
+ */
+template <typename _Result> class SingleFlight {
+  using clock = std::chrono::steady_clock;
+
+  /*protected by shard mutex*/
+  struct Call {
+    /*set once the call is finished*/
+    std::optional<_Result> result;
+    std::vector<std::function<void(const _Result &)>> waiters;
+
+    /*max until the call is finished*/
+    clock::time_point expire = clock::time_point::max();
+  };
+
+  struct alignas(64) Shard {
+    std::mutex mtx;
+    std::map<std::string, std::shared_ptr<Call>, std::less<>> calls;
+  };
+
+  static constexpr std::size_t shard_count = 16;
+
+  /*finished calls are swept once a shard holds this many keys*/
+  static constexpr std::size_t sweep_threshold = 256;
+
+public:
+  SingleFlight(const std::string &route, std::chrono::milliseconds window)
+      : m_window(window) {
+    auto registry = metrics::MetricsRegistry::get_instance();
+    const std::string labels = "route=\"" + route + "\"";
+    m_leaders = &registry->counter(
+        "gateway_singleflight_leaders_total",
+        "Backend calls made on behalf of coalesced requests", labels);
+    m_followers = &registry->counter(
+        "gateway_singleflight_followers_total",
+        "Requests which reused another request's backend call", labels);
+  }
+
+  SingleFlight(const SingleFlight &) = delete;
+  SingleFlight &operator=(const SingleFlight &) = delete;
+
+  /*
+   * handler(const _Result &) runs on this thread when the result is known
+   * already or this caller makes the backend call, otherwise it is posted to
+   * executor when the leader finishes. fn must not throw, followers would
+   * never be answered
+   */
+  template <typename _Executor, typename _Fn, typename _Handler>
+  void run(std::string_view key, const _Executor &executor, _Fn &&fn,
+           _Handler &&handler) {
+    Shard &shard = m_shards[std::hash<std::string_view>{}(key) % shard_count];
+
+    std::unique_lock<std::mutex> _lckg(shard.mtx);
+    const auto now = clock::now();
+    auto it = shard.calls.find(key);
+    if (it != shard.calls.end() && it->second->expire > now) {
+      m_followers->inc();
+      if (it->second->result.has_value()) {
+        _Result result = *it->second->result;
+        _lckg.unlock();
+        handler(result);
+        return;
+      }
+      it->second->waiters.emplace_back(
+          [executor, handler = std::forward<_Handler>(handler)](
+              const _Result &result) {
+            boost::asio::post(executor,
+                              [handler, result]() mutable { handler(result); });
+          });
+      return;
+    }
+
+    if (shard.calls.size() >= sweep_threshold) {
+      sweep(shard, now);
+      it = shard.calls.find(key);
+    }
+
+    auto call = std::make_shared<Call>();
+    if (it != shard.calls.end()) {
+      it->second = call;
+    } else {
+      shard.calls.emplace(std::string(key), call);
+    }
+    _lckg.unlock();
+    m_leaders->inc();
+
+    _Result result = std::forward<_Fn>(fn)();
+    for (const auto &waiter : finish(shard, key, call, result)) {
+      waiter(result);
+    }
+    handler(result);
+  }
+
+private:
+  /*publish result, returns callers which waited for it*/
+  std::vector<std::function<void(const _Result &)>>
+  finish(Shard &shard, std::string_view key, const std::shared_ptr<Call> &call,
+         const _Result &result) {
+    std::lock_guard<std::mutex> _lckg(shard.mtx);
+    call->result = result;
+
+    auto it = shard.calls.find(key);
+    if (it != shard.calls.end() && it->second == call) {
+      if (m_window.count() > 0) {
+        call->expire = clock::now() + m_window;
+      } else {
+        shard.calls.erase(it);
+      }
+    }
+    return std::move(call->waiters);
+  }
+
+  /*called under shard mutex*/
+  void sweep(Shard &shard, clock::time_point now) {
+    for (auto it = shard.calls.begin(); it != shard.calls.end();) {
+      if (it->second->expire <= now) {
+        it = shard.calls.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+private:
+  std::chrono::milliseconds m_window;
+  std::array<Shard, shard_count> m_shards;
+
+  metrics::Counter *m_leaders;
+  metrics::Counter *m_followers;
+};
+} // namespace connection
+
+#endif // !_SINGLEFLIGHT_HPP_
@@ -0,0 +1,87 @@
+#pragma once
+#ifndef _TIMINGWHEEL_HPP_
+#define _TIMINGWHEEL_HPP_
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+
+namespace connection {
+class TimingWheel;
+
+/*
+ * intrusive timer node, embedded into its owner
+ * arm and cancel never allocate memory
+ */
+struct TimerNode {
+  using callback_type = void (*)(void *owner);
+
+  TimerNode(void *_owner = nullptr, callback_type _callback = nullptr)
+      : owner(_owner), callback(_callback) {}
+
+  TimerNode(const TimerNode &) = delete;
+  TimerNode &operator=(const TimerNode &) = delete;
+
+  bool armed() const { return prev != nullptr; }
+
+  void *owner;
+  callback_type callback;
+
+private:
+  friend class TimingWheel;
+  TimerNode *prev = nullptr;
+  TimerNode *next = nullptr;
+
+  /*how many full rotations still have to pass*/
+  std::size_t rounds = 0;
+};
+
+/*
+ * hashed timing wheel, one instance for each io_context
+ * all methods have to be called on the io_context's thread
+ */
+class TimingWheel {
+public:
+  TimingWheel(boost::asio::io_context &ioc, std::chrono::milliseconds tick,
+              std::size_t slots);
+  ~TimingWheel();
+
+  TimingWheel(const TimingWheel &) = delete;
+  TimingWheel &operator=(const TimingWheel &) = delete;
+
+  void start();
+  void stop();
+
+  /*O(1), rearm node if it's already armed*/
+  void arm(TimerNode &node, std::chrono::milliseconds timeout);
+
+  /*O(1)*/
+  void cancel(TimerNode &node);
+
+  std::size_t size() const;
+
+private:
+  void schedule();
+  void onTick();
+
+  static void link(TimerNode &head, TimerNode &node);
+  static void splice(TimerNode &from, TimerNode &to);
+  static void unlink(TimerNode &node);
+
+private:
+  boost::asio::steady_timer m_timer;
+  std::chrono::milliseconds m_tick;
+  std::chrono::steady_clock::time_point m_next_tick;
+
+  /*every slot is a circular list, slot itself is the sentinel*/
+  std::unique_ptr<TimerNode[]> m_slots;
+  std::size_t m_slot_count;
+  std::size_t m_cursor;
+
+  /*armed nodes*/
+  std::size_t m_size;
+  bool m_stop;
+};
+} // namespace connection
+
+#endif // !_TIMINGWHEEL_HPP_
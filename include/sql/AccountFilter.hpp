@@ -0,0 +1,76 @@
+#pragma once
+#ifndef _ACCOUNTFILTER_HPP_
+#define _ACCOUNTFILTER_HPP_
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <singleton/singleton.hpp>
+#include <string_view>
+
+namespace metrics {
+class Counter;
+}
+
+namespace mysql {
+/*
+ * split block bloom filter of every username and email in Authentication
+ *
+ * a key is hashed into one 64-byte block and sets one bit in each of the
+ * block's eight words, so a lookup touches a single cache line. keys are
+ * never removed, accounts are never deleted either.
+ *
+ * mayContain() returning false means no such account exists and MySQL does
+ * not have to be asked. until load() succeeds every lookup returns true.
+ */
+class AccountFilter : public Singleton<AccountFilter> {
+  friend class Singleton<AccountFilter>;
+  AccountFilter();
+
+public:
+  ~AccountFilter();
+
+  /*stream the Authentication table through a pooled connection*/
+  bool load();
+
+  /*called after an account is created*/
+  void insert(std::string_view username, std::string_view email);
+
+  /*false if no account has both this username and this email*/
+  bool mayContain(std::string_view username, std::string_view email);
+
+  /*mayContain() returned true but MySQL found nothing*/
+  void falsePositive();
+
+  std::size_t bytes() const;
+
+  /*probability of a single unknown key passing the filter*/
+  double estimatedFalsePositiveRate() const;
+
+private:
+  struct alignas(64) Block {
+    std::atomic<uint64_t> words[8];
+  };
+
+  enum class KeyType : uint8_t { USERNAME, EMAIL };
+
+  static uint64_t hashKey(KeyType type, std::string_view key);
+  void insertHash(uint64_t hash);
+  bool containsHash(uint64_t hash) const;
+
+private:
+  bool m_enabled;
+  std::atomic<bool> m_ready;
+
+  std::size_t m_block_count;
+  std::unique_ptr<Block[]> m_blocks;
+
+  /*bits set so far, false positive rate is estimated from it*/
+  std::atomic<std::size_t> m_set_bits;
+
+  metrics::Counter *m_negatives;
+  metrics::Counter *m_positives;
+  metrics::Counter *m_false_positives;
+};
+} // namespace mysql
+
+#endif // !_ACCOUNTFILTER_HPP_
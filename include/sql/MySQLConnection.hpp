@@ -1,13 +1,18 @@
 #pragma once
 #ifndef _MYSQLCONNECTION_HPP_
 #define _MYSQLCONNECTION_HPP_
+#include <atomic>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/ssl/context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/mysql/error_with_diagnostics.hpp>
 #include <boost/mysql/tcp_ssl.hpp>
 #include <chrono>
+#include <functional>
 #include <map>
 #include <optional>
 #include <string_view>
+#include <vector>
 
 struct MySQLRequestStruct {
   std::string_view m_username;
@@ -25,13 +30,20 @@ enum class MySQLSelection : uint8_t {
   ACQUIRE_NEW_UID,    // get uid for user
   UPDATE_UID_COUNTER, // add up to uid accounter
   UPDATE_USER_PASSWD, // update user password
-  USER_LOGIN_CHECK,   // check login username & password
+  USER_LOGIN_CHECK,   // stored password hash of username
   USER_UUID_CHECK,    // check account uuid in DB
   USER_PROFILE,       // check account user profile
-  GET_USER_UUID,      // get uuid by username
-  USER_FRIEND_REQUEST // User A send friend request to B
+  GET_USER_UUID,      // get uuid and stored username by username
+  USER_FRIEND_REQUEST, // User A send friend request to B
+  LOAD_ACCOUNTS        // stream every username & email
 };
 
+/*statement name used by metrics and tracing*/
+const char *selectionName(MySQLSelection select);
+
+/*statements which MySQLConnectionPool may route to a read replica*/
+bool isReadOnly(MySQLSelection select);
+
 class MySQLConnection {
   friend class MySQLConnectionPool;
   MySQLConnection(const MySQLConnection &) = delete;
@@ -46,35 +58,76 @@ public:
   ~MySQLConnection();
 
 public:
-  /*insert new user, call MySQLSelection::CREATE_NEW_USER*/
+  /*
+   * false when connecting failed or a query lost the connection,
+   * MySQLConnectionPool drops it on release and dials a new one
+   */
+  bool isValid() const;
+
+  /*
+   * insert new user, call MySQLSelection::CREATE_NEW_USER
+   * m_password has to be hashed by tools::hashPassword already
+   */
   bool registerNewUser(MySQLRequestStruct &&request);
+
+  /*
+   * one SELECT finds taken username and email pairs, the same rule as
+   * checkAccountAvailability, the others are inserted by one multi-row
+   * CREATE_NEW_USER. username and email need UNIQUE indexes, a batch the
+   * server rejects is retried row by row. uuid of each row in request order,
+   * nullopt when it is taken or failed
+   */
+  std::vector<std::optional<std::size_t>>
+  registerNewUsers(const std::vector<MySQLRequestStruct> &requests);
   bool alterUserPassword(MySQLRequestStruct &&request);
 
-  /*login username & password check*/
-  std::optional<std::size_t> checkAccountLogin(std::string_view username,
-                                               std::string_view password);
+  /*stored password of username, compare it with tools::verifyPassword*/
+  std::optional<std::string> getPasswordHash(std::string_view username);
 
   /*is username and email were occupied!*/
   bool checkAccountAvailability(std::string_view username,
                                 std::string_view email);
 
-  bool checkTimeout(const std::chrono::steady_clock::time_point &curr,
-                    std::size_t timeout);
-
   bool checkUUID(std::size_t uuid);
 
   std::optional<std::size_t> getUUIDByUsername(std::string_view username);
   std::optional<std::string> getUsernameByUUID(std::size_t uuid);
 
+  /*
+   * call MySQLSelection::LOAD_ACCOUNTS, rows are passed to callback batch by
+   * batch instead of buffering the whole table
+   */
+  bool streamAccounts(
+      const std::function<void(std::string_view username,
+                               std::string_view email)> &callback);
+
 private:
+  /*nullopt only when the query failed, an empty result is returned as is*/
+  template <typename... Args>
+  std::optional<boost::mysql::results> queryCommand(MySQLSelection select,
+                                                    Args &&...args);
+
+  /*nullopt when the query failed or found no rows*/
   template <typename... Args>
   std::optional<boost::mysql::results> executeCommand(MySQLSelection select,
                                                       Args &&...args);
 
+  /*called after every successful query, arms idle ping if it is not*/
   void updateTimer();
 
-  /*send heart packet to mysql to prevent from disconnecting*/
-  bool sendHeartBeat();
+  /*server side errors(syntax, duplicate key...) keep connection usable*/
+  void checkBroken(const boost::mysql::error_with_diagnostics &err);
+
+  std::chrono::steady_clock::duration idleTimeout() const;
+
+  /*
+   * wake up on this connection's io_context after delay, the connection is
+   * only pinged when it is still idle inside MySQLConnectionPool
+   */
+  void scheduleIdlePing(std::chrono::steady_clock::duration delay);
+
+  /*connection is claimed from the pool, it is released after ping*/
+  static void pingIfIdle(std::unique_ptr<MySQLConnection> self);
 
 private:
   std::shared_ptr<MySQLConnectionPool> m_delegator;
@@ -91,6 +144,15 @@ private:
 
   /*last operation time*/
   std::chrono::steady_clock::time_point last_operation_time;
+
+  bool m_valid = false;
+
+  /*
+   * shared with pending ping handler, which must not touch a connection
+   * that has been destroyed or is being used by another thread
+   */
+  std::shared_ptr<std::atomic<bool>> m_ping_armed;
+  boost::asio::steady_timer m_ping_timer;
 };
 } // namespace mysql
 
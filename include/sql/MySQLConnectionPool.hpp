@@ -1,7 +1,10 @@
 #pragma once
 #ifndef _MYSQLMANAGEMENT_HPP_
 #define _MYSQLMANAGEMENT_HPP_
+#include <atomic>
+#include <metrics/MetricsRegistry.hpp>
 #include <service/ConnectionPool.hpp>
+#include <service/ShardedLRU.hpp>
 #include <sql/MySQLConnection.hpp>
 
 namespace mysql {
@@ -16,6 +19,20 @@ class MySQLConnectionPool
 public:
   virtual ~MySQLConnectionPool();
 
+  /*has to be called once an account is deleted*/
+  void invalidateAccount(std::string_view username, std::size_t uuid);
+
+  /*
+   * pool which should serve select. writes and reads of a username written
+   * within sticky window go to primary, other reads go to a replica
+   */
+  MySQLConnectionPool *route(MySQLSelection select,
+                             std::string_view username = {});
+
+  /*dial primary and every replica in parallel*/
+  void warmup();
+  void shutdown();
+
 private:
   MySQLConnectionPool() noexcept;
   MySQLConnectionPool(
@@ -24,8 +41,25 @@ private:
       const std::string &host = "localhost",
       const std::string &port = boost::mysql::default_port_string) noexcept;
 
+  /*replica shares credentials, caches and statements with primary*/
+  MySQLConnectionPool(MySQLConnectionPool *primary, std::size_t index,
+                      const std::string &host,
+                      const std::string &port) noexcept;
+
+  void setupConnections();
+  void createReplicas(const std::string &hosts);
+
+  /*called on primary after username is inserted or updated*/
+  void markWritten(std::string_view username);
+
+  /*smoothed latency of this pool, replicas are compared by it*/
+  void observeLatency(std::chrono::steady_clock::duration elapsed);
+  MySQLConnectionPool *pickReplica();
+
   void registerSQLStatement();
-  void roundRobinChecking();
+
+  /*latency histogram of every registered sql statement*/
+  void registerStatementMetrics();
 
 private:
   std::string m_username;
@@ -34,15 +68,40 @@ private:
   std::string m_host;
   std::string m_port;
 
-  /*round-robin timeout check(second)*/
-  std::mutex m_RRMutex;
+  /*idle time(second) before a connection is pinged*/
   std::size_t m_timeout;
 
-  /*round robin thread*/
-  std::thread m_RRThread;
-
   /*sql operation command*/
   std::map<MySQLSelection, std::string> m_sql;
+
+  /*filled once in constructor, read only afterwards*/
+  std::map<MySQLSelection, metrics::Histogram *> m_latency;
+
+  struct AccountCache {
+    AccountCache(std::size_t capacity, std::size_t sticky_capacity);
+
+    /*username <-> uuid never changes while the account exists*/
+    connection::ShardedLRU<std::string, std::size_t, std::string_view> uuid;
+    connection::ShardedLRU<std::size_t, std::string> username;
+
+    /*last write of username, replicas may not have seen it yet*/
+    connection::ShardedLRU<std::string, std::chrono::steady_clock::time_point,
+                           std::string_view>
+        written;
+  };
+
+  /*shared by primary and its replicas*/
+  std::shared_ptr<AccountCache> m_cache;
+
+  /*empty on replicas*/
+  std::vector<std::unique_ptr<MySQLConnectionPool>> m_replicas;
+  std::chrono::milliseconds m_sticky_window{0};
+
+  /*query latency(ns), exponentially weighted*/
+  std::atomic<std::int64_t> m_latency_ewma{0};
+
+  metrics::Counter *m_primary_reads = nullptr;
+  metrics::Counter *m_replica_reads = nullptr;
 };
 } // namespace mysql
 
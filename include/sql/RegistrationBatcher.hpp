@@ -0,0 +1,86 @@
+#pragma once
+#ifndef _REGISTRATIONBATCHER_HPP_
+#define _REGISTRATIONBATCHER_HPP_
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <singleton/singleton.hpp>
+#include <string>
+#include <thread>
+
+namespace metrics {
+class Counter;
+class Histogram;
+} // namespace metrics
+
+namespace mysql {
+/*
+ * group commit of CREATE_NEW_USER. registrations which arrive within one
+ * window(or until max rows are queued) are inserted by a single multi-row
+ * INSERT on one pooled connection, so a sign-up burst pays one round trip and
+ * one commit per batch instead of per user. rows queue behind the batch
+ * which is being written, one batch is in flight at a time.
+ */
+class RegistrationBatcher : public Singleton<RegistrationBatcher> {
+  friend class Singleton<RegistrationBatcher>;
+
+public:
+  /*uuid of the new account, nullopt when it is taken or MySQL failed*/
+  using callback = std::function<void(std::optional<std::size_t> uuid)>;
+
+  ~RegistrationBatcher();
+
+  /*insert the rows which are still queued, then stop*/
+  void shutdown();
+
+  /*false unless [RegistrationBatch] is enabled*/
+  bool enabled() const;
+
+  /*
+   * password has to be hashed already. done is called on the batching
+   * thread, post to the caller's io_context from it.
+   * false when batching is disabled or stopped, done is not called then
+   */
+  bool submit(std::string username, std::string password, std::string email,
+              callback done);
+
+  std::size_t pending();
+
+private:
+  RegistrationBatcher();
+
+  void run();
+
+private:
+  struct Pending {
+    std::string username;
+    std::string password;
+    std::string email;
+    callback done;
+    std::chrono::steady_clock::time_point queued;
+  };
+
+  void insert(std::deque<Pending> &batch);
+
+private:
+  bool m_enabled;
+  std::size_t m_max_rows;
+  std::chrono::milliseconds m_window;
+
+  bool m_stop = false;
+  std::mutex m_mtx;
+  std::condition_variable m_cv;
+  std::deque<Pending> m_queue;
+  std::thread m_thread;
+
+  metrics::Counter *m_batches;
+  metrics::Counter *m_rows;
+  metrics::Histogram *m_queue_wait;
+  metrics::Histogram *m_insert_latency;
+};
+} // namespace mysql
+
+#endif // !_REGISTRATIONBATCHER_HPP_
@@ -0,0 +1,32 @@
+#pragma once
+#ifndef _PASSWORDHASH_HPP_
+#define _PASSWORDHASH_HPP_
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace tools {
+struct ScryptParams {
+  /*N = 2^cost*/
+  uint8_t cost;
+  uint32_t block_size;
+  uint32_t parallelism;
+};
+
+/*
+ * salted scrypt of password, "$scrypt$ln=15,r=8,p=1$<salt>$<hash>" in hex.
+ * both functions take tens of milliseconds on purpose, call them from
+ * CPUWorkerPool instead of io threads
+ */
+std::optional<std::string> hashPassword(std::string_view password,
+                                        const ScryptParams &params);
+
+/*
+ * constant time comparison with a stored hash, passwords which were stored
+ * before hashing was introduced are compared as plain text
+ */
+bool verifyPassword(std::string_view password, std::string_view stored);
+} // namespace tools
+
+#endif // !_PASSWORDHASH_HPP_
@@ -0,0 +1,157 @@
+#pragma once
+#ifndef _TRACER_HPP_
+#define _TRACER_HPP_
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <singleton/singleton.hpp>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace metrics {
+class Counter;
+}
+
+namespace trace {
+/*W3C trace context*/
+struct SpanContext {
+  std::array<uint64_t, 2> trace_id{};
+  uint64_t span_id = 0;
+  bool sampled = false;
+
+  bool valid() const {
+    return (trace_id[0] | trace_id[1]) != 0 && span_id != 0;
+  }
+
+  /*00-<trace_id>-<span_id>-<flags>*/
+  std::string traceparent() const;
+  static std::optional<SpanContext> parse(std::string_view traceparent);
+};
+
+enum class SpanKind : uint8_t { INTERNAL = 1, SERVER = 2, CLIENT = 3 };
+
+/*fixed size record, copied into the ring buffer when a span ends*/
+struct SpanRecord {
+  SpanContext context;
+  uint64_t parent_id;
+  uint64_t start_ns; // unix time
+  uint64_t end_ns;
+  SpanKind kind;
+  bool error;
+  char name[32];
+  char detail[64];
+};
+
+struct root_t {};
+inline constexpr root_t root{};
+
+/*
+ * spans are bound to the current thread, handlers run synchronously on io
+ * threads, so the innermost living Span is always the parent of a new one.
+ * A Span created without a sampled parent does nothing.
+ */
+class Span {
+public:
+  /*child of current span on this thread*/
+  explicit Span(const char *name, std::string_view detail = {},
+                SpanKind kind = SpanKind::INTERNAL);
+
+  /*
+   * start a new trace or continue client's traceparent header
+   * start is used when the request began before this span is created
+   */
+  Span(root_t, const char *name, std::string_view detail,
+       std::string_view traceparent,
+       std::chrono::steady_clock::time_point start);
+
+  ~Span();
+
+  Span(const Span &) = delete;
+  Span &operator=(const Span &) = delete;
+
+  bool active() const { return m_active; }
+  const SpanContext &context() const { return m_record.context; }
+  void setError() { m_record.error = true; }
+
+  /*
+   * request continues on another stage, detach this innermost span from
+   * the thread without ending it. resume() makes it the parent of new spans
+   * on the thread which picks the request up, it may be destroyed detached
+   */
+  void suspend();
+  void resume();
+
+private:
+  void begin(const char *name, std::string_view detail, SpanKind kind);
+
+private:
+  bool m_active = false;
+  bool m_attached = false;
+  Span *m_parent = nullptr;
+  SpanRecord m_record;
+};
+
+/*
+ * finished spans are pushed into a bounded lock-free ring, a background
+ * thread drains it and appends OTLP/JSON lines to the trace file
+ */
+class Tracer : public Singleton<Tracer> {
+  friend class Singleton<Tracer>;
+  friend class Span;
+  Tracer();
+
+public:
+  ~Tracer();
+
+  bool enabled() const { return m_enabled; }
+
+  /*stop exporter thread and write remaining spans*/
+  void shutdown();
+
+private:
+  /*sampling decision of a new trace*/
+  bool sample();
+
+  /*drop the span when the ring is full*/
+  void submit(const SpanRecord &record);
+
+  void exportLoop();
+  void drain();
+
+private:
+  struct Cell {
+    std::atomic<std::size_t> sequence;
+    SpanRecord record;
+  };
+
+  bool m_enabled;
+  double m_sample_rate;
+  std::chrono::milliseconds m_flush_interval;
+
+  /*bounded MPSC ring, capacity is a power of two*/
+  std::size_t m_mask;
+  std::unique_ptr<Cell[]> m_cells;
+  alignas(64) std::atomic<std::size_t> m_enqueue;
+  alignas(64) std::size_t m_dequeue;
+
+  std::ofstream m_file;
+  std::string m_batch;
+
+  std::atomic<bool> m_stop;
+  std::mutex m_mtx;
+  std::condition_variable m_cv;
+  std::thread m_exporter;
+
+  metrics::Counter *m_exported;
+  metrics::Counter *m_dropped;
+};
+} // namespace trace
+
+#endif // !_TRACER_HPP_
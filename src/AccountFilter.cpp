@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <cmath>
+#include <config/ServerConfig.hpp>
+#include <functional>
+#include <log/LogManager.hpp>
+#include <metrics/MetricsRegistry.hpp>
+#include <sql/AccountFilter.hpp>
+#include <sql/MySQLConnectionPool.hpp>
+
+namespace {
+/*odd multipliers picking one bit of every word, taken from parquet's SBBF*/
+constexpr uint32_t salts[8] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU,
+                               0xa2b7289dU, 0x705495c7U, 0x2df1424bU,
+                               0x9efc4947U, 0x5c6bfb31U};
+
+/*splitmix64 finalizer*/
+uint64_t mix(uint64_t value) {
+  value ^= value >> 30;
+  value *= 0xbf58476d1ce4e5b9ULL;
+  value ^= value >> 27;
+  value *= 0x94d049bb133111ebULL;
+  value ^= value >> 31;
+  return value;
+}
+} // namespace
+
+mysql::AccountFilter::AccountFilter() : m_ready(false), m_set_bits(0) {
+  auto config = ServerConfig::get_instance();
+  m_enabled = config->AccountFilter_enabled;
+
+  /*one username and one email per account, 512 bits per block*/
+  const double bits = static_cast<double>(config->AccountFilter_capacity) * 2 *
+                      static_cast<double>(config->AccountFilter_bits_per_key);
+  m_block_count =
+      std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(bits / 512)));
+  if (m_enabled) {
+    m_blocks = std::make_unique<Block[]>(m_block_count);
+  }
+
+  auto registry = metrics::MetricsRegistry::get_instance();
+  m_negatives = &registry->counter(
+      "gateway_account_filter_checks_total",
+      "Account lookups answered by the bloom filter", "result=\"negative\"");
+  m_positives = &registry->counter(
+      "gateway_account_filter_checks_total",
+      "Account lookups answered by the bloom filter", "result=\"positive\"");
+  m_false_positives = &registry->counter(
+      "gateway_account_filter_false_positives_total",
+      "Account lookups passing the bloom filter but missing in MySQL", "");
+  registry->gauge("gateway_account_filter_bytes",
+                  "Memory used by the account bloom filter", "",
+                  [this]() { return static_cast<double>(bytes()); });
+  registry->gauge("gateway_account_filter_false_positive_rate",
+                  "Estimated false positive rate of one unknown key", "",
+                  [this]() { return estimatedFalsePositiveRate(); });
+}
+
+mysql::AccountFilter::~AccountFilter() {}
+
+bool mysql::AccountFilter::load() {
+  if (!m_enabled) {
+    return false;
+  }
+
+  connection::ConnectionRAII<mysql::MySQLConnectionPool,
+                             mysql::MySQLConnection>
+      mysql;
+  if (!mysql) {
+    logger::mysql()->error("Account filter is not loaded, no MySQL "
+                           "connection is available");
+    return false;
+  }
+
+  std::size_t accounts = 0;
+  const bool status = mysql->get()->streamAccounts(
+      [this, &accounts](std::string_view username, std::string_view email) {
+        insert(username, email);
+        ++accounts;
+      });
+
+  if (!status) {
+    logger::mysql()->error("Account filter is not loaded, every account "
+                           "lookup goes to MySQL");
+    return false;
+  }
+
+  logger::mysql()->info("Account filter loaded {} accounts into {} bytes",
+                        accounts, bytes());
+  m_ready.store(true, std::memory_order_release);
+  return true;
+}
+
+void mysql::AccountFilter::insert(std::string_view username,
+                                  std::string_view email) {
+  if (!m_enabled) {
+    return;
+  }
+  insertHash(hashKey(KeyType::USERNAME, username));
+  insertHash(hashKey(KeyType::EMAIL, email));
+}
+
+bool mysql::AccountFilter::mayContain(std::string_view username,
+                                      std::string_view email) {
+  if (!m_ready.load(std::memory_order_acquire)) {
+    return true;
+  }
+  if (containsHash(hashKey(KeyType::USERNAME, username)) &&
+      containsHash(hashKey(KeyType::EMAIL, email))) {
+    m_positives->inc();
+    return true;
+  }
+  m_negatives->inc();
+  return false;
+}
+
+void mysql::AccountFilter::falsePositive() {
+  if (m_ready.load(std::memory_order_relaxed)) {
+    m_false_positives->inc();
+  }
+}
+
+std::size_t mysql::AccountFilter::bytes() const {
+  return m_blocks == nullptr ? 0 : m_block_count * sizeof(Block);
+}
+
+double mysql::AccountFilter::estimatedFalsePositiveRate() const {
+  if (m_blocks == nullptr) {
+    return 1.0;
+  }
+
+  /*an unknown key passes when all eight of its bits happen to be set*/
+  const double fill =
+      static_cast<double>(m_set_bits.load(std::memory_order_relaxed)) /
+      static_cast<double>(m_block_count * 512);
+  return std::pow(fill, 8);
+}
+
+uint64_t mysql::AccountFilter::hashKey(KeyType type, std::string_view key) {
+  /*same string as username and as email must not share bits*/
+  return mix(std::hash<std::string_view>{}(key) +
+             (type == KeyType::EMAIL ? 0x9e3779b97f4a7c15ULL : 0));
+}
+
+void mysql::AccountFilter::insertHash(uint64_t hash) {
+  Block &block = m_blocks[((hash >> 32) * m_block_count) >> 32];
+  const uint32_t low = static_cast<uint32_t>(hash);
+  std::size_t added = 0;
+  for (std::size_t i = 0; i < 8; ++i) {
+    const uint64_t mask = uint64_t{1} << ((low * salts[i]) >> 26);
+    if ((block.words[i].fetch_or(mask, std::memory_order_relaxed) & mask) ==
+        0) {
+      ++added;
+    }
+  }
+  if (added != 0) {
+    m_set_bits.fetch_add(added, std::memory_order_relaxed);
+  }
+}
+
+bool mysql::AccountFilter::containsHash(uint64_t hash) const {
+  const Block &block = m_blocks[((hash >> 32) * m_block_count) >> 32];
+  const uint32_t low = static_cast<uint32_t>(hash);
+  for (std::size_t i = 0; i < 8; ++i) {
+    const uint64_t mask = uint64_t{1} << ((low * salts[i]) >> 26);
+    if ((block.words[i].load(std::memory_order_relaxed) & mask) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,83 @@
+#include <config/ServerConfig.hpp>
+#include <metrics/MetricsRegistry.hpp>
+#include <service/CPUWorkerPool.hpp>
+
+CPUWorkerPool::CPUWorkerPool()
+    : CPUWorkerPool(ServerConfig::get_instance()->CPUWorker_threads,
+                    ServerConfig::get_instance()->CPUWorker_queue_limit) {}
+
+CPUWorkerPool::CPUWorkerPool(std::size_t threads, std::size_t queue_limit)
+    : m_queue_limit(std::max<std::size_t>(1, queue_limit)) {
+  /*0 means one thread per core*/
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  auto registry = metrics::MetricsRegistry::get_instance();
+  m_rejected = &registry->counter("gateway_cpu_pool_rejected_total",
+                                  "Tasks rejected because the queue is full");
+  m_queue_wait = &registry->histogram("gateway_cpu_pool_queue_seconds",
+                                      "Time tasks wait for a cpu worker");
+  registry->gauge("gateway_cpu_pool_pending", "Tasks waiting for a cpu worker",
+                  "", [this]() { return static_cast<double>(pending()); });
+
+  m_threads.reserve(threads);
+  for (std::size_t i = 0; i < threads; ++i) {
+    m_threads.emplace_back([this]() { run(); });
+  }
+}
+
+CPUWorkerPool::~CPUWorkerPool() { shutdown(); }
+
+void CPUWorkerPool::shutdown() {
+  {
+    std::lock_guard<std::mutex> _lckg(m_mtx);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+
+  /*queued tasks are still run, their connections are waiting for them*/
+  for (auto &thread : m_threads) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+bool CPUWorkerPool::submit(task &&fn) {
+  {
+    std::lock_guard<std::mutex> _lckg(m_mtx);
+    if (m_stop || m_queue.size() >= m_queue_limit) {
+      m_rejected->inc();
+      return false;
+    }
+    m_queue.push_back(Pending{std::move(fn), std::chrono::steady_clock::now()});
+  }
+  m_cv.notify_one();
+  return true;
+}
+
+std::size_t CPUWorkerPool::size() const { return m_threads.size(); }
+
+std::size_t CPUWorkerPool::pending() {
+  std::lock_guard<std::mutex> _lckg(m_mtx);
+  return m_queue.size();
+}
+
+void CPUWorkerPool::run() {
+  for (;;) {
+    Pending pending;
+    {
+      std::unique_lock<std::mutex> _lckg(m_mtx);
+      m_cv.wait(_lckg, [this]() { return m_stop || !m_queue.empty(); });
+      if (m_queue.empty()) {
+        return;
+      }
+      pending = std::move(m_queue.front());
+      m_queue.pop_front();
+    }
+
+    m_queue_wait->observe(std::chrono::steady_clock::now() - pending.queued);
+    pending.fn();
+  }
+}
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <cmath>
+#include <config/ServerConfig.hpp>
+#include <handler/ConcurrencyLimiter.hpp>
+#include <metrics/MetricsRegistry.hpp>
+#include <service/IOServicePool.hpp>
+
+admission::Permit::Permit(ConcurrencyLimiter *limiter)
+    : m_limiter(limiter), m_start(std::chrono::steady_clock::now()) {}
+
+admission::Permit::Permit(Permit &&other) noexcept
+    : m_limiter(other.m_limiter), m_start(other.m_start) {
+  other.m_limiter = nullptr;
+}
+
+admission::Permit::~Permit() {
+  if (m_limiter != nullptr) {
+    m_limiter->release(std::chrono::steady_clock::now() - m_start);
+  }
+}
+
+admission::ConcurrencyLimiter::ConcurrencyLimiter()
+    : m_inflight(0), m_limit(0) {
+  auto config = ServerConfig::get_instance();
+  m_enabled = config->Admission_enabled;
+  /*
+   * handlers block their io thread, so in-flight requests never exceed the
+   * amount of io threads unless handlers hand their work over to others.
+   * the default limit is twice of that, low priority routes are not rejected
+   * until the limit shrinks because of rising latency.
+   */
+  const std::size_t io_threads = IOServicePool::get_instance()->size();
+  auto or_io_threads = [io_threads](std::size_t value) {
+    return static_cast<double>(value == 0 ? io_threads * 2 : value);
+  };
+
+  m_min_limit = static_cast<double>(std::max<std::size_t>(
+      1, config->Admission_min_limit));
+  m_max_limit =
+      std::max(m_min_limit, or_io_threads(config->Admission_max_limit));
+  m_smoothing = std::clamp(config->Admission_smoothing, 0.01, 1.0);
+  m_tolerance = std::max(1.0, config->Admission_tolerance);
+  m_long_window = std::max<double>(1, config->Admission_long_window);
+  m_shares[static_cast<std::size_t>(Priority::HIGH)] = 1.0;
+  m_shares[static_cast<std::size_t>(Priority::NORMAL)] =
+      std::clamp(config->Admission_normal_share, 0.01, 1.0);
+  m_shares[static_cast<std::size_t>(Priority::LOW)] =
+      std::clamp(config->Admission_low_share, 0.01, 1.0);
+  m_window = std::chrono::milliseconds(config->Admission_window_ms);
+  m_retry_after = std::chrono::seconds(config->Admission_retry_after);
+
+  m_estimated_limit =
+      std::clamp(or_io_threads(config->Admission_initial_limit), m_min_limit,
+                 m_max_limit);
+  m_limit = static_cast<std::size_t>(m_estimated_limit);
+  m_window_end = std::chrono::steady_clock::now() + m_window;
+
+  auto registry = metrics::MetricsRegistry::get_instance();
+  registry->gauge("gateway_admission_limit",
+                  "Adaptive concurrency limit of route handlers", "",
+                  [this]() { return static_cast<double>(limit()); });
+  registry->gauge("gateway_admission_inflight",
+                  "Requests admitted and not finished yet", "",
+                  [this]() { return static_cast<double>(inflight()); });
+}
+
+admission::ConcurrencyLimiter::~ConcurrencyLimiter() {}
+
+const admission::Route &
+admission::ConcurrencyLimiter::route(const std::string &name,
+                                     Priority priority) {
+  auto it = m_routes.find(name);
+  if (it != m_routes.end()) {
+    return it->second;
+  }
+  return m_routes
+      .emplace(name,
+               Route{name, m_shares[static_cast<std::size_t>(priority)],
+                     &metrics::MetricsRegistry::get_instance()->counter(
+                         "gateway_admission_rejected_total",
+                         "Requests rejected by concurrency limiter",
+                         "route=\"" + name + "\"")})
+      .first->second;
+}
+
+std::optional<admission::Permit>
+admission::ConcurrencyLimiter::tryAcquire(const Route *route) {
+  if (!m_enabled || route == nullptr) {
+    return Permit(nullptr);
+  }
+
+  /*every route is able to run at least one request*/
+  const std::size_t threshold = std::max<std::size_t>(
+      1, static_cast<std::size_t>(
+             static_cast<double>(m_limit.load(std::memory_order_relaxed)) *
+             route->share));
+
+  std::size_t current = m_inflight.load(std::memory_order_relaxed);
+  do {
+    if (current >= threshold) {
+      route->rejected->inc();
+      return std::nullopt;
+    }
+  } while (!m_inflight.compare_exchange_weak(current, current + 1,
+                                             std::memory_order_relaxed));
+  return Permit(this);
+}
+
+std::size_t admission::ConcurrencyLimiter::limit() const {
+  return m_limit.load(std::memory_order_relaxed);
+}
+
+std::size_t admission::ConcurrencyLimiter::inflight() const {
+  return m_inflight.load(std::memory_order_relaxed);
+}
+
+std::chrono::seconds admission::ConcurrencyLimiter::retryAfter() const {
+  return m_retry_after;
+}
+
+void admission::ConcurrencyLimiter::release(
+    std::chrono::steady_clock::duration rtt) {
+  /*in-flight amount including this request*/
+  const std::size_t inflight =
+      m_inflight.fetch_sub(1, std::memory_order_relaxed);
+
+  /*handlers are far slower than this critical section*/
+  std::lock_guard<std::mutex> _lckg(m_mtx);
+  m_window_rtt_sum += static_cast<double>(
+      std::chrono::duration_cast<std::chrono::microseconds>(rtt).count());
+  m_window_max_inflight = std::max(m_window_max_inflight, inflight);
+  ++m_window_samples;
+
+  auto now = std::chrono::steady_clock::now();
+  if (now < m_window_end) {
+    return;
+  }
+  updateLimit();
+
+  m_window_rtt_sum = 0;
+  m_window_samples = 0;
+  m_window_max_inflight = 0;
+  m_window_end = now + m_window;
+}
+
+void admission::ConcurrencyLimiter::updateLimit() {
+  const double short_rtt =
+      std::max(1.0, m_window_rtt_sum / static_cast<double>(m_window_samples));
+
+  if (m_long_rtt == 0) {
+    m_long_rtt = short_rtt;
+  } else {
+    m_long_rtt += (short_rtt - m_long_rtt) / m_long_window;
+  }
+
+  /*long rtt is inflated after an overload, let it catch up sooner*/
+  if (m_long_rtt / short_rtt > 2) {
+    m_long_rtt *= 0.95;
+  }
+
+  /*limit was not reached in this window, latency says nothing about it*/
+  if (static_cast<double>(m_window_max_inflight) < m_estimated_limit / 2) {
+    return;
+  }
+
+  /*
+   * additive increase while latency is within tolerance, otherwise
+   * multiplicative decrease by the gradient
+   */
+  const double gradient =
+      std::clamp(m_tolerance * m_long_rtt / short_rtt, 0.5, 1.0);
+  const double next = gradient < 1.0
+                          ? m_estimated_limit * gradient
+                          : m_estimated_limit + std::sqrt(m_estimated_limit);
+
+  m_estimated_limit =
+      std::clamp(m_estimated_limit * (1 - m_smoothing) + next * m_smoothing,
+                 m_min_limit, m_max_limit);
+  m_limit.store(static_cast<std::size_t>(m_estimated_limit),
+                std::memory_order_relaxed);
+}
@@ -1,4 +1,6 @@
 #include <http/HttpConnection.hpp>
+#include <http/HttpConnectionPool.hpp>
+#include <metrics/MetricsRegistry.hpp>
 #include <server/GateServer.hpp>
 #include <service/IOServicePool.hpp>
 #include <spdlog/spdlog.h>
@@ -6,8 +8,20 @@
 GateServer::GateServer(boost::asio::io_context &_ioc, unsigned short port)
     : m_ioc(_ioc),
       m_acceptor(_ioc, boost::asio::ip::tcp::endpoint(
-                           boost::asio::ip::address_v4::any(), port)) {
+                           boost::asio::ip::address_v4::any(), port)),
+      m_connections(0), m_accepting(true) {
   spdlog::info("Gateway Server activated, listen on port {}", port);
+  registerMetrics();
+  this->serverStart();
+}
+
+GateServer::GateServer(boost::asio::io_context &_ioc,
+                       native_handle_type listener)
+    : m_ioc(_ioc), m_acceptor(_ioc, boost::asio::ip::tcp::v4(), listener),
+      m_connections(0), m_accepting(true) {
+  spdlog::info("Gateway Server activated, inherit listener on port {}",
+               m_acceptor.local_endpoint().port());
+  registerMetrics();
   this->serverStart();
 }
 
@@ -16,46 +30,96 @@ GateServer::~GateServer() { spdlog::critical("Gateway Server Shutting Down!"); }
 void GateServer::serverStart() {
   boost::asio::io_context &ioc =
       IOServicePool::get_instance()->getIOServiceContext(); // get ioc
-  std::shared_ptr<Session<GateServer>> session =
-      std::make_shared<Session<GateServer>>(ioc, this);
 
-  this->m_acceptor.async_accept(session->s_socket,
+  /*reuse HTTPConnection which belongs to this io_context*/
+  std::shared_ptr<HTTPConnection> http =
+      HTTPConnectionPool::get_instance()->acquire(ioc);
+
+  this->m_acceptor.async_accept(http->http_socket,
                                 std::bind(&GateServer::handleAccept, this,
-                                          session, std::placeholders::_1));
+                                          http, std::placeholders::_1));
 }
 
-void GateServer::handleAccept(std::shared_ptr<Session<GateServer>> session,
+void GateServer::handleAccept(std::shared_ptr<HTTPConnection> http,
                               boost::system::error_code ec) {
   if (!ec) {
+    m_connections.fetch_add(1, std::memory_order_relaxed);
+    m_accepted->inc();
 
-    /*establish HTTPConnection to handle socket*/
-    std::shared_ptr<HTTPConnection> http(
-        std::make_shared<HTTPConnection>(session->s_socket));
-    http->start_service();
+    /*counter will be decreased when HTTPConnection is recycled*/
+    http->http_gate = this;
 
-    /*add to session pool*/
-    std::lock_guard<std::mutex> _lckg(m_mtx);
-    this->m_sessions.insert(std::make_pair(session->s_uuid, session));
+    /*the connection belongs to another io_context, start service there*/
+    boost::asio::post(http->http_socket.get_executor(),
+                      [http]() { http->start_service(); });
 
-  } else /*error occured!*/
+  } else if (m_accepting.load(std::memory_order_relaxed)) /*error occured!*/
   {
-    spdlog::info("GateWay Server Accept {} failed", session->s_uuid);
-    this->terminateSession(session->s_uuid);
+    spdlog::info("GateWay Server Accept failed, error: {}", ec.message());
   }
 
-  /*accept connection recursively*/
-  this->serverStart();
+  /*accept connection recursively, unless acceptor is closed by stopAccept*/
+  if (m_accepting.load(std::memory_order_relaxed)) {
+    this->serverStart();
+  }
 }
 
-void GateServer::terminateSession(const std::string &uuid) {
-  /*then remove it from the map, we should also lock it first*/
-  std::lock_guard<std::mutex> _lckg(m_mtx);
+void GateServer::stopAccept() {
+  if (!m_accepting.exchange(false)) {
+    return;
+  }
 
-  auto it = this->m_sessions.find(uuid);
+  /*acceptor is not thread safe, close it on its own io_context*/
+  boost::asio::post(m_acceptor.get_executor(), [this]() {
+    boost::system::error_code ec;
+    m_acceptor.close(ec);
+  });
+  spdlog::info("Gateway Server stops accepting, {} connections in flight",
+               openConnections());
+}
 
-  /*add safety consideration*/
-  if (it != this->m_sessions.end()) {
-    it->second->closeSession();
-    this->m_sessions.erase(uuid);
+bool GateServer::drain(std::chrono::milliseconds timeout) {
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (openConnections() != 0) {
+    if (std::chrono::steady_clock::now() >= deadline) {
+      spdlog::warn("Gateway Server drain timeout, {} connections dropped",
+                   openConnections());
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
   }
+  return true;
+}
+
+GateServer::native_handle_type GateServer::listener() {
+  return m_acceptor.native_handle();
+}
+
+void GateServer::releaseConnection() {
+  m_connections.fetch_sub(1, std::memory_order_relaxed);
+}
+
+std::size_t GateServer::openConnections() const {
+  return m_connections.load(std::memory_order_relaxed);
+}
+
+void GateServer::registerMetrics() {
+  auto registry = metrics::MetricsRegistry::get_instance();
+  m_accepted = &registry->counter("gateway_accepted_connections_total",
+                                  "Connections accepted by gateway");
+
+  registry->gauge("gateway_open_connections",
+                  "Connections which are still being served", {}, [this]() {
+                    return static_cast<double>(openConnections());
+                  });
+  registry->gauge("gateway_http_connection_pool_created",
+                  "HTTPConnection objects created by recycle pools", {}, []() {
+                    return static_cast<double>(
+                        HTTPConnectionPool::get_instance()->statistic().created);
+                  });
+  registry->gauge("gateway_http_connection_pool_reused",
+                  "HTTPConnection objects reused by recycle pools", {}, []() {
+                    return static_cast<double>(
+                        HTTPConnectionPool::get_instance()->statistic().reused);
+                  });
 }
@@ -1,22 +1,202 @@
 #include <grpc/GrpcBalanceService.hpp>
 #include <grpc/GrpcVerificationService.hpp>
+#include <handler/ConcurrencyLimiter.hpp>
 #include <handler/HandleMethod.hpp>
+#include <handler/RateLimiter.hpp>
 #include <http/HttpConnection.hpp>
+#include <config/ServerConfig.hpp>
+#include <cstring>
 #include <json/json.h>
 #include <json/reader.h>
 #include <json/value.h>
+#include <json/writer.h>
 #include <redis/RedisManager.hpp>
-#include <spdlog/spdlog.h>
+#include <log/LogManager.hpp>
+#include <service/CPUWorkerPool.hpp>
+#include <service/SingleFlight.hpp>
+#include <metrics/MetricsRegistry.hpp>
 #include <sql/MySQLConnectionPool.hpp>
+#include <sql/RegistrationBatcher.hpp>
+#include <stdexcept>
+#include <trace/Tracer.hpp>
+
+namespace {
+/*
+ * verification code taken by one registration. the key holds a mark instead
+ * of the code meanwhile, so concurrent requests can't use the code as well.
+ * it is put back unless the account was created, a failed sign-up can be
+ * retried with the same code
+ */
+class CodeClaim {
+public:
+  CodeClaim(std::string email, std::string code)
+      : m_email(std::move(email)), m_code(std::move(code)) {}
+
+  ~CodeClaim() {
+    if (m_used) {
+      return;
+    }
+    connection::ConnectionRAII<redis::RedisConnectionPool, redis::RedisContext>
+        raii;
+    if (!raii || raii->get()->swapValue(m_email, mark(m_code), m_code) != 1) {
+      logger::redis()->warn("Verification code of {} was not put back",
+                            m_email);
+    }
+  }
+
+  /*account exists, the mark expires together with the code*/
+  void use() { m_used = true; }
+
+  static constexpr std::string_view prefix = "claimed:";
+  static std::string mark(std::string_view code) {
+    return std::string(prefix).append(code);
+  }
+
+private:
+  std::string m_email;
+  std::string m_code;
+  bool m_used = false;
+};
+} // namespace
 
 HandleMethod::~HandleMethod() {}
 
 HandleMethod::HandleMethod() {
+  auto config = ServerConfig::get_instance();
+  verification_flight = std::make_unique<connection::SingleFlight<int32_t>>(
+      "/get_verification",
+      std::chrono::milliseconds(config->SingleFlight_verification_window));
+  account_flight =
+      std::make_unique<connection::SingleFlight<std::optional<bool>>>(
+      "/check_accountexists",
+      std::chrono::milliseconds(config->SingleFlight_account_window));
+  scrypt_params = tools::ScryptParams{
+      static_cast<uint8_t>(config->Password_scrypt_cost),
+      static_cast<uint32_t>(config->Password_scrypt_block_size),
+      static_cast<uint32_t>(config->Password_scrypt_parallelism)};
+
+  /*
+   * hashed once with the same parameters as every stored password. without it
+   * unknown usernames would answer faster than wrong passwords
+   */
+  std::optional<std::string> dummy =
+      tools::hashPassword("dummy", scrypt_params);
+  if (!dummy.has_value()) {
+    logger::http()->critical(
+        "Failed to hash the dummy password, check [Password] scrypt settings");
+    throw std::runtime_error("dummy password hash unavailable");
+  }
+  dummy_hash = std::move(dummy.value());
+
   /*register both get and post callbacks*/
   registerCallBacks();
 }
 
-void HandleMethod::registerGetCallBacks() {}
+template <typename _Job, typename _Continuation>
+bool HandleMethod::offload(std::shared_ptr<HTTPConnection> conn, _Job &&job,
+                           _Continuation &&continuation) {
+  const RouteInfo &route = route_info.find(conn->request().target())->second;
+  conn->http_deferred = true;
+
+  const bool queued = CPUWorkerPool::get_instance()->submit(
+      [conn, &route, job = std::forward<_Job>(job),
+       continuation = std::forward<_Continuation>(continuation)]() mutable {
+        auto result = job();
+
+        /*redis/mysql/grpc and the socket are only used on io threads*/
+        boost::asio::post(
+            conn->http_socket.get_executor(),
+            [conn, &route, result = std::move(result),
+             continuation = std::move(continuation)]() mutable {
+              conn->http_deferred = false;
+
+              /*
+               * handler deadline fired while the job was queued, nobody
+               * reads the answer, so don't write anything to the backends
+               */
+              if (!conn->http_socket.is_open()) {
+                finishRoute(route, false, conn);
+                if (conn->http_span.has_value()) {
+                  conn->http_span->setError();
+                }
+                conn->end_span();
+                return;
+              }
+
+              if (conn->http_span.has_value()) {
+                conn->http_span->resume();
+              }
+              const bool status = continuation(std::move(result));
+
+              /*continuation handed conn to another stage*/
+              if (conn->http_deferred) {
+                if (conn->http_span.has_value()) {
+                  conn->http_span->suspend();
+                }
+                return;
+              }
+              finishRoute(route, status, conn);
+              conn->write_response();
+              conn->end_span();
+            });
+      });
+  if (queued) {
+    /*
+     * hashing is bounded by the worker queue instead, counting it as
+     * in-flight would mix its latency into the io bound limit
+     */
+    conn->http_permit.reset();
+    return true;
+  }
+
+  conn->http_deferred = false;
+  rejectRequest(
+      static_cast<unsigned>(boost::beast::http::status::service_unavailable),
+      ServiceStatus::SERVICE_OVERLOADED,
+      admission::ConcurrencyLimiter::get_instance()->retryAfter(), conn);
+  return false;
+}
+
+std::function<void(bool)>
+HandleMethod::defer(std::shared_ptr<HTTPConnection> conn) {
+  const RouteInfo &route = route_info.find(conn->request().target())->second;
+  conn->http_deferred = true;
+  return [conn, &route](bool status) {
+    finishRoute(route, status, conn);
+    conn->write_response();
+    conn->end_span();
+  };
+}
+
+void HandleMethod::registerGetCallBacks() {
+  /*prometheus scrape endpoint*/
+  this->get_method_callback.emplace(
+      "/metrics", [](std::shared_ptr<HTTPConnection> conn) {
+        conn->http_response.set(boost::beast::http::field::content_type,
+                                "text/plain; version=0.0.4");
+        boost::beast::ostream(conn->http_response.body())
+            << metrics::MetricsRegistry::get_instance()->serialize();
+      });
+
+  /*readiness probe, 503 until every pool has its minimum connections*/
+  this->get_method_callback.emplace(
+      "/ready", [](std::shared_ptr<HTTPConnection> conn) {
+        const bool ready =
+            mysql::MySQLConnectionPool::get_instance()->ready() &&
+            redis::RedisConnectionPool::get_instance()->ready() &&
+            stubpool::VerificationServicePool::get_instance()->ready() &&
+            stubpool::BalancerServicePool::get_instance()->ready();
+
+        conn->http_response.set(boost::beast::http::field::content_type,
+                                "text/plain");
+        if (!ready) {
+          conn->http_response.result(
+              boost::beast::http::status::service_unavailable);
+        }
+        boost::beast::ostream(conn->http_response.body())
+            << (ready ? "ready" : "warming up");
+      });
+}
 
 void HandleMethod::registerPostCallBacks() {
   this->post_method_callback.emplace(
@@ -24,40 +204,58 @@ void HandleMethod::registerPostCallBacks() {
       [this](std::shared_ptr<HTTPConnection> conn) -> bool {
         conn->http_response.set(boost::beast::http::field::content_type,
                                 "text/json");
-        auto body =
-            boost::beast::buffers_to_string(conn->http_request.body().data());
+        std::string_view body = conn->request().body();
 
-        spdlog::info("Server receive post data: {}", body.c_str());
+        if (logger::LogManager::get_instance()->sampleRequest()) {
+          logger::http()->info("Server receive post data: {}",
+                               logger::LogManager::redact(body));
+        }
 
-        Json::Value send_root; /*write into body*/
         Json::Value src_root;  /*store json from client*/
-        Json::Reader reader;
 
         /*parsing failed*/
-        if (!reader.parse(body, src_root)) {
+        if (!parseJson(conn, src_root)) {
           generateErrorMessage("Failed to parse json data",
                                ServiceStatus::JSONPARSE_ERROR, conn);
           return false;
         }
 
-        if (!src_root.isMember("email")) {
+        /*Get email string and send to grpc service*/
+        std::string_view email;
+        if (!getStringView(src_root, "email", email)) {
           generateErrorMessage("Failed to parse json data",
                                ServiceStatus::JSONPARSE_ERROR, conn);
           return false;
         }
 
-        /*Get email string and send to grpc service*/
-        auto email = src_root["email"].asString();
-
-        spdlog::info("Server receive verification request, email addr: {}",
-                     email.c_str());
+        /*every call sends an email*/
+        if (!checkRateLimit(admission::RateKey::EMAIL, email, conn)) {
+          return false;
+        }
 
-        auto response = gRPCVerificationService::getVerificationCode(email);
+        logger::http()->debug(
+            "Server receive verification request, email addr: {}", email);
 
-        send_root["error"] = response.error();
-        send_root["email"] = src_root["email"].asString();
-        boost::beast::ostream(conn->http_response.body())
-            << send_root.toStyledString();
+        /*
+         * a client retrying before the first call returns gets the same
+         * result instead of another email. only the error code is shared,
+         * the response itself lives in the arena of the calling thread
+         */
+        auto respond = defer(conn);
+        verification_flight->run(
+            email, conn->http_socket.get_executor(),
+            [email]() {
+              return gRPCVerificationService::getVerificationCode(email)
+                  ->error();
+            },
+            [this, conn, respond,
+             email = src_root["email"]](int32_t error) {
+              Json::Value send_root; /*write into body*/
+              send_root["error"] = error;
+              send_root["email"] = email;
+              writeJson(send_root, conn);
+              respond(true);
+            });
         return true;
       });
 
@@ -66,97 +264,182 @@ void HandleMethod::registerPostCallBacks() {
       [this](std::shared_ptr<HTTPConnection> conn) -> bool {
         conn->http_response.set(boost::beast::http::field::content_type,
                                 "text/json");
-        auto body =
-            boost::beast::buffers_to_string(conn->http_request.body().data());
+        std::string_view body = conn->request().body();
 
-        spdlog::info("Server receive registration request, post data: {}",
-                     body.c_str());
+        if (logger::LogManager::get_instance()->sampleRequest()) {
+          logger::http()->info(
+              "Server receive registration request, post data: {}",
+              logger::LogManager::redact(body));
+        }
 
-        Json::Value send_root; /*write into body*/
         Json::Value src_root;  /*store json from client*/
-        Json::Reader reader;
 
         /*parsing failed*/
-        if (!reader.parse(body, src_root)) {
+        if (!parseJson(conn, src_root)) {
           generateErrorMessage("Failed to parse json data",
                                ServiceStatus::JSONPARSE_ERROR, conn);
           return false;
         }
 
+        /*Get email string and send to grpc service*/
+        std::string_view username, password, email, cpatcha;
+
         /*parsing failed*/
-        if (!(src_root.isMember("username") && src_root.isMember("password") &&
-              src_root.isMember("email") && src_root.isMember("cpatcha"))) {
+        if (!(getStringView(src_root, "username", username) &&
+              getStringView(src_root, "password", password) &&
+              getStringView(src_root, "email", email) &&
+              getStringView(src_root, "cpatcha", cpatcha))) {
           generateErrorMessage("Failed to parse json data",
                                ServiceStatus::JSONPARSE_ERROR, conn);
           return false;
         }
 
-        /*Get email string and send to grpc service*/
-        Json::String username = src_root["username"].asString();
-        Json::String password = src_root["password"].asString();
-        Json::String email = src_root["email"].asString();
-        Json::String cpatcha = src_root["cpatcha"].asString();
-
-        /*find verification code by checking email in redis*/
-        connection::ConnectionRAII<redis::RedisConnectionPool,
-                                   redis::RedisContext>
-            raii;
-
-        std::optional<std::string> verification_code =
-            raii->get()->checkValue(email);
+        if (!checkRateLimit(admission::RateKey::EMAIL, email, conn)) {
+          return false;
+        }
 
         /*
-         * Redis
-         * no verification code found!!
+         * claim the code in the same round trip which compares it, only one
+         * registration can use it. a mark is never accepted as a code
          */
-        if (!verification_code.has_value()) {
+        std::optional<int> matched = 0;
+        if (cpatcha.substr(0, CodeClaim::prefix.size()) != CodeClaim::prefix) {
+          /*released before the claim, which may need one to put it back*/
+          connection::ConnectionRAII<redis::RedisConnectionPool,
+                                     redis::RedisContext>
+              raii;
+          if (!raii) {
+            generateErrorMessage("Internel redis server error!",
+                                 ServiceStatus::REDIS_UNKOWN_ERROR, conn);
+            return false;
+          }
+          matched = raii->get()->swapValue(std::string(email), cpatcha,
+                                           CodeClaim::mark(cpatcha));
+        }
+        if (!matched.has_value()) {
           generateErrorMessage("Internel redis server error!",
                                ServiceStatus::REDIS_UNKOWN_ERROR, conn);
           return false;
         }
 
-        if (verification_code.value() != cpatcha) {
-          generateErrorMessage("CPATCHA is different from Redis DB!",
+        /*
+         * Redis
+         * no verification code found!!
+         */
+        if (matched.value() < 0) {
+          generateErrorMessage("No CPATCHA related to this email!",
                                ServiceStatus::REDIS_CPATCHA_NOT_FOUND, conn);
           return false;
         }
 
-        MySQLRequestStruct request;
-        request.m_username = username;
-        request.m_password = password;
-        request.m_email = email;
-
-        /*MYSQL(start to create a new user)*/
-        connection::ConnectionRAII<mysql::MySQLConnectionPool,
-                                   mysql::MySQLConnection>
-            mysql;
-
-        if (!mysql->get()->registerNewUser(std::move(request))) {
-          generateErrorMessage("MYSQL user register error",
-                               ServiceStatus::MYSQL_INTERNAL_ERROR, conn);
+        if (matched.value() == 0) {
+          generateErrorMessage("CPATCHA is different from Redis DB!",
+                               ServiceStatus::REDIS_CPATCHA_NOT_FOUND, conn);
           return false;
         }
-
-        /*get uuid by username*/
-        std::optional<std::size_t> res = mysql->get()->getUUIDByUsername(username);
-        if (!res.has_value()) {
-                  generateErrorMessage("No UUID related to Username",
-                            ServiceStatus::LOGIN_UNSUCCESSFUL, conn);
+        auto claim = std::make_shared<CodeClaim>(std::string(email),
+                                                 std::string(cpatcha));
+
+        /*json values are gone once this callback returns, copy them*/
+        return offload(
+            conn,
+            [password = std::string(password), params = scrypt_params]() {
+              return tools::hashPassword(password, params);
+            },
+            [this, conn, claim, username = std::string(username),
+             password = std::string(password), email = std::string(email)](
+                std::optional<std::string> hashed) -> bool {
+              if (!hashed.has_value()) {
+                generateErrorMessage("Password hashing error",
+                                     ServiceStatus::MYSQL_INTERNAL_ERROR,
+                                     conn);
+                return false;
+              }
+
+              auto registered = [this, conn, claim, username, password,
+                                 email](std::size_t uuid) {
+                /*a code creates one account, the account exists now*/
+                claim->use();
+
+                Json::Value send_root;
+                send_root["error"] =
+                    static_cast<uint8_t>(ServiceStatus::SERVICE_SUCCESS);
+                send_root["username"] = username;
+                send_root["password"] = password;
+                send_root["email"] = email;
+
+                /*get required uuid, and return it back to user!*/
+                send_root["uuid"] = std::to_string(uuid);
+
+                writeJson(send_root, conn);
+              };
+
+              /*concurrent sign-ups are inserted by one multi-row INSERT*/
+              auto &batcher = mysql::RegistrationBatcher::get_instance();
+              if (batcher->enabled()) {
+                auto respond = defer(conn);
+                auto done = [this, conn, respond, registered](
+                                std::optional<std::size_t> uuid) {
+                  boost::asio::post(
+                      conn->http_socket.get_executor(),
+                      [this, conn, respond, registered, uuid]() {
+                        if (!uuid.has_value()) {
+                          generateErrorMessage(
+                              "MYSQL user register error",
+                              ServiceStatus::MYSQL_INTERNAL_ERROR, conn);
+                          respond(false);
+                          return;
+                        }
+                        registered(uuid.value());
+                        respond(true);
+                      });
+                };
+                if (!batcher->submit(username, std::move(*hashed), email,
+                                     std::move(done))) {
+                  generateErrorMessage("MYSQL user register error",
+                                       ServiceStatus::MYSQL_INTERNAL_ERROR,
+                                       conn);
+                  respond(false);
                   return false;
-        }
-
-        send_root["error"] =
-            static_cast<uint8_t>(ServiceStatus::SERVICE_SUCCESS);
-        send_root["username"] = username;
-        send_root["password"] = password;
-        send_root["email"] = email;
-
-        /*get required uuid, and return it back to user!*/
-        send_root["uuid"] = std::to_string(res.value());
-
-        boost::beast::ostream(conn->http_response.body())
-            << send_root.toStyledString();
-        return true;
+                }
+                return true;
+              }
+
+              MySQLRequestStruct request;
+              request.m_username = username;
+              request.m_password = *hashed;
+              request.m_email = email;
+
+              /*MYSQL(start to create a new user)*/
+              connection::ConnectionRAII<mysql::MySQLConnectionPool,
+                                         mysql::MySQLConnection>
+                  mysql;
+              if (!mysql) {
+                generateErrorMessage("MYSQL connection unavailable",
+                                     ServiceStatus::MYSQL_INTERNAL_ERROR,
+                                     conn);
+                return false;
+              }
+
+              if (!mysql->get()->registerNewUser(std::move(request))) {
+                generateErrorMessage("MYSQL user register error",
+                                     ServiceStatus::MYSQL_INTERNAL_ERROR,
+                                     conn);
+                return false;
+              }
+
+              /*get uuid by username*/
+              std::optional<std::size_t> res =
+                  mysql->get()->getUUIDByUsername(username);
+              if (!res.has_value()) {
+                generateErrorMessage("No UUID related to Username",
+                                     ServiceStatus::LOGIN_UNSUCCESSFUL, conn);
+                return false;
+              }
+
+              registered(res.value());
+              return true;
+            });
       });
 
   this->post_method_callback.emplace(
@@ -164,52 +447,81 @@ void HandleMethod::registerPostCallBacks() {
       [this](std::shared_ptr<HTTPConnection> conn) -> bool {
         conn->http_response.set(boost::beast::http::field::content_type,
                                 "text/json");
-        auto body =
-            boost::beast::buffers_to_string(conn->http_request.body().data());
+        std::string_view body = conn->request().body();
 
-        spdlog::info("Server receive registration request, post data: {}",
-                     body.c_str());
+        if (logger::LogManager::get_instance()->sampleRequest()) {
+          logger::http()->info(
+              "Server receive registration request, post data: {}",
+              logger::LogManager::redact(body));
+        }
 
-        Json::Value send_root; /*write into body*/
         Json::Value src_root;  /*store json from client*/
-        Json::Reader reader;
 
         /*parsing failed*/
-        if (!reader.parse(body, src_root)) {
+        if (!parseJson(conn, src_root)) {
           generateErrorMessage("Failed to parse json data",
                                ServiceStatus::JSONPARSE_ERROR, conn);
           return false;
         }
 
+        /*Get email string and send to grpc service*/
+        std::string_view username, email;
+
         /*parsing failed*/
-        if (!(src_root.isMember("username") && src_root.isMember("email"))) {
+        if (!(getStringView(src_root, "username", username) &&
+              getStringView(src_root, "email", email))) {
           generateErrorMessage("Failed to parse json data",
                                ServiceStatus::JSONPARSE_ERROR, conn);
           return false;
         }
 
-        /*Get email string and send to grpc service*/
-        Json::String username = src_root["username"].asString();
-        Json::String email = src_root["email"].asString();
-
-        /*MYSQL(check exist)*/
-        connection::ConnectionRAII<mysql::MySQLConnectionPool,
-                                   mysql::MySQLConnection>
-            mysql;
-
-        if (!mysql->get()->checkAccountAvailability(username, email)) {
-          generateErrorMessage("MYSQL account not exists",
-                               ServiceStatus::MYSQL_ACCOUNT_NOT_EXISTS, conn);
+        if (!checkRateLimit(admission::RateKey::USERNAME, username, conn)) {
           return false;
         }
 
-        send_root["error"] =
-            static_cast<uint8_t>(ServiceStatus::SERVICE_SUCCESS);
-        send_root["username"] = username;
-        send_root["email"] = email;
-
-        boost::beast::ostream(conn->http_response.body())
-            << send_root.toStyledString();
+        /*length prefix keeps (username, email) pairs distinct*/
+        std::string key = std::to_string(username.size());
+        key.append(1, ':').append(username).append(email);
+
+        /*MYSQL(check exist), followers do not take a connection*/
+        auto respond = defer(conn);
+        account_flight->run(
+            key, conn->http_socket.get_executor(),
+            [username, email]() -> std::optional<bool> {
+              connection::ConnectionRAII<mysql::MySQLConnectionPool,
+                                         mysql::MySQLConnection>
+                  mysql(mysql::MySQLConnectionPool::get_instance()->route(
+                      mysql::MySQLSelection::FIND_EXISTING_USER, username));
+              if (!mysql) {
+                return std::nullopt;
+              }
+              return mysql->get()->checkAccountAvailability(username, email);
+            },
+            [this, conn, respond, username = src_root["username"],
+             email = src_root["email"]](std::optional<bool> available) {
+              if (!available.has_value()) {
+                generateErrorMessage("MYSQL connection unavailable",
+                                     ServiceStatus::MYSQL_INTERNAL_ERROR,
+                                     conn);
+                respond(false);
+                return;
+              }
+              if (!available.value()) {
+                generateErrorMessage("MYSQL account not exists",
+                                     ServiceStatus::MYSQL_ACCOUNT_NOT_EXISTS,
+                                     conn);
+                respond(false);
+                return;
+              }
+
+              Json::Value send_root; /*write into body*/
+              send_root["error"] =
+                  static_cast<uint8_t>(ServiceStatus::SERVICE_SUCCESS);
+              send_root["username"] = username;
+              send_root["email"] = email;
+              writeJson(send_root, conn);
+              respond(true);
+            });
         return true;
       });
 
@@ -217,137 +529,200 @@ void HandleMethod::registerPostCallBacks() {
       "/reset_password", [this](std::shared_ptr<HTTPConnection> conn) -> bool {
         conn->http_response.set(boost::beast::http::field::content_type,
                                 "text/json");
-        auto body =
-            boost::beast::buffers_to_string(conn->http_request.body().data());
+        std::string_view body = conn->request().body();
 
-        spdlog::info("Server receive registration request, post data: {}",
-                     body.c_str());
+        if (logger::LogManager::get_instance()->sampleRequest()) {
+          logger::http()->info(
+              "Server receive registration request, post data: {}",
+              logger::LogManager::redact(body));
+        }
 
-        Json::Value send_root; /*write into body*/
         Json::Value src_root;  /*store json from client*/
-        Json::Reader reader;
 
         /*parsing failed*/
-        if (!reader.parse(body, src_root)) {
+        if (!parseJson(conn, src_root)) {
           generateErrorMessage("Failed to parse json data",
                                ServiceStatus::JSONPARSE_ERROR, conn);
           return false;
         }
 
+        /*Get email string and send to grpc service*/
+        std::string_view username, password, email;
+
         /*parsing failed*/
-        if (!(src_root.isMember("username") && src_root.isMember("password") &&
-              src_root.isMember("email"))) {
+        if (!(getStringView(src_root, "username", username) &&
+              getStringView(src_root, "password", password) &&
+              getStringView(src_root, "email", email))) {
           generateErrorMessage("Failed to parse json data",
                                ServiceStatus::JSONPARSE_ERROR, conn);
           return false;
         }
 
-        /*Get email string and send to grpc service*/
-        Json::String username = src_root["username"].asString();
-        Json::String password = src_root["password"].asString();
-        Json::String email = src_root["email"].asString();
-
-        MySQLRequestStruct request;
-        request.m_username = username;
-        request.m_password = password;
-        request.m_email = email;
-
-        /*MYSQL(update table)*/
-        connection::ConnectionRAII<mysql::MySQLConnectionPool,
-                                   mysql::MySQLConnection>
-            mysql;
-
-        if (!mysql->get()->alterUserPassword(std::move(request))) {
-          generateErrorMessage("Missing critical info",
-                               ServiceStatus::MYSQL_MISSING_INFO, conn);
+        if (!checkRateLimit(admission::RateKey::USERNAME, username, conn)) {
           return false;
         }
 
-        send_root["error"] =
-            static_cast<uint8_t>(ServiceStatus::SERVICE_SUCCESS);
-
-        boost::beast::ostream(conn->http_response.body())
-            << send_root.toStyledString();
-        return true;
+        return offload(
+            conn,
+            [password = std::string(password), params = scrypt_params]() {
+              return tools::hashPassword(password, params);
+            },
+            [this, conn, username = std::string(username),
+             email = std::string(email)](
+                std::optional<std::string> hashed) -> bool {
+              if (!hashed.has_value()) {
+                generateErrorMessage("Password hashing error",
+                                     ServiceStatus::MYSQL_INTERNAL_ERROR,
+                                     conn);
+                return false;
+              }
+
+              MySQLRequestStruct request;
+              request.m_username = username;
+              request.m_password = *hashed;
+              request.m_email = email;
+
+              /*MYSQL(update table)*/
+              connection::ConnectionRAII<mysql::MySQLConnectionPool,
+                                         mysql::MySQLConnection>
+                  mysql;
+              if (!mysql) {
+                generateErrorMessage("MYSQL connection unavailable",
+                                     ServiceStatus::MYSQL_INTERNAL_ERROR,
+                                     conn);
+                return false;
+              }
+
+              if (!mysql->get()->alterUserPassword(std::move(request))) {
+                generateErrorMessage("Missing critical info",
+                                     ServiceStatus::MYSQL_MISSING_INFO, conn);
+                return false;
+              }
+
+              Json::Value send_root;
+              send_root["error"] =
+                  static_cast<uint8_t>(ServiceStatus::SERVICE_SUCCESS);
+
+              writeJson(send_root, conn);
+              return true;
+            });
       });
 
   this->post_method_callback.emplace(
       "/trylogin_server", [this](std::shared_ptr<HTTPConnection> conn) -> bool {
         conn->http_response.set(boost::beast::http::field::content_type,
                                 "text/json");
-        auto body =
-            boost::beast::buffers_to_string(conn->http_request.body().data());
+        std::string_view body = conn->request().body();
 
-        spdlog::info("Server receive server allocation request, post data: {}",
-                     body.c_str());
+        if (logger::LogManager::get_instance()->sampleRequest()) {
+          logger::http()->info(
+              "Server receive server allocation request, post data: {}",
+              logger::LogManager::redact(body));
+        }
 
-        Json::Value send_root; /*write into body*/
         Json::Value src_root;  /*store json from client*/
-        Json::Reader reader;
 
         /*parsing failed*/
-        if (!reader.parse(body, src_root)) {
+        if (!parseJson(conn, src_root)) {
           generateErrorMessage("Failed to parse json data",
                                ServiceStatus::JSONPARSE_ERROR, conn);
           return false;
         }
 
+        /*Get email string and send to grpc service*/
+        std::string_view username, password;
+
         /*parsing failed*/
-        if (!(src_root.isMember("username") && src_root.isMember("password"))) {
+        if (!(getStringView(src_root, "username", username) &&
+              getStringView(src_root, "password", password))) {
           generateErrorMessage("Failed to parse json data",
                                ServiceStatus::JSONPARSE_ERROR, conn);
           return false;
         }
 
-        /*Get email string and send to grpc service*/
-        Json::String username = src_root["username"].asString();
-        Json::String password = src_root["password"].asString();
-
-        /*MYSQL(select username & password and retrieve uuid)*/
-        connection::ConnectionRAII<mysql::MySQLConnectionPool,
-                                   mysql::MySQLConnection>
-            mysql;
-
-        /*check account credential*/
-        [[maybe_unused]] std::optional<std::size_t> res =
-            mysql->get()->checkAccountLogin(username, password);
-        if (!res.has_value()) {
-          generateErrorMessage("Wrong username or password",
-                               ServiceStatus::LOGIN_INFO_ERROR, conn);
+        /*password guessing of one account*/
+        if (!checkRateLimit(admission::RateKey::USERNAME, username, conn)) {
           return false;
         }
 
-        /*get uuid by username*/
-        res = mysql->get()->getUUIDByUsername(username);
-        if (!res.has_value()) {
-                  generateErrorMessage("No UUID related to Username",
-                            ServiceStatus::LOGIN_UNSUCCESSFUL, conn);
-                  return false;
+        /*MYSQL(select stored password hash)*/
+        std::optional<std::string> stored;
+        {
+          connection::ConnectionRAII<mysql::MySQLConnectionPool,
+                                     mysql::MySQLConnection>
+              mysql(mysql::MySQLConnectionPool::get_instance()->route(
+                  mysql::MySQLSelection::USER_LOGIN_CHECK, username));
+          if (!mysql) {
+            generateErrorMessage("MYSQL connection unavailable",
+                                 ServiceStatus::MYSQL_INTERNAL_ERROR, conn);
+            return false;
+          }
+          stored = mysql->get()->getPasswordHash(username);
         }
 
-        std::size_t uuid = res.value();
-
         /*
-         *pass user's uuid parameter to the server, and returns available server
-         *address to user
+         * unknown usernames are verified against a dummy hash as well, the
+         * response time doesn't tell whether the account exists
          */
-        auto response = gRPCBalancerService::addNewUserToServer(uuid);
-
-        if (response.error() !=
-            static_cast<int32_t>(ServiceStatus::SERVICE_SUCCESS)) {
-          spdlog::error("[client {}] try login server failed!, error code {}",
-                        std::to_string(uuid), response.error());
-        }
+        const bool exists = stored.has_value();
 
-        send_root["uuid"] = std::to_string(uuid);
-        send_root["error"] = response.error();
-        send_root["host"] = response.host();
-        send_root["port"] = response.port();
-        send_root["token"] = response.token();
-
-        boost::beast::ostream(conn->http_response.body())
-            << send_root.toStyledString();
-        return true;
+        /*check account credential*/
+        return offload(
+            conn,
+            [password = std::string(password),
+             stored = exists ? std::move(stored.value()) : dummy_hash]() {
+              return tools::verifyPassword(password, stored);
+            },
+            [this, conn, exists,
+             username = std::string(username)](bool verified) -> bool {
+              if (!exists || !verified) {
+                generateErrorMessage("Wrong username or password",
+                                     ServiceStatus::LOGIN_INFO_ERROR, conn);
+                return false;
+              }
+
+              /*get uuid by username*/
+              std::optional<std::size_t> res;
+              {
+                connection::ConnectionRAII<mysql::MySQLConnectionPool,
+                                           mysql::MySQLConnection>
+                    mysql(mysql::MySQLConnectionPool::get_instance()->route(
+                        mysql::MySQLSelection::GET_USER_UUID, username));
+                if (mysql) {
+                  res = mysql->get()->getUUIDByUsername(username);
+                }
+              }
+              if (!res.has_value()) {
+                generateErrorMessage("No UUID related to Username",
+                                     ServiceStatus::LOGIN_UNSUCCESSFUL, conn);
+                return false;
+              }
+
+              std::size_t uuid = res.value();
+
+              /*
+               *pass user's uuid parameter to the server, and returns
+               *available server address to user
+               */
+              auto response = gRPCBalancerService::addNewUserToServer(uuid);
+
+              if (response->error() !=
+                  static_cast<int32_t>(ServiceStatus::SERVICE_SUCCESS)) {
+                logger::grpc()->error(
+                    "[client {}] try login server failed!, error code {}",
+                    uuid, response->error());
+              }
+
+              Json::Value send_root;
+              send_root["uuid"] = std::to_string(uuid);
+              send_root["error"] = response->error();
+              send_root["host"] = response->host();
+              send_root["port"] = response->port();
+              send_root["token"] = response->token();
+
+              writeJson(send_root, conn);
+              return true;
+            });
       });
 }
 
@@ -355,32 +730,228 @@ void HandleMethod::generateErrorMessage(std::string_view message,
                                         ServiceStatus status,
                                         std::shared_ptr<HTTPConnection> conn) {
   Json::Value root;
-  spdlog::error(message);
+  logger::http()->error(message);
   root["error"] = static_cast<uint8_t>(status);
-  boost::beast::ostream(conn->http_response.body()) << root.toStyledString();
+  writeJson(root, conn);
+}
+
+bool HandleMethod::parseJson(std::shared_ptr<HTTPConnection> conn,
+                             Json::Value &root) {
+  /*CharReader is reusable, create one for each io thread*/
+  thread_local std::unique_ptr<Json::CharReader> reader(
+      Json::CharReaderBuilder().newCharReader());
+
+  trace::Span span("json.parse");
+  std::string_view body = conn->request().body();
+  return reader->parse(body.data(), body.data() + body.size(), &root,
+                       nullptr);
+}
+
+void HandleMethod::writeJson(const Json::Value &root,
+                             std::shared_ptr<HTTPConnection> conn) {
+  thread_local std::unique_ptr<Json::StreamWriter> writer = []() {
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    return std::unique_ptr<Json::StreamWriter>(builder.newStreamWriter());
+  }();
+
+  trace::Span span("json.write");
+
+  /*response body keeps its capacity after HTTPConnection is recycled*/
+  auto os = boost::beast::ostream(conn->http_response.body());
+  writer->write(root, &os);
+}
+
+bool HandleMethod::getStringView(const Json::Value &root, const char *key,
+                                 std::string_view &value) {
+  const Json::Value *member = root.find(key, key + std::strlen(key));
+  if (member == nullptr || !member->isString()) {
+    return false;
+  }
+
+  const char *begin = nullptr;
+  const char *end = nullptr;
+  if (!member->getString(&begin, &end)) {
+    return false;
+  }
+  value = std::string_view(begin, static_cast<std::size_t>(end - begin));
+  return true;
 }
 
 void HandleMethod::registerCallBacks() {
   registerGetCallBacks();
   registerPostCallBacks();
+  registerRouteInfo();
+}
+
+void HandleMethod::registerRouteInfo() {
+  /*
+   * login keeps working during a registration storm, routes which are not
+   * listed here(/metrics, /ready) are never rejected
+   */
+  static const std::map<std::string_view, admission::Priority> priorities = {
+      {"/trylogin_server", admission::Priority::HIGH},
+      {"/check_accountexists", admission::Priority::NORMAL},
+      {"/reset_password", admission::Priority::NORMAL},
+      {"/post_registration", admission::Priority::LOW},
+      {"/get_verification", admission::Priority::LOW}};
+
+  auto registry = metrics::MetricsRegistry::get_instance();
+  auto &limiter = admission::ConcurrencyLimiter::get_instance();
+  auto create = [&](const std::string &route) {
+    const std::string labels = "route=\"" + route + "\"";
+    auto priority = priorities.find(route);
+    route_info.emplace(
+        route,
+        RouteInfo{
+            &registry->counter("gateway_route_requests_total",
+                               "Requests dispatched to route", labels),
+            &registry->counter("gateway_route_failures_total",
+                               "Requests rejected by route handler", labels),
+            &registry->histogram("gateway_route_duration_seconds",
+                                 "Route handler latency", labels),
+            priority == priorities.end()
+                ? nullptr
+                : &limiter->route(route, priority->second)});
+  };
+
+  for (const auto &[route, callback] : get_method_callback) {
+    create(route);
+  }
+  for (const auto &[route, callback] : post_method_callback) {
+    create(route);
+  }
+}
+
+void HandleMethod::rejectRequest(unsigned status, ServiceStatus error,
+                                 std::chrono::seconds retry_after,
+                                 std::shared_ptr<HTTPConnection> conn) {
+  conn->http_response.result(status);
+  conn->http_response.set(boost::beast::http::field::retry_after,
+                          std::to_string(retry_after.count()));
+  conn->http_response.set(boost::beast::http::field::content_type,
+                          "text/json");
+
+  /*no log here, rejected clients should not make the server write more*/
+  Json::Value root;
+  root["error"] = static_cast<uint8_t>(error);
+  writeJson(root, conn);
+}
+
+bool HandleMethod::checkRateLimit(admission::RateKey kind,
+                                  std::string_view key,
+                                  std::shared_ptr<HTTPConnection> conn) {
+  auto retry_after = admission::RateLimiter::get_instance()->check(kind, key);
+  if (!retry_after.has_value()) {
+    return true;
+  }
+  rejectRequest(
+      static_cast<unsigned>(boost::beast::http::status::too_many_requests),
+      ServiceStatus::RATE_LIMITED, *retry_after, conn);
+  return false;
+}
+
+std::string_view
+HandleMethod::remoteKey(const std::shared_ptr<HTTPConnection> &conn,
+                        std::array<unsigned char, 16> &storage) {
+  boost::system::error_code ec;
+  auto address = conn->http_socket.remote_endpoint(ec).address();
+  if (ec) {
+    return {};
+  }
+
+  std::size_t length = 0;
+  if (address.is_v6() && address.to_v6().is_v4_mapped()) {
+    address = boost::asio::ip::make_address_v4(boost::asio::ip::v4_mapped,
+                                               address.to_v6());
+  }
+  if (address.is_v4()) {
+    auto bytes = address.to_v4().to_bytes();
+    length = bytes.size();
+    std::copy(bytes.begin(), bytes.end(), storage.begin());
+  } else {
+    /*one ipv6 client usually owns a whole /64*/
+    auto bytes = address.to_v6().to_bytes();
+    length = 8;
+    std::copy(bytes.begin(), bytes.begin() + length, storage.begin());
+  }
+  return std::string_view(reinterpret_cast<const char *>(storage.data()),
+                          length);
 }
 
 bool HandleMethod::handleGetMethod(
-    std::string str, std::shared_ptr<HTTPConnection> extended_lifetime) {
+    std::string_view str, std::shared_ptr<HTTPConnection> extended_lifetime) {
+  auto it = get_method_callback.find(str);
+
   /*Callback Func Not Found*/
-  if (get_method_callback.find(str) == get_method_callback.end()) {
+  if (it == get_method_callback.end()) {
     return false;
   }
-  get_method_callback[str](extended_lifetime);
+
+  const RouteInfo &route = route_info.find(str)->second;
+  route.requests->inc();
+
+  auto &limiter = admission::ConcurrencyLimiter::get_instance();
+  auto permit = limiter->tryAcquire(route.admission);
+  if (!permit.has_value()) {
+    rejectRequest(
+        static_cast<unsigned>(boost::beast::http::status::service_unavailable),
+        ServiceStatus::SERVICE_OVERLOADED, limiter->retryAfter(),
+        extended_lifetime);
+    return true;
+  }
+
+  metrics::ScopedTimer timer(*route.latency);
+  it->second(extended_lifetime);
   return true;
 }
 
 bool HandleMethod::handlePostMethod(
-    std::string str, std::shared_ptr<HTTPConnection> extended_lifetime) {
+    std::string_view str, std::shared_ptr<HTTPConnection> extended_lifetime) {
+  auto it = post_method_callback.find(str);
+
   /*Callback Func Not Found*/
-  if (post_method_callback.find(str) == post_method_callback.end()) {
+  if (it == post_method_callback.end()) {
     return false;
   }
-  [[maybe_unused]] bool res = post_method_callback[str](extended_lifetime);
+
+  const RouteInfo &route = route_info.find(str)->second;
+  route.requests->inc();
+
+  /*abusive clients are rejected before they occupy any in-flight slot*/
+  std::array<unsigned char, 16> address;
+  std::string_view ip = remoteKey(extended_lifetime, address);
+  if (!ip.empty() &&
+      !checkRateLimit(admission::RateKey::IP, ip, extended_lifetime)) {
+    return true;
+  }
+
+  auto &limiter = admission::ConcurrencyLimiter::get_instance();
+  auto permit = limiter->tryAcquire(route.admission);
+  if (!permit.has_value()) {
+    rejectRequest(
+        static_cast<unsigned>(boost::beast::http::status::service_unavailable),
+        ServiceStatus::SERVICE_OVERLOADED, limiter->retryAfter(),
+        extended_lifetime);
+    return true;
+  }
+
+  /*released once the handler returns or hands its work to offload()*/
+  extended_lifetime->http_permit.emplace(std::move(*permit));
+  extended_lifetime->http_handler_start = std::chrono::steady_clock::now();
+  const bool status = it->second(extended_lifetime);
+  if (!extended_lifetime->http_deferred) {
+    finishRoute(route, status, extended_lifetime);
+  }
   return true;
 }
+
+void HandleMethod::finishRoute(const RouteInfo &route, bool status,
+                               const std::shared_ptr<HTTPConnection> &conn) {
+  route.latency->observe(std::chrono::steady_clock::now() -
+                         conn->http_handler_start);
+  if (!status) {
+    route.failures->inc();
+  }
+  conn->http_permit.reset();
+}
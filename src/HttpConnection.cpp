@@ -1,55 +1,253 @@
 //#include <ada.h>
 #include <boost/url.hpp>
+#include <config/ServerConfig.hpp>
 #include <handler/HandleMethod.hpp>
 #include <http/HttpConnection.hpp>
-#include <spdlog/spdlog.h>
+#include <server/GateServer.hpp>
+#include <service/IOServicePool.hpp>
+#include <trace/Tracer.hpp>
+#include <log/LogManager.hpp>
+#include <metrics/MetricsRegistry.hpp>
 
-HTTPConnection::HTTPConnection(boost::asio::ip::tcp::socket &_socket)
-    : http_socket(_socket) {}
+HTTPConnection::HTTPConnection(boost::asio::io_context &_ioc)
+    : http_socket(_ioc),
+      http_wheel(IOServicePool::get_instance()->getTimingWheel(_ioc)),
+      http_deadline(this, &HTTPConnection::on_deadline),
+      http_arena_storage(std::make_unique<std::byte[]>(
+          ServerConfig::get_instance()->GateServer_request_arena_size)),
+      http_arena(http_arena_storage.get(),
+                 ServerConfig::get_instance()->GateServer_request_arena_size) {}
+
+std::pmr::memory_resource *HTTPConnection::arena() { return &http_arena; }
+
+HTTPConnection::request_type &HTTPConnection::request() {
+  return http_parser->get();
+}
 
 void HTTPConnection::start_service() {
+  http_request_start = std::chrono::steady_clock::now();
+
+  /*both header fields and body are allocated from http_arena*/
+  http_parser.emplace(std::piecewise_construct,
+                      std::make_tuple(arena_allocator(&http_arena)),
+                      std::make_tuple(arena_allocator(&http_arena)));
+
   activate_receiver();
-  check_timeout();
 }
 
-void HTTPConnection::check_timeout() {
+void HTTPConnection::recycle() {
+  boost::system::error_code ec;
+  http_wheel.cancel(http_deadline);
+  if (http_socket.is_open()) {
+    http_socket.close(ec);
+  }
+
+  /*clear() keeps the memory which has already been allocated*/
+  http_buffer.consume(http_buffer.size());
+  http_response.base().clear();
+  http_response.body().clear();
+  http_response.result(boost::beast::http::status::ok);
+
+  http_url_info = std::string_view{};
+  http_params.clear();
+  http_timed_out = false;
+  http_body_received = 0;
+  http_deferred = false;
+  http_permit.reset();
+  http_span.reset();
+
+  /*free the whole request at once*/
+  http_parser.reset();
+  http_arena.release();
+
+  if (http_gate != nullptr) {
+    http_gate->releaseConnection();
+    http_gate = nullptr;
+  }
+}
+
+void HTTPConnection::arm_deadline(Phase phase) {
+  auto config = ServerConfig::get_instance();
+  std::chrono::milliseconds timeout{0};
+  switch (phase) {
+  case Phase::HEADER:
+    timeout = std::chrono::milliseconds(config->GateServer_header_timeout_ms);
+    break;
+  case Phase::BODY: {
+    /*
+     * body deadline is absolute, but the client is not allowed to stall
+     * longer than grace period between two chunks either
+     */
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        http_body_deadline - std::chrono::steady_clock::now());
+    timeout = std::min(
+        remaining,
+        std::chrono::milliseconds(config->GateServer_body_rate_grace_ms));
+    if (timeout.count() <= 0) {
+      timeout = std::chrono::milliseconds(1);
+    }
+    break;
+  }
+  case Phase::HANDLER:
+    timeout = std::chrono::milliseconds(config->GateServer_handler_timeout_ms);
+    break;
+  case Phase::WRITE:
+    timeout = std::chrono::milliseconds(config->GateServer_write_timeout_ms);
+    break;
+  }
+  http_phase = phase;
+  http_wheel.arm(http_deadline, timeout);
+}
+
+void HTTPConnection::on_deadline(void *owner) {
+  /*
+   * the wheel doesn't extend HTTPConnection's life time, closing the socket
+   * aborts pending operations and their handlers release this connection
+   */
+  auto *self = static_cast<HTTPConnection *>(owner);
+  boost::system::error_code ec;
+
+  /*client is too slow, abort reading and respond 408*/
+  if (self->http_phase == Phase::HEADER || self->http_phase == Phase::BODY) {
+    self->http_timed_out = true;
+    self->http_socket.cancel(ec);
+    return;
+  }
+  self->http_socket.close(ec);
+}
+
+void HTTPConnection::activate_receiver() {
   /*extended HTTPConnection class life time*/
   std::shared_ptr<HTTPConnection> extended_lifetime = shared_from_this();
 
-  http_timer.async_wait(
-      [extended_lifetime, this](boost::system::error_code ec) {
-        if (!ec) {
-          /*if timeout then shutdown connection*/
-          extended_lifetime->http_socket.close();
+  auto config = ServerConfig::get_instance();
+  http_parser->header_limit(
+      static_cast<std::uint32_t>(config->GateServer_header_limit));
+  http_parser->body_limit(config->GateServer_body_limit);
+
+  arm_deadline(Phase::HEADER);
+  boost::beast::http::async_read_header(
+      http_socket, http_buffer, *http_parser,
+      [this, extended_lifetime](boost::system::error_code ec,
+                                std::size_t bytes_transferred) {
+        boost::ignore_unused(bytes_transferred);
+        if (ec) {
+          handle_read_error(ec);
+          return;
+        }
+
+        /*reject oversized body before reading it*/
+        auto length = http_parser->content_length();
+        if (length.has_value() &&
+            length.value() >
+                ServerConfig::get_instance()->GateServer_body_limit) {
+          return_error(boost::beast::http::status::payload_too_large);
+          return;
         }
+
+        http_body_start = std::chrono::steady_clock::now();
+        http_body_deadline =
+            http_body_start +
+            std::chrono::milliseconds(
+                ServerConfig::get_instance()->GateServer_body_timeout_ms);
+        http_body_received = 0;
+        receive_body();
       });
 }
 
-void HTTPConnection::activate_receiver() {
+void HTTPConnection::receive_body() {
+  if (http_parser->is_done()) {
+    arm_deadline(Phase::HANDLER);
+    process_request();
+    return;
+  }
+
   /*extended HTTPConnection class life time*/
   std::shared_ptr<HTTPConnection> extended_lifetime = shared_from_this();
 
-  boost::beast::http::async_read(
-      http_socket, http_buffer, http_request,
+  arm_deadline(Phase::BODY);
+  boost::beast::http::async_read_some(
+      http_socket, http_buffer, *http_parser,
       [this, extended_lifetime](boost::system::error_code ec,
                                 std::size_t bytes_transferred) {
-        boost::ignore_unused(bytes_transferred);
-        if (!ec) { /*no error occured!*/
-          process_request();
+        if (ec) {
+          handle_read_error(ec);
+          return;
+        }
+
+        http_body_received += bytes_transferred;
+        if (is_too_slow()) {
+          return_error(boost::beast::http::status::request_timeout);
+          return;
         }
+        receive_body();
       });
 }
 
+bool HTTPConnection::is_too_slow() const {
+  auto config = ServerConfig::get_instance();
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::steady_clock::now() - http_body_start)
+                     .count();
+
+  /*do not judge throughput during grace period*/
+  if (elapsed <=
+      static_cast<long long>(config->GateServer_body_rate_grace_ms)) {
+    return false;
+  }
+  return http_body_received * 1000 /
+             static_cast<std::size_t>(elapsed) <
+         config->GateServer_min_body_rate;
+}
+
+void HTTPConnection::handle_read_error(boost::system::error_code ec) {
+  if (ec == boost::beast::http::error::header_limit) {
+    return_error(
+        boost::beast::http::status::request_header_fields_too_large);
+  } else if (ec == boost::beast::http::error::body_limit) {
+    return_error(boost::beast::http::status::payload_too_large);
+  } else if (http_timed_out) {
+    return_error(boost::beast::http::status::request_timeout);
+  } else {
+    /*client is gone or request is malformed*/
+    http_wheel.cancel(http_deadline);
+  }
+}
+
+void HTTPConnection::return_error(boost::beast::http::status status) {
+  http_response.result(status);
+  http_response.version(11);
+  http_response.keep_alive(false);
+  http_response.set(boost::beast::http::field::server, "Beast GateServer");
+  http_response.set(boost::beast::http::field::content_type, "text/plain");
+  boost::beast::ostream(http_response.body())
+      << static_cast<unsigned>(status) << ' '
+      << boost::beast::http::obsolete_reason(status);
+
+  /*do not read anything else, close connection after writing*/
+  write_response();
+}
+
 void HTTPConnection::process_request() {
+  /*
+   * handlers run synchronously inside this span, so every redis/mysql/grpc
+   * span created by them becomes its child. deferred handlers resume it on
+   * the io thread which continues them. query string is not recorded.
+   */
+  std::string_view target = request().target();
+  http_span.emplace(trace::root, "http.request",
+                    target.substr(0, target.find('?')),
+                    request()["traceparent"], http_request_start);
+
   /*short connection*/
   http_response.keep_alive(false);
-  http_response.version(http_request.version());
+  http_response.version(request().version());
 
   /*extended HTTPConnection class life time*/
   std::shared_ptr<HTTPConnection> extended_lifetime = shared_from_this();
 
   /*HTTP GET method*/
-  switch (http_request.method()) {
+  switch (request().method()) {
   case boost::beast::http::verb::get:
     handle_get_request(extended_lifetime);
     break;
@@ -62,7 +260,27 @@ void HTTPConnection::process_request() {
     return_not_found();
     break;
   }
+
+  /*HandleMethod writes the response once the handler finishes*/
+  if (http_deferred) {
+    if (http_span.has_value()) {
+      http_span->suspend();
+    }
+    return;
+  }
+
   write_response();
+  end_span();
+}
+
+void HTTPConnection::end_span() {
+  if (!http_span.has_value()) {
+    return;
+  }
+  if (http_response.result_int() >= 500) {
+    http_span->setError();
+  }
+  http_span.reset();
 }
 
 void HTTPConnection::write_response() {
@@ -72,6 +290,7 @@ void HTTPConnection::write_response() {
   /*extended HTTPConnection class life time*/
   std::shared_ptr<HTTPConnection> extended_lifetime = shared_from_this();
 
+  arm_deadline(Phase::WRITE);
   boost::beast::http::async_write(
       http_socket, http_response,
       [this, extended_lifetime](boost::beast::error_code ec,
@@ -79,8 +298,16 @@ void HTTPConnection::write_response() {
         extended_lifetime->http_socket.shutdown(
             boost::asio::ip::tcp::socket::shutdown_send, ec);
 
-        /*because http has already been sent, so cancel timer*/
-        extended_lifetime->http_timer.cancel();
+        /*because http has already been sent, so cancel deadline*/
+        http_wheel.cancel(http_deadline);
+
+        static metrics::Histogram &latency =
+            metrics::MetricsRegistry::get_instance()->histogram(
+                "gateway_http_request_duration_seconds",
+                "Time from connection accepted to response written");
+        latency.observe(std::chrono::steady_clock::now() - http_request_start);
+        metrics::httpResponses(static_cast<unsigned>(http_response.result()))
+            .inc();
       });
 }
 
@@ -88,38 +315,38 @@ void HTTPConnection::handle_get_request(
     std::shared_ptr<HTTPConnection> extended_lifetime) {
   /*store url info /path?username=me&password=passwd*/
  // Store URL info
-          this->http_url_info = http_request.target();
+          this->http_url_info = request().target();
 
           // Parse the URL
           boost::urls::url_view url_view(this->http_url_info);
           std::string_view url_path = url_view.encoded_path();
           std::string_view url_param = url_view.query();
 
-  spdlog::info("url_path = {0}, url_param = {1}", url_path, url_param);
+  logger::http()->debug("url_path = {0}, url_param = {1}", url_path,
+                        url_param);
 
   // Use Boost.URL to parse the query parameters
   for (const auto& param : url_view.params()) {
             this->http_params.emplace(param.key, param.value);
   }
 
-  /*fix bug: because url_path is a std::string_view so when using .data method
-   * it will return all the data inside http_url_info*/
-  if (!HandleMethod::get_instance()->handleGetMethod(std::string(url_path),
+  /*url_path only views the path part, callbacks are searched by string_view*/
+  if (!HandleMethod::get_instance()->handleGetMethod(url_path,
                                                      extended_lifetime)) {
     return_not_found();
   } else {
-    http_response.result(boost::beast::http::status::ok);
+    /*result is ok since recycle(), unless handler rejects with 503*/
     http_response.set(boost::beast::http::field::server, "Beast GateServer");
   }
 }
 
 void HTTPConnection::handle_post_request(
     std::shared_ptr<HTTPConnection> extended_lifetime) {
-  if (!HandleMethod::get_instance()->handlePostMethod(http_request.target(),
+  if (!HandleMethod::get_instance()->handlePostMethod(request().target(),
                                                       extended_lifetime)) {
     return_not_found();
   } else {
-    http_response.result(boost::beast::http::status::ok);
+    /*result is ok since recycle(), unless handler rejects with 503*/
     http_response.set(boost::beast::http::field::server, "Beast GateServer");
   }
 }
@@ -1,3 +1,4 @@
+#include <config/ServerConfig.hpp>
 #include <service/IOServicePool.hpp>
 
 IOServicePool::IOServicePool()
@@ -8,10 +9,19 @@ IOServicePool::IOServicePool()
 IOServicePool::IOServicePool(std::size_t threads)
     : m_curr(0), m_ioc_pool(threads), m_thread_pool(threads),
       m_work_pool(threads) {
+  m_wheels.reserve(threads);
   for (std::size_t i = 0; i < threads; ++i) {
     /*create ioc_context guarantee io_context won't quite automatically!*/
     m_work_pool.at(i) = std::make_unique<work>(m_ioc_pool.at(i));
 
+    /*start ticking before io thread is running*/
+    m_wheels.push_back(std::make_unique<connection::TimingWheel>(
+        m_ioc_pool.at(i),
+        std::chrono::milliseconds(
+            ServerConfig::get_instance()->GateServer_timer_tick_ms),
+        ServerConfig::get_instance()->GateServer_timer_slots));
+    m_wheels.back()->start();
+
     /*create thread*/
     m_thread_pool.emplace_back([this, i]() { m_ioc_pool.at(i).run(); });
   }
@@ -39,9 +49,26 @@ void IOServicePool::shutdown() {
 }
 
 boost::asio::io_context &IOServicePool::getIOServiceContext() {
-  boost::asio::io_context &result = m_ioc_pool.at(m_curr.fetch_add(1));
-  if (m_curr.load() == this->m_ioc_pool.size()) {
-    m_curr.store(0);
+  /*fetch_add and modulo, prevent multiple threads from overflowing m_curr*/
+  return m_ioc_pool.at(m_curr.fetch_add(1) % m_ioc_pool.size());
+}
+
+connection::TimingWheel &
+IOServicePool::getTimingWheel(const boost::asio::io_context &ioc) {
+  return *m_wheels.at(getIOServiceIndex(ioc));
+}
+
+std::size_t IOServicePool::size() const { return m_ioc_pool.size(); }
+
+std::size_t
+IOServicePool::getIOServiceIndex(const boost::asio::io_context &ioc) const {
+  /*compare addresses, arithmetic on a foreign io_context's address is UB*/
+  for (std::size_t i = 0; i < m_ioc_pool.size(); ++i) {
+    if (&m_ioc_pool[i] == &ioc) {
+      return i;
+    }
   }
-  return result;
+
+  /*not ours, .at() of per io_context states throws on it*/
+  return m_ioc_pool.size();
 }
@@ -0,0 +1,217 @@
+#include <cstring>
+#include <server/ListenerHandoff.hpp>
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+/*whoever can reach the path must not trade listeners with us*/
+bool trustedPeer(int fd) {
+  ucred cred{};
+  socklen_t length = sizeof(cred);
+  if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &length) != 0) {
+    return false;
+  }
+  return cred.uid == ::geteuid();
+}
+
+/*only a listening tcp socket is accepted as our listener*/
+bool listeningStream(int fd) {
+  int type = 0, listening = 0;
+  socklen_t length = sizeof(type);
+  if (::getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &length) != 0 ||
+      type != SOCK_STREAM) {
+    return false;
+  }
+  length = sizeof(listening);
+  return ::getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &length) ==
+             0 &&
+         listening != 0;
+}
+} // namespace
+
+ListenerHandoff::ListenerHandoff(boost::asio::io_context &_ioc,
+                                 const std::string &path)
+    : m_path(path), m_acceptor(_ioc) {}
+
+ListenerHandoff::~ListenerHandoff() {
+  if (m_previous != -1) {
+    ::close(m_previous);
+  }
+}
+
+std::optional<ListenerHandoff::native_handle_type> ListenerHandoff::receive() {
+  sockaddr_un addr{};
+  if (m_path.empty() || m_path.size() >= sizeof(addr.sun_path)) {
+    return std::nullopt;
+  }
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, m_path.data(), m_path.size());
+
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1) {
+    return std::nullopt;
+  }
+
+  /*no file or nobody listening, this is the first process*/
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    ::close(fd);
+    return std::nullopt;
+  }
+
+  if (!trustedPeer(fd)) {
+    spdlog::warn("Listener handoff from {} refused, it is served by another "
+                 "user",
+                 m_path);
+    ::close(fd);
+    return std::nullopt;
+  }
+
+  /*previous process might be stuck, don't wait for it forever*/
+  timeval timeout{5, 0};
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  char byte = 0;
+  iovec iov{&byte, 1};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  cmsghdr *cmsg = nullptr;
+  if (::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC) != 1 ||
+      (cmsg = CMSG_FIRSTHDR(&msg)) == nullptr ||
+      cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+      cmsg->cmsg_len != CMSG_LEN(sizeof(int))) {
+    spdlog::warn("Listener handoff from {} failed, bind a new listener",
+                 m_path);
+    ::close(fd);
+    return std::nullopt;
+  }
+
+  native_handle_type listener;
+  std::memcpy(&listener, CMSG_DATA(cmsg), sizeof(listener));
+  if (!listeningStream(listener)) {
+    spdlog::warn("Listener handoff from {} sent no listening socket, bind a "
+                 "new listener",
+                 m_path);
+    ::close(listener);
+    ::close(fd);
+    return std::nullopt;
+  }
+  m_previous = fd;
+  spdlog::info("Listener handoff from {} received", m_path);
+  return listener;
+}
+
+void ListenerHandoff::acknowledge() {
+  if (m_previous == -1) {
+    return;
+  }
+
+  const char byte = 1;
+  if (::write(m_previous, &byte, 1) != 1) {
+    spdlog::warn("Listener handoff acknowledge failed: {}",
+                 std::strerror(errno));
+  }
+  ::close(m_previous);
+  m_previous = -1;
+}
+
+void ListenerHandoff::serve(native_handle_type listener,
+                            callback on_handoff) {
+  if (m_path.empty()) {
+    return;
+  }
+  m_listener = listener;
+  m_on_handoff = std::move(on_handoff);
+
+  /*
+   * the path might belong to the process we replaced, unlinking doesn't
+   * affect its socket which is closed once it drains
+   */
+  ::unlink(m_path.c_str());
+
+  boost::system::error_code ec;
+  boost::asio::local::stream_protocol::endpoint endpoint(m_path);
+  m_acceptor.open(endpoint.protocol(), ec);
+  if (!ec) {
+    m_acceptor.bind(endpoint, ec);
+  }
+
+  /*peers are checked as well, this only keeps other users from connecting*/
+  if (!ec && ::chmod(m_path.c_str(), S_IRUSR | S_IWUSR) != 0) {
+    ec.assign(errno, boost::system::system_category());
+  }
+  if (!ec) {
+    m_acceptor.listen(boost::asio::socket_base::max_listen_connections, ec);
+  }
+  if (ec) {
+    spdlog::warn("Listener handoff can not serve {}: {}", m_path,
+                 ec.message());
+    return;
+  }
+  accept();
+}
+
+void ListenerHandoff::close() {
+  boost::system::error_code ec;
+  m_acceptor.close(ec);
+}
+
+void ListenerHandoff::accept() {
+  auto peer = std::make_shared<boost::asio::local::stream_protocol::socket>(
+      m_acceptor.get_executor());
+  m_acceptor.async_accept(*peer, [this, peer](boost::system::error_code ec) {
+    if (ec) {
+      return;
+    }
+    transfer(peer);
+    accept();
+  });
+}
+
+void ListenerHandoff::transfer(
+    std::shared_ptr<boost::asio::local::stream_protocol::socket> peer) {
+  if (!trustedPeer(peer->native_handle())) {
+    spdlog::warn("Listener handoff refused a process of another user");
+    return;
+  }
+
+  char byte = 0;
+  iovec iov{&byte, 1};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  std::memcpy(CMSG_DATA(cmsg), &m_listener, sizeof(m_listener));
+
+  if (::sendmsg(peer->native_handle(), &msg, MSG_NOSIGNAL) != 1) {
+    spdlog::warn("Listener handoff send failed: {}", std::strerror(errno));
+    return;
+  }
+
+  /*keep accepting until the new process is ready, it may still crash*/
+  auto ack = std::make_shared<char>(0);
+  boost::asio::async_read(
+      *peer, boost::asio::buffer(ack.get(), 1),
+      [this, peer, ack](boost::system::error_code ec, std::size_t) {
+        if (ec) {
+          spdlog::warn("New process exited before taking over the listener");
+          return;
+        }
+        spdlog::info("Listener handed over, start draining");
+        m_on_handoff();
+      });
+}
@@ -0,0 +1,113 @@
+#include <chrono>
+#include <config/ServerConfig.hpp>
+#include <log/LogManager.hpp>
+#include <spdlog/async.h>
+#include <spdlog/sinks/basic_file_sink.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+logger::LogManager::LogManager()
+    : m_sample_rate(ServerConfig::get_instance()->Log_request_sample_rate),
+      m_rate_limit(ServerConfig::get_instance()->Log_request_rate_limit),
+      m_requests(0), m_window(0), m_window_logs(0) {
+  auto config = ServerConfig::get_instance();
+
+  /*one background thread consumes the bounded queue*/
+  spdlog::init_thread_pool(config->Log_queue_size, 1);
+
+  std::vector<spdlog::sink_ptr> sinks{
+      std::make_shared<spdlog::sinks::stdout_color_sink_mt>()};
+  if (!config->Log_file.empty()) {
+    sinks.push_back(std::make_shared<spdlog::sinks::basic_file_sink_mt>(
+        config->Log_file));
+  }
+
+  /*never block io threads unless it's configured explicitly*/
+  auto policy = config->Log_overflow == "block"
+                    ? spdlog::async_overflow_policy::block
+                    : spdlog::async_overflow_policy::overrun_oldest;
+
+  const std::pair<Subsystem, const std::string *> settings[] = {
+      {Subsystem::GATEWAY, &config->Log_level},
+      {Subsystem::HTTP, &config->Log_http_level},
+      {Subsystem::REDIS, &config->Log_redis_level},
+      {Subsystem::MYSQL, &config->Log_mysql_level},
+      {Subsystem::GRPC, &config->Log_grpc_level}};
+  const char *names[] = {"gateway", "http", "redis", "mysql", "grpc"};
+
+  for (const auto &[subsystem, level] : settings) {
+    auto index = static_cast<std::size_t>(subsystem);
+    auto logger = std::make_shared<spdlog::async_logger>(
+        names[index], sinks.begin(), sinks.end(), spdlog::thread_pool(),
+        policy);
+    logger->set_level(spdlog::level::from_str(*level));
+    logger->flush_on(spdlog::level::err);
+    spdlog::register_logger(logger);
+    m_loggers[index] = logger;
+  }
+
+  /*existing spdlog::info() calls go through the async queue as well*/
+  spdlog::set_default_logger(m_loggers[static_cast<std::size_t>(
+      Subsystem::GATEWAY)]);
+}
+
+logger::LogManager::~LogManager() {}
+
+std::shared_ptr<spdlog::logger> &logger::LogManager::get(Subsystem subsystem) {
+  return m_loggers[static_cast<std::size_t>(subsystem)];
+}
+
+bool logger::LogManager::sampleRequest() {
+  if (m_sample_rate == 0 ||
+      m_requests.fetch_add(1, std::memory_order_relaxed) % m_sample_rate) {
+    return false;
+  }
+
+  /*fixed one second window*/
+  long long now = std::chrono::duration_cast<std::chrono::seconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count();
+  long long window = m_window.load(std::memory_order_relaxed);
+  if (window != now &&
+      m_window.compare_exchange_strong(window, now,
+                                       std::memory_order_relaxed)) {
+    m_window_logs.store(0, std::memory_order_relaxed);
+  }
+  return m_window_logs.fetch_add(1, std::memory_order_relaxed) < m_rate_limit;
+}
+
+void logger::LogManager::shutdown() {
+  for (auto &logger : m_loggers) {
+    if (logger) {
+      logger->flush();
+    }
+  }
+}
+
+std::string logger::LogManager::redact(std::string_view body) {
+  static constexpr std::string_view sensitive[] = {"\"password\"",
+                                                   "\"cpatcha\"", "\"token\""};
+  std::string result(body);
+
+  for (auto key : sensitive) {
+    std::size_t pos = 0;
+    while ((pos = result.find(key, pos)) != std::string::npos) {
+      pos += key.size();
+
+      /*skip ':' and whitespaces, only string values are redacted*/
+      std::size_t begin = result.find_first_not_of(" \t\r\n:", pos);
+      if (begin == std::string::npos || result[begin] != '"') {
+        continue;
+      }
+      std::size_t end = begin + 1;
+      while (end < result.size() && result[end] != '"') {
+        end += (result[end] == '\\') ? 2 : 1;
+      }
+      if (end >= result.size()) {
+        break;
+      }
+      result.replace(begin + 1, end - begin - 1, "***");
+      pos = begin + 5;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <cmath>
+#include <metrics/MetricsRegistry.hpp>
+#include <sstream>
+
+std::size_t metrics::currentShard() {
+  static std::atomic<std::size_t> next{0};
+  thread_local const std::size_t shard =
+      next.fetch_add(1, std::memory_order_relaxed) % shard_count;
+  return shard;
+}
+
+std::size_t metrics::Counter::value() const {
+  std::size_t total = 0;
+  for (const auto &slot : m_slots) {
+    total += slot.value.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+std::size_t metrics::Histogram::bucketIndex(std::size_t us) {
+  if (us < sub_buckets) {
+    return us;
+  }
+
+  /*position of the highest bit decides the power of two*/
+  std::size_t msb = 63 - static_cast<std::size_t>(__builtin_clzll(us));
+  std::size_t shift = msb - sub_bucket_bits;
+  std::size_t index = (shift + 1) * sub_buckets +
+                      ((us >> shift) & (sub_buckets - 1));
+  return std::min(index, bucket_count - 1);
+}
+
+std::size_t metrics::Histogram::bucketUpperBound(std::size_t index) {
+  if (index < sub_buckets) {
+    return index;
+  }
+  std::size_t shift = index / sub_buckets - 1;
+  std::size_t sub = index % sub_buckets;
+  return ((sub_buckets + sub + 1) << shift) - 1;
+}
+
+void metrics::Histogram::observe(std::chrono::nanoseconds duration) {
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(duration);
+  observeMicroseconds(us.count() < 0 ? 0 : static_cast<std::size_t>(us.count()));
+}
+
+void metrics::Histogram::observeMicroseconds(std::size_t us) {
+  auto &shard = m_shards[currentShard()];
+  shard.buckets[bucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+  shard.count.fetch_add(1, std::memory_order_relaxed);
+  shard.sum.fetch_add(us, std::memory_order_relaxed);
+}
+
+metrics::Histogram::Snapshot metrics::Histogram::snapshot() const {
+  Snapshot snap;
+  for (const auto &shard : m_shards) {
+    for (std::size_t i = 0; i < bucket_count; ++i) {
+      snap.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+    }
+    snap.count += shard.count.load(std::memory_order_relaxed);
+    snap.sum += shard.sum.load(std::memory_order_relaxed);
+  }
+  return snap;
+}
+
+std::size_t metrics::Histogram::Snapshot::percentile(double q) const {
+  std::size_t total = 0;
+  for (auto bucket : buckets) {
+    total += bucket;
+  }
+  if (total == 0) {
+    return 0;
+  }
+
+  auto rank = static_cast<std::size_t>(
+      std::ceil(std::clamp(q, 0.0, 1.0) * static_cast<double>(total)));
+  rank = std::max<std::size_t>(rank, 1);
+
+  std::size_t seen = 0;
+  for (std::size_t i = 0; i < bucket_count; ++i) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      return bucketUpperBound(i);
+    }
+  }
+  return bucketUpperBound(bucket_count - 1);
+}
+
+metrics::MetricsRegistry::Metric *
+metrics::MetricsRegistry::find(std::string_view name,
+                               std::string_view labels) {
+  for (auto &metric : m_metrics) {
+    if (metric->name == name && metric->labels == labels) {
+      return metric.get();
+    }
+  }
+  return nullptr;
+}
+
+metrics::Counter &metrics::MetricsRegistry::counter(std::string_view name,
+                                                    std::string_view help,
+                                                    std::string_view labels) {
+  std::lock_guard<std::mutex> _lckg(m_mtx);
+  if (auto *exist = find(name, labels); exist != nullptr) {
+    return *exist->counter;
+  }
+
+  auto metric = std::make_unique<Metric>();
+  metric->name = name;
+  metric->help = help;
+  metric->labels = labels;
+  metric->type = Type::COUNTER;
+  metric->counter = std::make_unique<Counter>();
+
+  Counter &ret = *metric->counter;
+  m_metrics.push_back(std::move(metric));
+  return ret;
+}
+
+metrics::Histogram &
+metrics::MetricsRegistry::histogram(std::string_view name,
+                                    std::string_view help,
+                                    std::string_view labels) {
+  std::lock_guard<std::mutex> _lckg(m_mtx);
+  if (auto *exist = find(name, labels); exist != nullptr) {
+    return *exist->histogram;
+  }
+
+  auto metric = std::make_unique<Metric>();
+  metric->name = name;
+  metric->help = help;
+  metric->labels = labels;
+  metric->type = Type::HISTOGRAM;
+  metric->histogram = std::make_unique<Histogram>();
+
+  Histogram &ret = *metric->histogram;
+  m_metrics.push_back(std::move(metric));
+  return ret;
+}
+
+void metrics::MetricsRegistry::gauge(std::string_view name,
+                                     std::string_view help,
+                                     std::string_view labels,
+                                     std::function<double()> sampler) {
+  std::lock_guard<std::mutex> _lckg(m_mtx);
+  if (auto *exist = find(name, labels); exist != nullptr) {
+    exist->sampler = std::move(sampler);
+    return;
+  }
+
+  auto metric = std::make_unique<Metric>();
+  metric->name = name;
+  metric->help = help;
+  metric->labels = labels;
+  metric->type = Type::GAUGE;
+  metric->sampler = std::move(sampler);
+  m_metrics.push_back(std::move(metric));
+}
+
+std::string metrics::MetricsRegistry::serialize() {
+  /*exported bucket boundaries in seconds, fine buckets are folded into them*/
+  static constexpr std::array<double, 16> boundaries = {
+      0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+      0.05,   0.1,     0.25,   0.5,   1.0,    2.5,   5.0,  10.0};
+
+  auto with_labels = [](const std::string &labels, std::string_view extra) {
+    std::string ret;
+    if (labels.empty() && extra.empty()) {
+      return ret;
+    }
+    ret += '{';
+    ret += labels;
+    if (!labels.empty() && !extra.empty()) {
+      ret += ',';
+    }
+    ret += extra;
+    ret += '}';
+    return ret;
+  };
+
+  std::ostringstream os;
+  std::lock_guard<std::mutex> _lckg(m_mtx);
+
+  /*HELP and TYPE are written once for metrics sharing the same name*/
+  std::vector<const Metric *> sorted;
+  sorted.reserve(m_metrics.size());
+  for (auto &metric : m_metrics) {
+    sorted.push_back(metric.get());
+  }
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const Metric *a, const Metric *b) {
+                     return a->name < b->name;
+                   });
+
+  const std::string *last_name = nullptr;
+  for (const auto *metric : sorted) {
+    if (last_name == nullptr || *last_name != metric->name) {
+      const char *type = metric->type == Type::COUNTER     ? "counter"
+                         : metric->type == Type::HISTOGRAM ? "histogram"
+                                                           : "gauge";
+      os << "# HELP " << metric->name << ' ' << metric->help << '\n';
+      os << "# TYPE " << metric->name << ' ' << type << '\n';
+      last_name = &metric->name;
+    }
+
+    switch (metric->type) {
+    case Type::COUNTER:
+      os << metric->name << with_labels(metric->labels, {}) << ' '
+         << metric->counter->value() << '\n';
+      break;
+    case Type::GAUGE:
+      os << metric->name << with_labels(metric->labels, {}) << ' '
+         << metric->sampler() << '\n';
+      break;
+    case Type::HISTOGRAM: {
+      auto snap = metric->histogram->snapshot();
+      std::size_t cumulative = 0;
+      std::size_t index = 0;
+      for (double le : boundaries) {
+        auto limit = static_cast<std::size_t>(le * 1e6);
+        for (; index < Histogram::bucket_count &&
+               Histogram::bucketUpperBound(index) <= limit;
+             ++index) {
+          cumulative += snap.buckets[index];
+        }
+        std::ostringstream bound;
+        bound << "le=\"" << le << '"';
+        os << metric->name << "_bucket"
+           << with_labels(metric->labels, bound.str()) << ' ' << cumulative
+           << '\n';
+      }
+      os << metric->name << "_bucket"
+         << with_labels(metric->labels, "le=\"+Inf\"") << ' ' << snap.count
+         << '\n';
+      os << metric->name << "_sum" << with_labels(metric->labels, {}) << ' '
+         << static_cast<double>(snap.sum) / 1e6 << '\n';
+      os << metric->name << "_count" << with_labels(metric->labels, {}) << ' '
+         << snap.count << '\n';
+      break;
+    }
+    }
+  }
+  return os.str();
+}
+
+metrics::Counter &metrics::httpResponses(unsigned status) {
+  static constexpr std::size_t max_status = 600;
+  static std::array<std::atomic<Counter *>, max_status> counters{};
+
+  if (status >= max_status) {
+    status = 0;
+  }
+
+  /*slow path only runs once for every status code*/
+  Counter *counter = counters[status].load(std::memory_order_acquire);
+  if (counter == nullptr) {
+    std::string labels = "code=\"" + std::to_string(status) + '"';
+    counter = &MetricsRegistry::get_instance()->counter(
+        "gateway_http_responses_total", "HTTP responses by status code",
+        labels);
+    counters[status].store(counter, std::memory_order_release);
+  }
+  return *counter;
+}
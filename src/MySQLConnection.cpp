@@ -1,12 +1,20 @@
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/mysql/diagnostics.hpp>
+#include <boost/mysql/error_categories.hpp>
+#include <boost/mysql/execution_state.hpp>
 #include <boost/mysql/handshake_params.hpp>
 #include <boost/mysql/results.hpp>
 #include <boost/mysql/row_view.hpp>
 #include <boost/mysql/statement.hpp>
+#include <log/LogManager.hpp>
 #include <service/IOServicePool.hpp>
+#include <set>
 #include <spdlog/fmt/fmt.h>
 #include <spdlog/spdlog.h>
+#include <sql/AccountFilter.hpp>
 #include <sql/MySQLConnectionPool.hpp>
+#include <trace/Tracer.hpp>
+#include <unordered_map>
 
 mysql::MySQLConnection::MySQLConnection(
     std::string_view username, std::string_view password,
@@ -20,7 +28,9 @@ mysql::MySQLConnection::MySQLConnection(
           std::chrono::steady_clock::now()) /*get operation time*/
       ,
       m_delegator(std::shared_ptr<mysql::MySQLConnectionPool>(
-          shared, [](mysql::MySQLConnectionPool *) {})) {
+          shared, [](mysql::MySQLConnectionPool *) {})),
+      m_ping_armed(std::make_shared<std::atomic<bool>>(false)),
+      m_ping_timer(ctx) {
   try {
     // Resolve the hostname to get a collection of endpoints
     boost::asio::ip::tcp::resolver resolver(ctx.get_executor());
@@ -28,41 +38,64 @@ mysql::MySQLConnection::MySQLConnection(
 
     conn.connect(*endpoints.begin(),
                  boost::mysql::handshake_params(username, password, database));
+    m_valid = true;
+    updateTimer();
   } catch (const boost::mysql::error_with_diagnostics &err) {
     // Some errors include additional diagnostics, like server-provided error
     // messages. Security note: diagnostics::server_message may contain
     // user-supplied values (e.g. the field value that caused the error) and is
     // encoded using to the connection's character set (UTF-8 by default). Treat
     // is as untrusted input.
-    spdlog::critical("MySQL Connect Error: {0}\n Server diagnostics: {1}",
-                  err.what(), err.get_diagnostics().server_message().data());
+    logger::mysql()->critical(
+        "MySQL Connect Error: {0}\n Server diagnostics: {1}",
+        err.what(), err.get_diagnostics().server_message().data());
+  } catch (const boost::system::system_error &err) {
+    /*resolving failed*/
+    logger::mysql()->critical("MySQL Connect Error: {}", err.what());
+  }
+}
 
-    std::abort();
+mysql::MySQLConnection::~MySQLConnection() {
+  if (m_valid) {
+    boost::system::error_code ec;
+    boost::mysql::diagnostics diag;
+    conn.close(ec, diag);
   }
 }
 
-mysql::MySQLConnection::~MySQLConnection() { conn.close(); }
+bool mysql::MySQLConnection::isValid() const { return m_valid; }
+
+void mysql::MySQLConnection::checkBroken(
+    const boost::mysql::error_with_diagnostics &err) {
+  const auto &category = err.code().category();
+  if (category != boost::mysql::get_common_server_category() &&
+      category != boost::mysql::get_mysql_server_category() &&
+      category != boost::mysql::get_mariadb_server_category()) {
+    m_valid = false;
+  }
+}
 
 template <typename... Args>
 std::optional<boost::mysql::results>
-mysql::MySQLConnection::executeCommand(MySQLSelection select, Args &&...args) {
+mysql::MySQLConnection::queryCommand(MySQLSelection select, Args &&...args) {
+  trace::Span span("mysql.query", selectionName(select),
+                   trace::SpanKind::CLIENT);
   try {
     boost::mysql::results result;
-    std::string key = m_delegator.get()->m_sql[select];
-    spdlog::info("Executing MySQL Query: {}", key);
+    const std::string &key = m_delegator.get()->m_sql.at(select);
+    metrics::ScopedTimer timer(*m_delegator.get()->m_latency.at(select));
+    logger::mysql()->debug("Executing MySQL Query: {}", key);
+    const auto start = std::chrono::steady_clock::now();
     boost::mysql::statement stmt = conn.prepare_statement(key);
     conn.execute(stmt.bind(std::forward<Args>(args)...), result);
-
-    /*is there any results find?
-     * prevent segementation fault
-     */
-    if (result.rows().begin() == result.rows().end()) {
-      return std::nullopt;
-    }
+    m_delegator->observeLatency(std::chrono::steady_clock::now() - start);
+    updateTimer();
     return result;
 
   } catch (const boost::mysql::error_with_diagnostics &err) {
-    spdlog::error(
+    span.setError();
+    checkBroken(err);
+    logger::mysql()->error(
         "{0}:{1} Operation failed with error code: {2} Server diagnostics: {3}",
         __FILE__, __LINE__, std::to_string(err.code().value()),
         err.get_diagnostics().server_message().data());
@@ -70,28 +103,48 @@ mysql::MySQLConnection::executeCommand(MySQLSelection select, Args &&...args) {
   }
 }
 
-std::optional<std::size_t>
-mysql::MySQLConnection::checkAccountLogin(std::string_view username,
-                                          std::string_view password) {
-  auto res =
-      executeCommand(MySQLSelection::USER_LOGIN_CHECK, username, password);
+template <typename... Args>
+std::optional<boost::mysql::results>
+mysql::MySQLConnection::executeCommand(MySQLSelection select, Args &&...args) {
+  auto result = queryCommand(select, std::forward<Args>(args)...);
+
+  /*is there any results find?
+   * prevent segementation fault
+   */
+  if (!result.has_value() || result->rows().empty()) {
+    return std::nullopt;
+  }
+  return result;
+}
+
+std::optional<std::string>
+mysql::MySQLConnection::getPasswordHash(std::string_view username) {
+  auto res = executeCommand(MySQLSelection::USER_LOGIN_CHECK, username);
   if (!res.has_value()) {
     return std::nullopt;
   }
-  boost::mysql::results result = res.value();
-  return result.rows().size();
+  return std::string(res->rows().at(0).at(0).as_string());
 }
 
 bool mysql::MySQLConnection::checkAccountAvailability(std::string_view username,
                                                       std::string_view email) {
-  auto res =
-      executeCommand(MySQLSelection::FIND_EXISTING_USER, username, email);
+  /*definitely no such account, MySQL is not asked*/
+  auto filter = AccountFilter::get_instance();
+  if (!filter->mayContain(username, email)) {
+    return false;
+  }
+
+  auto res = queryCommand(MySQLSelection::FIND_EXISTING_USER, username, email);
   if (!res.has_value()) {
     return false;
   }
 
-  boost::mysql::results result = res.value();
-  return result.rows().size();
+  /*only an answered query proves the filter wrong*/
+  if (res->rows().empty()) {
+    filter->falsePositive();
+    return false;
+  }
+  return true;
 }
 
 bool mysql::MySQLConnection::registerNewUser(MySQLRequestStruct &&request) {
@@ -100,11 +153,174 @@ bool mysql::MySQLConnection::registerNewUser(MySQLRequestStruct &&request) {
     [[maybe_unused]] auto res =
         executeCommand(MySQLSelection::CREATE_NEW_USER, request.m_username,
                        request.m_password, request.m_email);
+    AccountFilter::get_instance()->insert(request.m_username,
+                                          request.m_email);
+    m_delegator->markWritten(request.m_username);
     return true;
   }
   return false;
 }
 
+std::vector<std::optional<std::size_t>>
+mysql::MySQLConnection::registerNewUsers(
+    const std::vector<MySQLRequestStruct> &requests) {
+  std::vector<std::optional<std::size_t>> uuids(requests.size());
+  if (requests.empty()) {
+    return uuids;
+  }
+
+  trace::Span span("mysql.query",
+                   selectionName(MySQLSelection::CREATE_NEW_USER),
+                   trace::SpanKind::CLIENT);
+
+  /*statement text differs by batch size, don't keep them on the server*/
+  auto execute = [this](const std::string &sql,
+                        const std::vector<boost::mysql::field_view> &fields,
+                        boost::mysql::results &result) {
+    logger::mysql()->debug("Executing MySQL Query: {}", sql);
+    boost::mysql::statement stmt = conn.prepare_statement(sql);
+    conn.execute(stmt.bind(fields.begin(), fields.end()), result);
+    conn.close_statement(stmt);
+  };
+
+  auto placeholders = [](std::size_t count, std::string_view each) {
+    std::string ret;
+    for (std::size_t i = 0; i < count; ++i) {
+      ret.append(i == 0 ? "" : ", ").append(each);
+    }
+    return ret;
+  };
+
+  auto failed = [this, &span](const boost::mysql::error_with_diagnostics &err) {
+    span.setError();
+    checkBroken(err);
+    logger::mysql()->error(
+        "{0}:{1} Operation failed with error code: {2} Server diagnostics: {3}",
+        __FILE__, __LINE__, std::to_string(err.code().value()),
+        err.get_diagnostics().server_message().data());
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+  boost::mysql::results result;
+
+  /*
+   * one availability check for the whole batch. like FIND_EXISTING_USER in
+   * checkAccountAvailability, an account is taken when both username and
+   * email match, other clashes are left to the UNIQUE indexes
+   */
+  std::vector<boost::mysql::field_view> keys;
+  for (const auto &request : requests) {
+    keys.emplace_back(request.m_username);
+    keys.emplace_back(request.m_email);
+  }
+  try {
+    execute("SELECT username, email FROM Authentication WHERE (username, "
+            "email) IN (" +
+                placeholders(requests.size(), "(?, ?)") + ")",
+            keys, result);
+  } catch (const boost::mysql::error_with_diagnostics &err) {
+    failed(err);
+    return uuids;
+  }
+
+  std::set<std::pair<std::string, std::string>> taken;
+  for (auto row : result.rows()) {
+    taken.emplace(row.at(0).as_string(), row.at(1).as_string());
+  }
+
+  /*taken accounts and repeats inside this batch fail on their own*/
+  std::vector<std::size_t> free;
+  for (std::size_t i = 0; i < requests.size(); ++i) {
+    if (taken.emplace(requests[i].m_username, requests[i].m_email).second) {
+      free.push_back(i);
+    }
+  }
+  if (free.empty()) {
+    return uuids;
+  }
+
+  auto fields = [&requests](const std::vector<std::size_t> &rows) {
+    std::vector<boost::mysql::field_view> ret;
+    for (std::size_t i : rows) {
+      ret.emplace_back(requests[i].m_username);
+      ret.emplace_back(requests[i].m_password);
+      ret.emplace_back(requests[i].m_email);
+    }
+    return ret;
+  };
+
+  const std::string insert =
+      "INSERT INTO Authentication (username, password, email) VALUES ";
+  try {
+    execute(insert + placeholders(free.size(), "(?, ?, ?)"), fields(free),
+            result);
+  } catch (const boost::mysql::error_with_diagnostics &err) {
+    failed(err);
+    if (!m_valid) {
+      return uuids;
+    }
+
+    /*
+     * a concurrent registration took one of them after the check, or a
+     * value is rejected. insert row by row so only that one fails
+     */
+    std::vector<std::size_t> inserted;
+    for (std::size_t i : free) {
+      try {
+        execute(insert + "(?, ?, ?)", fields({i}), result);
+        inserted.push_back(i);
+      } catch (const boost::mysql::error_with_diagnostics &row_err) {
+        failed(row_err);
+        if (!m_valid) {
+          break;
+        }
+      }
+    }
+    free = std::move(inserted);
+    if (free.empty()) {
+      return uuids;
+    }
+  }
+
+  std::vector<boost::mysql::field_view> names;
+  std::unordered_map<std::string_view, std::size_t> index;
+  for (std::size_t i : free) {
+    names.emplace_back(requests[i].m_username);
+    index.emplace(requests[i].m_username, i);
+  }
+  try {
+    execute("SELECT uuid, username, password FROM Authentication WHERE "
+            "username IN (" +
+                placeholders(free.size(), "?") + ")",
+            names, result);
+  } catch (const boost::mysql::error_with_diagnostics &err) {
+    failed(err);
+    return uuids;
+  }
+  m_delegator->observeLatency(std::chrono::steady_clock::now() - start);
+  updateTimer();
+
+  /*every hash has its own salt, a row storing our hash is our row*/
+  auto filter = AccountFilter::get_instance();
+  for (auto row : result.rows()) {
+    auto it = index.find(row.at(1).as_string());
+    if (it == index.end() ||
+        requests[it->second].m_password != row.at(2).as_string()) {
+      continue;
+    }
+    const std::size_t i = it->second;
+    uuids[i] = row.at(0).as_int64();
+    filter->insert(requests[i].m_username, requests[i].m_email);
+    m_delegator->markWritten(requests[i].m_username);
+
+    /*handler answers with the uuid, nobody has to look it up again*/
+    std::string stored(row.at(1).as_string());
+    m_delegator->m_cache->uuid.put(stored, *uuids[i]);
+    m_delegator->m_cache->username.put(*uuids[i], std::move(stored));
+  }
+  return uuids;
+}
+
 bool mysql::MySQLConnection::alterUserPassword(MySQLRequestStruct &&request) {
   if (!checkAccountAvailability(request.m_username, request.m_email)) {
     return false;
@@ -113,52 +329,165 @@ bool mysql::MySQLConnection::alterUserPassword(MySQLRequestStruct &&request) {
   [[maybe_unused]] auto res =
       executeCommand(MySQLSelection::UPDATE_USER_PASSWD, request.m_password,
                      request.m_username, request.m_email);
+  m_delegator->markWritten(request.m_username);
   return true;
 }
 
-bool mysql::MySQLConnection::checkTimeout(
-    const std::chrono::steady_clock::time_point &curr, std::size_t timeout) {
-  if (std::chrono::duration_cast<std::chrono::seconds>(curr -
-                                                       last_operation_time)
-          .count() > timeout) {
-    return sendHeartBeat();
+bool mysql::MySQLConnection::checkUUID(std::size_t uuid) {
+  if (m_delegator->m_cache->username.get(uuid).has_value()) {
+    return true;
   }
-  return true;
-}
 
-bool mysql::MySQLConnection::checkUUID(std::size_t uuid) {
   auto res = executeCommand(MySQLSelection::USER_UUID_CHECK, uuid);
   if (!res.has_value()) {
     return false;
   }
 
-  boost::mysql::results result = res.value();
-  return result.rows().size();
+  return res->rows().size();
 }
 
 std::optional<std::size_t>
 mysql::MySQLConnection::getUUIDByUsername(std::string_view username) {
+  auto cached = m_delegator->m_cache->uuid.get(username);
+  if (cached.has_value()) {
+    return cached;
+  }
+
   auto res = executeCommand(MySQLSelection::GET_USER_UUID, username);
-  if (!res.has_value()) {
+  if (!res.has_value() || res->rows().empty()) {
     return std::nullopt;
   }
 
-  return (*res.value().rows().begin()).at(0).as_int64();
+  /*
+   * collation may match another spelling, cache the stored one so that
+   * invalidating it by the stored username drops this entry
+   */
+  const std::size_t uuid = res->rows().at(0).at(0).as_int64();
+  std::string stored(res->rows().at(0).at(1).as_string());
+  m_delegator->m_cache->uuid.put(stored, uuid);
+  m_delegator->m_cache->username.put(uuid, std::move(stored));
+  return uuid;
 }
 
 std::optional<std::string>
 mysql::MySQLConnection::getUsernameByUUID(std::size_t uuid) {
+  auto cached = m_delegator->m_cache->username.get(uuid);
+  if (cached.has_value()) {
+    return cached;
+  }
+
   auto res = executeCommand(MySQLSelection::USER_UUID_CHECK, uuid);
   if (!res.has_value()) {
     return std::nullopt;
   }
-  return (*res.value().rows().begin()).at(1).as_string();
+
+  std::string username(res->rows().at(0).at(1).as_string());
+  m_delegator->m_cache->uuid.put(username, uuid);
+  m_delegator->m_cache->username.put(uuid, username);
+  return username;
 }
 
-bool mysql::MySQLConnection::sendHeartBeat() {
-  return executeCommand(MySQLSelection::HEART_BEAT).has_value();
+bool mysql::MySQLConnection::streamAccounts(
+    const std::function<void(std::string_view, std::string_view)>
+        &callback) {
+  trace::Span span("mysql.query", selectionName(MySQLSelection::LOAD_ACCOUNTS),
+                   trace::SpanKind::CLIENT);
+  try {
+    const std::string &key =
+        m_delegator.get()->m_sql.at(MySQLSelection::LOAD_ACCOUNTS);
+    metrics::ScopedTimer timer(
+        *m_delegator.get()->m_latency.at(MySQLSelection::LOAD_ACCOUNTS));
+    logger::mysql()->debug("Executing MySQL Query: {}", key);
+    boost::mysql::statement stmt = conn.prepare_statement(key);
+    boost::mysql::execution_state state;
+    conn.start_execution(stmt.bind(), state);
+    while (!state.complete()) {
+      for (auto row : conn.read_some_rows(state)) {
+        callback(row.at(0).as_string(), row.at(1).as_string());
+      }
+    }
+    updateTimer();
+    return true;
+
+  } catch (const boost::mysql::error_with_diagnostics &err) {
+    span.setError();
+    checkBroken(err);
+    logger::mysql()->error(
+        "{0}:{1} Operation failed with error code: {2} Server diagnostics: {3}",
+        __FILE__, __LINE__, std::to_string(err.code().value()),
+        err.get_diagnostics().server_message().data());
+    return false;
+  }
 }
 
 void mysql::MySQLConnection::updateTimer() {
   last_operation_time = std::chrono::steady_clock::now();
+
+  /*the last ping found this connection in use and didn't arm again*/
+  if (!m_ping_armed->exchange(true)) {
+    scheduleIdlePing(idleTimeout());
+  }
+}
+
+std::chrono::steady_clock::duration
+mysql::MySQLConnection::idleTimeout() const {
+  return std::chrono::seconds(m_delegator->m_timeout);
+}
+
+void mysql::MySQLConnection::scheduleIdlePing(
+    std::chrono::steady_clock::duration delay) {
+  m_ping_timer.expires_after(delay);
+  m_ping_timer.async_wait([armed = m_ping_armed, pool = m_delegator.get(),
+                           self = this](boost::system::error_code ec) {
+    /*timer is cancelled by destructor*/
+    if (ec) {
+      return;
+    }
+    armed->store(false);
+
+    /*busy connections are left alone, their next query arms the timer*/
+    auto idle = pool->claim(self);
+    if (idle.has_value()) {
+      pingIfIdle(std::move(idle.value()));
+    }
+  });
+}
+
+void mysql::MySQLConnection::pingIfIdle(std::unique_ptr<MySQLConnection> self) {
+  static metrics::Counter &succeeded =
+      metrics::MetricsRegistry::get_instance()->counter(
+          "gateway_mysql_idle_pings_total", "Pings of idle MySQL connections",
+          "result=\"success\"");
+  static metrics::Counter &failed =
+      metrics::MetricsRegistry::get_instance()->counter(
+          "gateway_mysql_idle_pings_total", "Pings of idle MySQL connections",
+          "result=\"failure\"");
+
+  MySQLConnection *conn = self.get();
+  MySQLConnectionPool *pool = conn->m_delegator.get();
+
+  /*used again after the timer was armed, wait for the rest of timeout*/
+  const auto idle =
+      std::chrono::steady_clock::now() - conn->last_operation_time;
+  if (idle < conn->idleTimeout()) {
+    conn->m_ping_armed->store(true);
+    conn->scheduleIdlePing(conn->idleTimeout() - idle);
+    pool->release(std::move(self));
+    return;
+  }
+
+  conn->conn.async_ping([self = std::move(self), pool](
+                            boost::system::error_code ec) mutable {
+    if (ec) {
+      failed.inc();
+      logger::mysql()->warn("MySQL idle ping failed: {}", ec.message());
+
+      /*pool drops it and reconnector dials a new one*/
+      self->m_valid = false;
+    } else {
+      succeeded.inc();
+      self->updateTimer();
+    }
+    pool->release(std::move(self));
+  });
 }
@@ -1,4 +1,6 @@
 #include <config/ServerConfig.hpp>
+#include <future>
+#include <random>
 #include <spdlog/spdlog.h>
 #include <sql/MySQLConnectionPool.hpp>
 
@@ -13,6 +15,8 @@ mysql::MySQLConnectionPool::MySQLConnectionPool() noexcept
                ServerConfig::get_instance()->MySQL_username,
                ServerConfig::get_instance()->MySQL_passwd,
                ServerConfig::get_instance()->MySQL_database);
+
+  createReplicas(ServerConfig::get_instance()->Replica_hosts);
 }
 
 mysql::MySQLConnectionPool::MySQLConnectionPool(
@@ -20,29 +24,206 @@ mysql::MySQLConnectionPool::MySQLConnectionPool(
     const std::string &password, const std::string &database,
     const std::string &host, const std::string &port) noexcept
     : m_timeout(timeOut), m_username(username), m_password(password),
-      m_database(database), m_host(host), m_port(port) {
+      m_database(database), m_host(host), m_port(port),
+      m_cache(std::make_shared<AccountCache>(
+          ServerConfig::get_instance()->AccountCache_capacity,
+          ServerConfig::get_instance()->Replica_sticky_capacity)),
+      m_sticky_window(std::chrono::milliseconds(
+          ServerConfig::get_instance()->Replica_sticky_window_ms)) {
   registerSQLStatement();
+  registerStatementMetrics();
+  registerMetrics("mysql");
+  setupConnections();
 
-  for (std::size_t i = 0; i < m_queue_size; ++i) {
-    m_stub_queue.push(std::move(std::make_unique<mysql::MySQLConnection>(
-        username, password, database, host, port, this)));
-  }
+  auto registry = metrics::MetricsRegistry::get_instance();
+  m_primary_reads =
+      &registry->counter("gateway_mysql_reads_total",
+                         "Read-only queries by the server they are routed to",
+                         "target=\"primary\"");
+  m_replica_reads =
+      &registry->counter("gateway_mysql_reads_total",
+                         "Read-only queries by the server they are routed to",
+                         "target=\"replica\"");
+}
+
+mysql::MySQLConnectionPool::MySQLConnectionPool(
+    MySQLConnectionPool *primary, std::size_t index, const std::string &host,
+    const std::string &port) noexcept
+    : m_timeout(primary->m_timeout), m_username(primary->m_username),
+      m_password(primary->m_password), m_database(primary->m_database),
+      m_host(host), m_port(port), m_cache(primary->m_cache) {
+  registerSQLStatement();
+  registerStatementMetrics();
+  registerMetrics(fmt::format("mysql_replica{}", index));
+  setupConnections();
 
-  m_RRThread = std::thread([this]() {
-    while (!m_stop) {
-      spdlog::info("[Chatting Server HeartBeat Check]: Timeout Setting {}s",
-                   m_timeout);
+  auto registry = metrics::MetricsRegistry::get_instance();
+  registry->gauge("gateway_mysql_latency_ewma_seconds",
+                  "Smoothed query latency which replicas are picked by",
+                  fmt::format("pool=\"{}\"", name()), [this]() {
+                    return static_cast<double>(m_latency_ewma.load(
+                               std::memory_order_relaxed)) /
+                           1e9;
+                  });
+}
 
-      roundRobinChecking();
+mysql::MySQLConnectionPool::AccountCache::AccountCache(
+    std::size_t capacity, std::size_t sticky_capacity)
+    : uuid("username_to_uuid", capacity),
+      username("uuid_to_username", capacity),
+      written("recent_writes", sticky_capacity) {}
 
-      /*suspend this thread by timeout setting*/
-      std::this_thread::sleep_for(std::chrono::seconds(m_timeout));
+void mysql::MySQLConnectionPool::setupConnections() {
+  /*connections are dialed by warmup() and acquire()*/
+  setFactory(
+      [this]() -> context_ptr {
+        auto conn = std::make_unique<mysql::MySQLConnection>(
+            m_username, m_password, m_database, m_host, m_port, this);
+        return conn->isValid() ? std::move(conn) : nullptr;
+      },
+      ServerConfig::get_instance()->Warmup_lazy,
+      ServerConfig::get_instance()->Warmup_minimum);
+  setHealthCheck([](mysql::MySQLConnection &conn) { return conn.isValid(); });
+}
+
+void mysql::MySQLConnectionPool::createReplicas(const std::string &hosts) {
+  std::size_t begin = 0;
+  while (begin < hosts.size()) {
+    std::size_t end = hosts.find(',', begin);
+    if (end == std::string::npos) {
+      end = hosts.size();
+    }
+
+    /*host:port, port defaults to primary's*/
+    std::string address = hosts.substr(begin, end - begin);
+    address.erase(0, address.find_first_not_of(' '));
+    address.erase(address.find_last_not_of(' ') + 1);
+    begin = end + 1;
+    if (address.empty()) {
+      continue;
     }
-  });
-  m_RRThread.detach();
+
+    const std::size_t colon = address.rfind(':');
+    const std::string host = address.substr(0, colon);
+    const std::string port =
+        colon == std::string::npos ? m_port : address.substr(colon + 1);
+
+    spdlog::info("Connecting to MySQL replica ip: {0}, port: {1}", host, port);
+    m_replicas.emplace_back(
+        new MySQLConnectionPool(this, m_replicas.size(), host, port));
+  }
+}
+
+/*reconnector uses members of this class, stop it before they are destroyed*/
+mysql::MySQLConnectionPool::~MySQLConnectionPool() { shutdown(); }
+
+void mysql::MySQLConnectionPool::warmup() {
+  std::vector<std::future<void>> replicas;
+  for (auto &replica : m_replicas) {
+    replicas.push_back(std::async(std::launch::async,
+                                  [&replica]() { replica->warmup(); }));
+  }
+  ConnectionPool::warmup();
+  for (auto &replica : replicas) {
+    replica.wait();
+  }
+}
+
+void mysql::MySQLConnectionPool::shutdown() {
+  for (auto &replica : m_replicas) {
+    replica->shutdown();
+  }
+  ConnectionPool::shutdown();
+}
+
+void mysql::MySQLConnectionPool::invalidateAccount(std::string_view username,
+                                                   std::size_t uuid) {
+  m_cache->uuid.erase(username);
+  m_cache->username.erase(uuid);
+}
+
+mysql::MySQLConnectionPool *
+mysql::MySQLConnectionPool::route(MySQLSelection select,
+                                  std::string_view username) {
+  if (!isReadOnly(select)) {
+    return this;
+  }
+
+  MySQLConnectionPool *replica = nullptr;
+  auto written =
+      username.empty() ? std::nullopt : m_cache->written.get(username);
+  if (!written.has_value() ||
+      std::chrono::steady_clock::now() - written.value() >= m_sticky_window) {
+    replica = pickReplica();
+  }
+
+  if (replica == nullptr) {
+    m_primary_reads->inc();
+    return this;
+  }
+  m_replica_reads->inc();
+  return replica;
+}
+
+void mysql::MySQLConnectionPool::markWritten(std::string_view username) {
+  if (!m_replicas.empty()) {
+    m_cache->written.put(username, std::chrono::steady_clock::now());
+  }
 }
 
-mysql::MySQLConnectionPool::~MySQLConnectionPool() {}
+void mysql::MySQLConnectionPool::observeLatency(
+    std::chrono::steady_clock::duration elapsed) {
+  const std::int64_t sample =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
+  /*concurrent updates may lose a sample, balancing doesn't need all of them*/
+  const std::int64_t old = m_latency_ewma.load(std::memory_order_relaxed);
+  m_latency_ewma.store(old == 0 ? sample : old + (sample - old) / 8,
+                       std::memory_order_relaxed);
+}
+
+mysql::MySQLConnectionPool *mysql::MySQLConnectionPool::pickReplica() {
+  if (m_replicas.empty()) {
+    return nullptr;
+  }
+
+  /*a replica with at least one connection up may serve reads*/
+  auto available = [](MySQLConnectionPool *pool) {
+    return pool != nullptr &&
+           pool->m_connected.load(std::memory_order_relaxed) > 0;
+  };
+  auto faster = [&available](MySQLConnectionPool *lhs,
+                             MySQLConnectionPool *rhs) {
+    if (!available(lhs)) {
+      return available(rhs) ? rhs : nullptr;
+    }
+    if (!available(rhs)) {
+      return lhs;
+    }
+    return rhs->m_latency_ewma.load(std::memory_order_relaxed) <
+                   lhs->m_latency_ewma.load(std::memory_order_relaxed)
+               ? rhs
+               : lhs;
+  };
+
+  /*
+   * power of two choices, always taking the fastest replica would move every
+   * read to it until its latency grows
+   */
+  thread_local std::mt19937 engine{std::random_device{}()};
+  std::uniform_int_distribution<std::size_t> pick(0, m_replicas.size() - 1);
+  MySQLConnectionPool *chosen = faster(m_replicas[pick(engine)].get(),
+                                       m_replicas[pick(engine)].get());
+  if (chosen != nullptr) {
+    return chosen;
+  }
+
+  /*both are reconnecting, any connected replica is better than primary*/
+  for (auto &replica : m_replicas) {
+    chosen = faster(chosen, replica.get());
+  }
+  return chosen;
+}
 
 void mysql::MySQLConnectionPool::registerSQLStatement() {
   m_sql.insert(std::pair(MySQLSelection::HEART_BEAT, fmt::format("SELECT 1")));
@@ -62,10 +243,10 @@ void mysql::MySQLConnectionPool::registerSQLStatement() {
       fmt::format("UPDATE Authentication SET {} = ? WHERE {} = ? AND {} = ?",
                   std::string("password"), std::string("username"),
                   std::string("email"))));
-  m_sql.insert(std::pair(
-      MySQLSelection::USER_LOGIN_CHECK,
-      fmt::format("SELECT * FROM Authentication WHERE {} = ? AND {} = ?",
-                  std::string("username"), std::string("password"))));
+  m_sql.insert(
+      std::pair(MySQLSelection::USER_LOGIN_CHECK,
+                fmt::format("SELECT {} FROM Authentication WHERE {} = ?",
+                            std::string("password"), std::string("username"))));
 
   m_sql.insert(
       std::pair(MySQLSelection::USER_UUID_CHECK,
@@ -76,10 +257,11 @@ void mysql::MySQLConnectionPool::registerSQLStatement() {
                          fmt::format("SELECT * FROM UserProfile WHERE {} = ?",
                                      std::string("uuid"))));
 
-  m_sql.insert(
-      std::pair(MySQLSelection::GET_USER_UUID,
-                fmt::format("SELECT uuid FROM Authentication WHERE {} = ?",
-                            std::string("username"))));
+  m_sql.insert(std::pair(
+      MySQLSelection::GET_USER_UUID,
+      fmt::format("SELECT {}, {} FROM Authentication WHERE {} = ?",
+                  std::string("uuid"), std::string("username"),
+                  std::string("username"))));
 
   m_sql.insert(std::pair(
       MySQLSelection::USER_FRIEND_REQUEST,
@@ -89,29 +271,64 @@ void mysql::MySQLConnectionPool::registerSQLStatement() {
           std::string("src_uuid"), std::string("dst_uuid"),
           std::string("nickname"), std::string("message"),
           std::string("status"))));
+
+  m_sql.insert(std::pair(MySQLSelection::LOAD_ACCOUNTS,
+                         fmt::format("SELECT {}, {} FROM Authentication",
+                                     std::string("username"),
+                                     std::string("email"))));
 }
 
-void mysql::MySQLConnectionPool::roundRobinChecking() {
-  std::lock_guard<std::mutex> _lckg(m_RRMutex);
-  if (m_stop) {
-    return;
+const char *mysql::selectionName(MySQLSelection select) {
+  switch (select) {
+  case MySQLSelection::HEART_BEAT:
+    return "HEART_BEAT";
+  case MySQLSelection::FIND_EXISTING_USER:
+    return "FIND_EXISTING_USER";
+  case MySQLSelection::CREATE_NEW_USER:
+    return "CREATE_NEW_USER";
+  case MySQLSelection::ACQUIRE_NEW_UID:
+    return "ACQUIRE_NEW_UID";
+  case MySQLSelection::UPDATE_UID_COUNTER:
+    return "UPDATE_UID_COUNTER";
+  case MySQLSelection::UPDATE_USER_PASSWD:
+    return "UPDATE_USER_PASSWD";
+  case MySQLSelection::USER_LOGIN_CHECK:
+    return "USER_LOGIN_CHECK";
+  case MySQLSelection::USER_UUID_CHECK:
+    return "USER_UUID_CHECK";
+  case MySQLSelection::USER_PROFILE:
+    return "USER_PROFILE";
+  case MySQLSelection::GET_USER_UUID:
+    return "GET_USER_UUID";
+  case MySQLSelection::USER_FRIEND_REQUEST:
+    return "USER_FRIEND_REQUEST";
+  case MySQLSelection::LOAD_ACCOUNTS:
+    return "LOAD_ACCOUNTS";
   }
+  return "UNKNOWN";
+}
 
-  for (std::size_t i = 0; i < m_stub_queue.size(); ++i) {
-    connection::ConnectionRAII<mysql::MySQLConnectionPool,
-                               mysql::MySQLConnection>
-        instance;
-
-    [[maybe_unused]] bool status = instance->get()->checkTimeout(
-        std::chrono::steady_clock::now(), m_timeout);
-
-    /*checktimeout error, then create a new connection*/
-    if (!status) [[unlikely]] {
-      /*create a new connection*/
-      m_stub_queue.push(std::move(std::make_unique<mysql::MySQLConnection>(
-          m_username, m_password, m_database, m_host, m_port, this)));
+bool mysql::isReadOnly(MySQLSelection select) {
+  switch (select) {
+  case MySQLSelection::FIND_EXISTING_USER:
+  case MySQLSelection::USER_LOGIN_CHECK:
+  case MySQLSelection::USER_UUID_CHECK:
+  case MySQLSelection::USER_PROFILE:
+  case MySQLSelection::GET_USER_UUID:
+    return true;
+  default:
+    return false;
+  }
+}
 
-      m_cv.notify_one();
-    }
+void mysql::MySQLConnectionPool::registerStatementMetrics() {
+  auto registry = metrics::MetricsRegistry::get_instance();
+  for (const auto &[select, sql] : m_sql) {
+    m_latency.emplace(select,
+                      &registry->histogram(
+                          "gateway_mysql_query_duration_seconds",
+                          "MySQL statement latency",
+                          fmt::format("statement=\"{}\"",
+                                      selectionName(select))));
   }
 }
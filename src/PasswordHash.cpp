@@ -0,0 +1,130 @@
+#include <cstdio>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <tools/PasswordHash.hpp>
+
+namespace {
+constexpr std::string_view scheme = "$scrypt$";
+constexpr std::size_t salt_length = 16;
+constexpr std::size_t key_length = 32;
+
+std::string toHex(const unsigned char *data, std::size_t length) {
+  static constexpr char digits[] = "0123456789abcdef";
+  std::string hex(length * 2, '\0');
+  for (std::size_t i = 0; i < length; ++i) {
+    hex[i * 2] = digits[data[i] >> 4];
+    hex[i * 2 + 1] = digits[data[i] & 0xf];
+  }
+  return hex;
+}
+
+bool fromHex(std::string_view hex, std::string &bytes) {
+  auto value = [](char c) -> int {
+    if (c >= '0' && c <= '9') {
+      return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+      return c - 'a' + 10;
+    }
+    return -1;
+  };
+
+  if (hex.size() % 2 != 0) {
+    return false;
+  }
+  bytes.resize(hex.size() / 2);
+  for (std::size_t i = 0; i < bytes.size(); ++i) {
+    int high = value(hex[i * 2]);
+    int low = value(hex[i * 2 + 1]);
+    if (high < 0 || low < 0) {
+      return false;
+    }
+    bytes[i] = static_cast<char>(high << 4 | low);
+  }
+  return true;
+}
+
+bool derive(std::string_view password, std::string_view salt,
+            const tools::ScryptParams &params, unsigned char *out,
+            std::size_t length) {
+  const uint64_t n = uint64_t{1} << params.cost;
+
+  /*scrypt needs 128 * r * (N + p) bytes, OpenSSL refuses 32MB by default*/
+  const uint64_t max_memory =
+      128 * static_cast<uint64_t>(params.block_size) * (n + params.parallelism) +
+      (1 << 20);
+  return EVP_PBE_scrypt(password.data(), password.size(),
+                        reinterpret_cast<const unsigned char *>(salt.data()),
+                        salt.size(), n, params.block_size, params.parallelism,
+                        max_memory, out, length) == 1;
+}
+} // namespace
+
+std::optional<std::string>
+tools::hashPassword(std::string_view password, const ScryptParams &params) {
+  unsigned char salt[salt_length];
+  if (RAND_bytes(salt, sizeof(salt)) != 1) {
+    return std::nullopt;
+  }
+
+  unsigned char key[key_length];
+  if (!derive(password,
+              std::string_view(reinterpret_cast<const char *>(salt),
+                               sizeof(salt)),
+              params, key, sizeof(key))) {
+    return std::nullopt;
+  }
+
+  char settings[64];
+  std::snprintf(settings, sizeof(settings), "ln=%u,r=%u,p=%u",
+                static_cast<unsigned>(params.cost), params.block_size,
+                params.parallelism);
+
+  std::string stored(scheme);
+  stored.append(settings)
+      .append(1, '$')
+      .append(toHex(salt, sizeof(salt)))
+      .append(1, '$')
+      .append(toHex(key, sizeof(key)));
+  return stored;
+}
+
+bool tools::verifyPassword(std::string_view password, std::string_view stored) {
+  if (stored.substr(0, scheme.size()) != scheme) {
+    return password.size() == stored.size() &&
+           CRYPTO_memcmp(password.data(), stored.data(), password.size()) == 0;
+  }
+
+  /*ln=15,r=8,p=1$<salt>$<hash>*/
+  std::string_view rest = stored.substr(scheme.size());
+  const std::size_t first = rest.find('$');
+  const std::size_t second =
+      first == std::string_view::npos ? first : rest.find('$', first + 1);
+  if (second == std::string_view::npos) {
+    return false;
+  }
+
+  unsigned cost = 0, block_size = 0, parallelism = 0;
+  const std::string settings(rest.substr(0, first));
+  if (std::sscanf(settings.c_str(), "ln=%u,r=%u,p=%u", &cost, &block_size,
+                  &parallelism) != 3 ||
+      cost == 0 || cost > 24 || block_size == 0 || parallelism == 0) {
+    return false;
+  }
+
+  std::string salt, expected;
+  if (!fromHex(rest.substr(first + 1, second - first - 1), salt) ||
+      !fromHex(rest.substr(second + 1), expected) || expected.empty()) {
+    return false;
+  }
+
+  std::string key(expected.size(), '\0');
+  if (!derive(password, salt,
+              ScryptParams{static_cast<uint8_t>(cost), block_size,
+                           parallelism},
+              reinterpret_cast<unsigned char *>(key.data()), key.size())) {
+    return false;
+  }
+  return CRYPTO_memcmp(key.data(), expected.data(), key.size()) == 0;
+}
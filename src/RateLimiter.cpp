@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cmath>
+#include <config/ServerConfig.hpp>
+#include <handler/RateLimiter.hpp>
+#include <metrics/MetricsRegistry.hpp>
+#include <redis/RedisManager.hpp>
+#include <string>
+
+namespace {
+/*
+ * KEYS[1] bucket, ARGV[1] rate(tokens/s), ARGV[2] burst
+ * returns 0 when a token is taken, otherwise milliseconds to wait
+ */
+const redis::RedisScript token_bucket_script(R"(
+local rate = tonumber(ARGV[1])
+local burst = tonumber(ARGV[2])
+local time = redis.call('TIME')
+local now = tonumber(time[1]) * 1000 + math.floor(tonumber(time[2]) / 1000)
+local bucket = redis.call('HMGET', KEYS[1], 'tokens', 'last')
+local tokens = tonumber(bucket[1]) or burst
+local last = tonumber(bucket[2]) or now
+tokens = math.min(burst, tokens + math.max(0, now - last) * rate / 1000)
+local wait = 0
+if tokens >= 1 then
+  tokens = tokens - 1
+else
+  wait = math.ceil((1 - tokens) * 1000 / rate)
+end
+redis.call('HSET', KEYS[1], 'tokens', tostring(tokens), 'last', now)
+redis.call('PEXPIRE', KEYS[1], math.ceil(burst * 1000 / rate) + 1000)
+return wait
+)");
+} // namespace
+
+admission::TokenBuckets::TokenBuckets(double rate, double burst,
+                                      std::size_t max_keys)
+    : m_rate(rate), m_burst(std::max(1.0, burst)),
+      m_shard_capacity(std::max<std::size_t>(1, max_keys / shard_count)) {}
+
+std::optional<std::chrono::milliseconds>
+admission::TokenBuckets::take(std::string_view key) {
+  /*64-bit hash is the key, so lookup never copies the string*/
+  const std::size_t hash = std::hash<std::string_view>{}(key);
+  Shard &shard = m_shards[hash % shard_count];
+  const auto now = clock::now();
+
+  std::lock_guard<std::mutex> _lckg(shard.mtx);
+  auto it = shard.buckets.find(hash);
+  if (it == shard.buckets.end()) {
+    if (shard.buckets.size() >= m_shard_capacity) {
+      evict(shard, now);
+    }
+    shard.buckets.emplace(hash, Bucket{m_burst - 1, now});
+    return std::nullopt;
+  }
+
+  Bucket &bucket = it->second;
+  const double elapsed =
+      std::chrono::duration<double>(now - bucket.last).count();
+  bucket.tokens = std::min(m_burst, bucket.tokens + elapsed * m_rate);
+  bucket.last = now;
+
+  if (bucket.tokens >= 1) {
+    bucket.tokens -= 1;
+    return std::nullopt;
+  }
+  return std::chrono::milliseconds(
+      static_cast<long long>(std::ceil((1 - bucket.tokens) * 1000 / m_rate)));
+}
+
+void admission::TokenBuckets::evict(Shard &shard, clock::time_point now) {
+  /*a bucket idle for burst / rate seconds has been refilled completely*/
+  const auto refill = std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>(m_burst / m_rate));
+
+  for (auto it = shard.buckets.begin(); it != shard.buckets.end();) {
+    if (now - it->second.last >= refill) {
+      it = shard.buckets.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  /*every key is active, forget an arbitrary one instead of growing*/
+  if (shard.buckets.size() >= m_shard_capacity) {
+    shard.buckets.erase(shard.buckets.begin());
+  }
+}
+
+admission::RateLimiter::RateLimiter() {
+  auto config = ServerConfig::get_instance();
+  m_enabled = config->RateLimit_enabled;
+  m_shared = config->RateLimit_redis;
+
+  auto registry = metrics::MetricsRegistry::get_instance();
+  auto create = [&](RateKey kind, const char *name, double rate,
+                    double burst) {
+    Policy &policy = m_policies[static_cast<std::size_t>(kind)];
+    policy.name = name;
+    policy.rate = std::max(0.0, rate);
+    policy.burst = std::max(1.0, burst);
+    if (policy.rate > 0) {
+      policy.local = std::make_unique<TokenBuckets>(
+          policy.rate, policy.burst, config->RateLimit_max_keys);
+    }
+    policy.limited = &registry->counter(
+        "gateway_rate_limited_total", "Requests rejected by token buckets",
+        std::string("key=\"") + name + "\"");
+  };
+
+  create(RateKey::IP, "ip", config->RateLimit_ip_rate,
+         config->RateLimit_ip_burst);
+  create(RateKey::EMAIL, "email", config->RateLimit_email_rate,
+         config->RateLimit_email_burst);
+  create(RateKey::USERNAME, "username", config->RateLimit_username_rate,
+         config->RateLimit_username_burst);
+}
+
+admission::RateLimiter::~RateLimiter() {}
+
+std::optional<std::chrono::seconds>
+admission::RateLimiter::check(RateKey kind, std::string_view key) {
+  const Policy &policy = m_policies[static_cast<std::size_t>(kind)];
+  if (!m_enabled || policy.local == nullptr) {
+    return std::nullopt;
+  }
+
+  std::optional<std::chrono::milliseconds> wait;
+  if (m_shared) {
+    wait = takeShared(policy, key);
+  }
+  if (!wait.has_value()) {
+    wait = policy.local->take(key);
+  }
+  if (!wait.has_value() || wait->count() == 0) {
+    return std::nullopt;
+  }
+
+  policy.limited->inc();
+
+  /*Retry-After has a resolution of one second*/
+  return std::chrono::ceil<std::chrono::seconds>(*wait);
+}
+
+std::optional<std::chrono::milliseconds>
+admission::RateLimiter::takeShared(const Policy &policy,
+                                   std::string_view key) {
+  connection::ConnectionRAII<redis::RedisConnectionPool, redis::RedisContext>
+      raii;
+  auto stub = raii.operator->();
+  if (!stub.has_value() || !stub->get()->isValid()) {
+    return std::nullopt;
+  }
+
+  std::string bucket = std::string("ratelimit:") + policy.name + ':';
+  bucket.append(key);
+
+  const std::string rate = std::to_string(policy.rate);
+  const std::string burst = std::to_string(policy.burst);
+  auto wait = stub->get()->evalInteger(token_bucket_script, bucket,
+                                       {rate, burst});
+  if (!wait.has_value()) {
+    return std::nullopt;
+  }
+  return std::chrono::milliseconds(*wait);
+}
@@ -0,0 +1,347 @@
+#include <config/ServerConfig.hpp>
+#include <log/LogManager.hpp>
+#include <poll.h>
+#include <random>
+#include <redis/RedisClientCache.hpp>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+namespace {
+/*list node, index slot and allocator headers of one entry*/
+constexpr std::size_t entry_overhead = 64;
+
+std::size_t cost(std::string_view key, std::string_view value) {
+  return key.size() + value.size() + entry_overhead;
+}
+} // namespace
+
+redis::RedisClientCache::RedisClientCache(const std::string &ip,
+                                          unsigned short port,
+                                          const std::string &password,
+                                          const std::string &prefixes,
+                                          std::size_t max_bytes)
+    : m_ip(ip), m_port(port), m_password(password),
+      m_shard_bytes(max_bytes / shard_count) {
+  std::size_t begin = 0;
+  while (begin < prefixes.size()) {
+    std::size_t end = prefixes.find(',', begin);
+    if (end == std::string::npos) {
+      end = prefixes.size();
+    }
+    std::string prefix = prefixes.substr(begin, end - begin);
+    prefix.erase(0, prefix.find_first_not_of(' '));
+    prefix.erase(prefix.find_last_not_of(' ') + 1);
+    begin = end + 1;
+    if (!prefix.empty()) {
+      m_prefixes.push_back(std::move(prefix));
+    }
+  }
+
+  auto registry = metrics::MetricsRegistry::get_instance();
+  m_hits = &registry->counter("gateway_cache_requests_total",
+                              "Lookups of in-memory caches",
+                              "cache=\"redis\",result=\"hit\"");
+  m_misses = &registry->counter("gateway_cache_requests_total",
+                                "Lookups of in-memory caches",
+                                "cache=\"redis\",result=\"miss\"");
+  m_invalidations =
+      &registry->counter("gateway_redis_invalidations_total",
+                         "Keys invalidated by redis client tracking");
+  registry->gauge("gateway_redis_client_cache_bytes",
+                  "Keys and values held by the redis client side cache", "",
+                  [this]() { return static_cast<double>(bytes()); });
+
+  m_thread = std::thread([this]() { listen(); });
+}
+
+redis::RedisClientCache::~RedisClientCache() { shutdown(); }
+
+bool redis::RedisClientCache::covers(std::string_view key) const {
+  for (const auto &prefix : m_prefixes) {
+    if (key.substr(0, prefix.size()) == prefix) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::optional<std::string>
+redis::RedisClientCache::get(std::string_view key) {
+  if (m_tracking.load()) {
+    const std::size_t hash = std::hash<std::string_view>{}(key);
+    Shard &s = shard(hash);
+    std::lock_guard<std::mutex> _lckg(s.mtx);
+    auto it = s.index.find(hash);
+    if (it != s.index.end() && it->second->key == key) {
+      s.order.splice(s.order.begin(), s.order, it->second);
+      m_hits->inc();
+      return it->second->value;
+    }
+  }
+  m_misses->inc();
+  return std::nullopt;
+}
+
+std::uint64_t redis::RedisClientCache::epoch(std::string_view key) {
+  Shard &s = shard(std::hash<std::string_view>{}(key));
+  std::lock_guard<std::mutex> _lckg(s.mtx);
+  return s.epoch;
+}
+
+void redis::RedisClientCache::put(std::string_view key, std::string value,
+                                  std::uint64_t epoch) {
+  const std::size_t size = cost(key, value);
+  if (size > m_shard_bytes) {
+    return;
+  }
+
+  const std::size_t hash = std::hash<std::string_view>{}(key);
+  Shard &s = shard(hash);
+  std::lock_guard<std::mutex> _lckg(s.mtx);
+
+  /*key may have been modified after redis answered, the reply is stale*/
+  if (!m_tracking.load() || s.epoch != epoch) {
+    return;
+  }
+
+  auto it = s.index.find(hash);
+  if (it != s.index.end()) {
+    s.bytes -= cost(it->second->key, it->second->value);
+    s.order.erase(it->second);
+    s.index.erase(it);
+  }
+  while (s.bytes + size > m_shard_bytes) {
+    const Entry &last = s.order.back();
+    s.bytes -= cost(last.key, last.value);
+    s.index.erase(last.hash);
+    s.order.pop_back();
+  }
+  s.order.push_front(Entry{hash, std::string(key), std::move(value)});
+  s.index.emplace(hash, s.order.begin());
+  s.bytes += size;
+}
+
+void redis::RedisClientCache::invalidate(std::string_view key) {
+  const std::size_t hash = std::hash<std::string_view>{}(key);
+  Shard &s = shard(hash);
+  std::lock_guard<std::mutex> _lckg(s.mtx);
+  ++s.epoch;
+
+  /*colliding keys are dropped as well, they are read again*/
+  auto it = s.index.find(hash);
+  if (it != s.index.end()) {
+    s.bytes -= cost(it->second->key, it->second->value);
+    s.order.erase(it->second);
+    s.index.erase(it);
+  }
+}
+
+std::size_t redis::RedisClientCache::bytes() {
+  std::size_t total = 0;
+  for (auto &s : m_shards) {
+    std::lock_guard<std::mutex> _lckg(s.mtx);
+    total += s.bytes;
+  }
+  return total;
+}
+
+void redis::RedisClientCache::shutdown() {
+  {
+    std::lock_guard<std::mutex> _lckg(m_mtx);
+    m_stop = true;
+
+    /*redisGetReply blocks until the socket is closed*/
+    if (m_listener_fd != -1) {
+      ::shutdown(m_listener_fd, SHUT_RDWR);
+    }
+  }
+  m_cv.notify_all();
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+void redis::RedisClientCache::flush() {
+  for (auto &s : m_shards) {
+    std::lock_guard<std::mutex> _lckg(s.mtx);
+    ++s.epoch;
+    s.bytes = 0;
+    s.order.clear();
+    s.index.clear();
+  }
+}
+
+void redis::RedisClientCache::listen() {
+  thread_local std::mt19937 engine{std::random_device{}()};
+  auto config = ServerConfig::get_instance();
+  const std::chrono::milliseconds initial(config->Reconnect_initial_backoff_ms);
+  const std::chrono::milliseconds maximum(
+      std::max(config->Reconnect_max_backoff_ms,
+               config->Reconnect_initial_backoff_ms));
+  std::chrono::milliseconds backoff = initial;
+  const std::chrono::milliseconds interval(
+      std::max<std::size_t>(1, config->RedisTracking_ping_interval_ms));
+
+  while (!m_stop.load()) {
+    tools::RedisSmartPtr<redisContext> ctx(redisConnect(m_ip.c_str(), m_port));
+    if (ctx != nullptr && !ctx->err) {
+      /*a host which vanished without FIN is found by keepalive and PING*/
+      redisEnableKeepAlive(ctx.get());
+      const timeval timeout{
+          static_cast<time_t>(interval.count() / 1000),
+          static_cast<suseconds_t>(interval.count() % 1000 * 1000)};
+      redisSetTimeout(ctx.get(), timeout);
+
+      {
+        std::lock_guard<std::mutex> _lckg(m_mtx);
+        if (m_stop.load()) {
+          break;
+        }
+        m_listener_fd = ctx->fd;
+      }
+
+      if (subscribe(ctx.get())) {
+        /*keys written while nobody was listening may be cached*/
+        flush();
+        m_tracking = true;
+        backoff = initial;
+        logger::redis()->info("Redis client tracking enabled for {} prefixes",
+                              m_prefixes.size());
+
+        receive(ctx.get(), interval);
+
+        m_tracking = false;
+        flush();
+        if (!m_stop.load()) {
+          logger::redis()->warn("Redis client tracking connection lost, "
+                                "client side cache is flushed");
+        }
+      }
+
+      std::lock_guard<std::mutex> _lckg(m_mtx);
+      m_listener_fd = -1;
+    }
+
+    std::uniform_int_distribution<long long> jitter(0, backoff.count());
+    std::unique_lock<std::mutex> _lckg(m_mtx);
+    m_cv.wait_for(_lckg, std::chrono::milliseconds(jitter(engine)),
+                  [this]() { return m_stop.load(); });
+    backoff = std::min(backoff * 2, maximum);
+  }
+}
+
+void redis::RedisClientCache::receive(redisContext *ctx,
+                                      std::chrono::milliseconds interval) {
+  bool ping_sent = false;
+  for (;;) {
+    /*replies which are buffered already*/
+    void *raw = nullptr;
+    while (redisGetReplyFromReader(ctx, &raw) == REDIS_OK && raw != nullptr) {
+      tools::RedisSmartPtr<redisReply> reply(
+          reinterpret_cast<redisReply *>(raw));
+      raw = nullptr;
+
+      /*anything else is the PONG, the connection is alive*/
+      ping_sent = false;
+      if (reply->type == REDIS_REPLY_PUSH) {
+        handlePush(reply.get());
+      }
+    }
+    if (ctx->err) {
+      return;
+    }
+
+    pollfd pfd{ctx->fd, POLLIN, 0};
+    const int ready = ::poll(&pfd, 1, static_cast<int>(interval.count()));
+    if (ready < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ready < 0) {
+      return;
+    }
+
+    /*
+     * an idle connection is PINGed, one silent interval after that means
+     * invalidations may be lost as well
+     */
+    if (ready == 0) {
+      if (ping_sent) {
+        logger::redis()->warn("Redis client tracking connection timed out");
+        return;
+      }
+      int done = 0;
+      if (redisAppendCommand(ctx, "PING") != REDIS_OK) {
+        return;
+      }
+      while (!done) {
+        if (redisBufferWrite(ctx, &done) != REDIS_OK) {
+          return;
+        }
+      }
+      ping_sent = true;
+      continue;
+    }
+
+    if (redisBufferRead(ctx) != REDIS_OK) {
+      return;
+    }
+  }
+}
+
+bool redis::RedisClientCache::subscribe(redisContext *ctx) {
+  /*invalidations are returned by redisGetReply instead of being freed*/
+  redisSetPushCallback(ctx, nullptr);
+
+  tools::RedisSmartPtr<redisReply> reply;
+  if (!m_password.empty()) {
+    reply.reset(reinterpret_cast<redisReply *>(
+        ::redisCommand(ctx, "AUTH %s", m_password.c_str())));
+  }
+
+  /*push messages need RESP3, redis 6 or newer*/
+  reply.reset(reinterpret_cast<redisReply *>(::redisCommand(ctx, "HELLO 3")));
+  if (reply == nullptr || reply->type == REDIS_REPLY_ERROR) {
+    logger::redis()->error("Redis client tracking needs RESP3, HELLO 3 failed");
+    return false;
+  }
+
+  std::vector<const char *> argv{"CLIENT", "TRACKING", "ON", "BCAST"};
+  std::vector<std::size_t> lengths{6, 8, 2, 5};
+  for (const auto &prefix : m_prefixes) {
+    argv.push_back("PREFIX");
+    lengths.push_back(6);
+    argv.push_back(prefix.data());
+    lengths.push_back(prefix.size());
+  }
+  reply.reset(reinterpret_cast<redisReply *>(
+      ::redisCommandArgv(ctx, static_cast<int>(argv.size()), argv.data(),
+                         lengths.data())));
+  if (reply == nullptr || reply->type == REDIS_REPLY_ERROR) {
+    logger::redis()->error("Excute command [ CLIENT TRACKING ] failed!");
+    return false;
+  }
+  return true;
+}
+
+void redis::RedisClientCache::handlePush(const redisReply *reply) {
+  /*["invalidate", [key...]], null instead of keys means FLUSHALL*/
+  if (reply->elements < 2 || reply->element[0]->str == nullptr ||
+      std::string_view(reply->element[0]->str, reply->element[0]->len) !=
+          "invalidate") {
+    return;
+  }
+
+  const redisReply *keys = reply->element[1];
+  if (keys->type != REDIS_REPLY_ARRAY) {
+    m_invalidations->inc();
+    flush();
+    return;
+  }
+  for (std::size_t i = 0; i < keys->elements; ++i) {
+    if (keys->element[i]->str != nullptr) {
+      m_invalidations->inc();
+      invalidate(
+          std::string_view(keys->element[i]->str, keys->element[i]->len));
+    }
+  }
+}
@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <config/ServerConfig.hpp>
+#include <future>
+#include <log/LogManager.hpp>
+#include <redis/RedisCluster.hpp>
+
+namespace {
+/*CRC16-CCITT(XMODEM), the checksum Redis Cluster uses for key slots*/
+constexpr std::array<std::uint16_t, 256> crc16_table = []() {
+  std::array<std::uint16_t, 256> table{};
+  for (std::uint16_t i = 0; i < 256; ++i) {
+    std::uint16_t crc = static_cast<std::uint16_t>(i << 8);
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = static_cast<std::uint16_t>(crc & 0x8000 ? (crc << 1) ^ 0x1021
+                                                    : crc << 1);
+    }
+    table[i] = crc;
+  }
+  return table;
+}();
+
+/*"host:port", empty host means the node which sent the redirection*/
+std::string resolve(std::string_view address, const std::string &from) {
+  if (!address.empty() && address.front() == ':') {
+    return from.substr(0, from.rfind(':')) + std::string(address);
+  }
+  return std::string(address);
+}
+} // namespace
+
+redis::RedisNodePool::RedisNodePool(const std::string &address,
+                                    const std::string &password)
+    : m_address(address), m_host(address.substr(0, address.rfind(':'))),
+      m_port(static_cast<unsigned short>(
+          std::stoul(address.substr(address.rfind(':') + 1)))),
+      m_password(password) {
+  /*connections are dialed by warmup() and acquire()*/
+  setFactory(
+      [this]() -> context_ptr {
+        auto ctx = std::make_unique<context>(m_host, m_port, m_password);
+        return ctx->isValid() ? std::move(ctx) : nullptr;
+      },
+      ServerConfig::get_instance()->Warmup_lazy,
+      ServerConfig::get_instance()->Warmup_minimum);
+  setHealthCheck([](context &ctx) { return ctx.isValid(); });
+  registerMetrics("redis@" + m_address);
+}
+
+redis::RedisCluster::RedisCluster(const std::string &seeds,
+                                  const std::string &password,
+                                  std::size_t max_redirects,
+                                  std::chrono::milliseconds refresh_interval)
+    : m_password(password), m_max_redirects(max_redirects),
+      m_refresh_interval(refresh_interval) {
+  std::size_t begin = 0;
+  while (begin < seeds.size()) {
+    std::size_t end = seeds.find(',', begin);
+    if (end == std::string::npos) {
+      end = seeds.size();
+    }
+    std::string address = seeds.substr(begin, end - begin);
+    address.erase(0, address.find_first_not_of(' '));
+    address.erase(address.find_last_not_of(' ') + 1);
+    begin = end + 1;
+    if (address.find(':') != std::string::npos) {
+      m_seeds.push_back(std::move(address));
+    }
+  }
+
+  auto registry = metrics::MetricsRegistry::get_instance();
+  m_moved = &registry->counter("gateway_redis_redirects_total",
+                               "Redis Cluster redirections followed",
+                               "type=\"moved\"");
+  m_asked = &registry->counter("gateway_redis_redirects_total",
+                               "Redis Cluster redirections followed",
+                               "type=\"ask\"");
+  m_refreshes = &registry->counter("gateway_redis_slot_refreshes_total",
+                                   "Reloads of the Redis Cluster slot map");
+  registry->gauge("gateway_redis_cluster_masters",
+                  "Masters owning slots of the Redis Cluster", "", [this]() {
+                    std::shared_lock<std::shared_mutex> _lckg(m_mtx);
+                    return static_cast<double>(m_masters.size());
+                  });
+}
+
+redis::RedisCluster::~RedisCluster() { shutdown(); }
+
+std::uint16_t redis::RedisCluster::slot(std::string_view key) {
+  /*{user1}:a and {user1}:b are stored on the same node*/
+  const std::size_t open = key.find('{');
+  if (open != std::string_view::npos) {
+    const std::size_t close = key.find('}', open + 1);
+    if (close != std::string_view::npos && close != open + 1) {
+      key = key.substr(open + 1, close - open - 1);
+    }
+  }
+
+  std::uint16_t crc = 0;
+  for (unsigned char c : key) {
+    crc = static_cast<std::uint16_t>((crc << 8) ^
+                                     crc16_table[((crc >> 8) ^ c) & 0xff]);
+  }
+  return crc & (slot_count - 1);
+}
+
+void redis::RedisCluster::warmup() {
+  if (!refresh()) {
+    logger::redis()->error("Redis Cluster slot map is not loaded, no seed "
+                           "node is reachable");
+    return;
+  }
+
+  std::vector<RedisNodePool *> masters;
+  {
+    std::shared_lock<std::shared_mutex> _lckg(m_mtx);
+    masters = m_masters;
+  }
+  std::vector<std::future<void>> dialers;
+  for (auto *master : masters) {
+    dialers.push_back(
+        std::async(std::launch::async, [master]() { master->warmup(); }));
+  }
+  for (auto &dialer : dialers) {
+    dialer.wait();
+  }
+}
+
+bool redis::RedisCluster::ready() {
+  std::shared_lock<std::shared_mutex> _lckg(m_mtx);
+  return !m_masters.empty() &&
+         std::all_of(m_slots.begin(), m_slots.end(),
+                     [](RedisNodePool *pool) { return pool != nullptr; }) &&
+         std::all_of(m_masters.begin(), m_masters.end(),
+                     [](RedisNodePool *pool) { return pool->ready(); });
+}
+
+void redis::RedisCluster::shutdown() {
+  std::shared_lock<std::shared_mutex> _lckg(m_mtx);
+  for (auto &[address, pool] : m_nodes) {
+    pool->shutdown();
+  }
+}
+
+void redis::RedisCluster::execute(std::string_view key, const command &send) {
+  const std::uint16_t hash = slot(key);
+  RedisNodePool *target = owner(hash);
+  bool asking = false;
+
+  for (std::size_t redirects = 0;
+       target != nullptr && redirects <= m_max_redirects; ++redirects) {
+    redisReply *reply = nullptr;
+    {
+      connection::ConnectionRAII<RedisNodePool, RedisContext> raii(target);
+      if (raii) {
+        reply = send(raii->get()->m_redisContext.get(), asking);
+      }
+    }
+    asking = false;
+
+    /*node is unreachable, one of its replicas may have been promoted*/
+    if (reply == nullptr) {
+      RedisNodePool *lost = target;
+      refreshIfDue();
+      target = owner(hash);
+      if (target == lost) {
+        return;
+      }
+      continue;
+    }
+
+    if (reply->type != REDIS_REPLY_ERROR || reply->str == nullptr) {
+      return;
+    }
+
+    /*MOVED <slot> <host:port> or ASK <slot> <host:port>*/
+    std::string_view error(reply->str, reply->len);
+    const bool moved = error.substr(0, 6) == "MOVED ";
+    if (!moved && error.substr(0, 4) != "ASK ") {
+      return;
+    }
+    const std::size_t space = error.rfind(' ');
+    RedisNodePool *redirected =
+        node(resolve(error.substr(space + 1), target->address()));
+
+    if (!moved) {
+      /*slot is being migrated, only this key has moved yet*/
+      m_asked->inc();
+      asking = true;
+    } else {
+      m_moved->inc();
+      {
+        std::unique_lock<std::shared_mutex> _lckg(m_mtx);
+        m_slots[hash] = redirected;
+      }
+
+      /*resharding usually moves more than one slot*/
+      refreshIfDue();
+    }
+    target = redirected;
+  }
+}
+
+redis::RedisNodePool *redis::RedisCluster::node(const std::string &address) {
+  {
+    std::shared_lock<std::shared_mutex> _lckg(m_mtx);
+    auto it = m_nodes.find(address);
+    if (it != m_nodes.end()) {
+      return it->second.get();
+    }
+  }
+
+  std::unique_lock<std::shared_mutex> _lckg(m_mtx);
+  auto &pool = m_nodes[address];
+  if (pool == nullptr) {
+    logger::redis()->info("Redis Cluster node {} is added", address);
+    pool = std::make_unique<RedisNodePool>(address, m_password);
+  }
+  return pool.get();
+}
+
+redis::RedisNodePool *redis::RedisCluster::owner(std::uint16_t slot) {
+  {
+    std::shared_lock<std::shared_mutex> _lckg(m_mtx);
+    if (m_slots[slot] != nullptr) {
+      return m_slots[slot];
+    }
+  }
+
+  /*map is not loaded yet, any seed redirects us to the owner*/
+  if (!m_seeds.empty()) {
+    return node(m_seeds.front());
+  }
+  return nullptr;
+}
+
+bool redis::RedisCluster::refresh() {
+  std::vector<std::string> candidates;
+  {
+    std::shared_lock<std::shared_mutex> _lckg(m_mtx);
+    for (auto *master : m_masters) {
+      candidates.push_back(master->address());
+    }
+  }
+  candidates.insert(candidates.end(), m_seeds.begin(), m_seeds.end());
+
+  for (const auto &address : candidates) {
+    tools::RedisSmartPtr<redisReply> reply;
+    {
+      connection::ConnectionRAII<RedisNodePool, RedisContext> raii(
+          node(address));
+      if (!raii) {
+        continue;
+      }
+      reply.reset(reinterpret_cast<redisReply *>(::redisCommand(
+          raii->get()->m_redisContext.get(), "CLUSTER SLOTS")));
+    }
+    if (reply == nullptr || reply->type != REDIS_REPLY_ARRAY) {
+      continue;
+    }
+
+    /*[start, end, [host, port, id], replicas...]*/
+    std::vector<RedisNodePool *> slots(slot_count, nullptr);
+    std::vector<RedisNodePool *> masters;
+    for (std::size_t i = 0; i < reply->elements; ++i) {
+      const redisReply *range = reply->element[i];
+      if (range->type != REDIS_REPLY_ARRAY || range->elements < 3 ||
+          range->element[2]->type != REDIS_REPLY_ARRAY ||
+          range->element[2]->elements < 2) {
+        continue;
+      }
+      const redisReply *master = range->element[2];
+      std::string host = master->element[0]->str != nullptr
+                             ? std::string(master->element[0]->str,
+                                           master->element[0]->len)
+                             : std::string();
+      RedisNodePool *pool = node(resolve(
+          host + ':' + std::to_string(master->element[1]->integer), address));
+      if (std::find(masters.begin(), masters.end(), pool) == masters.end()) {
+        masters.push_back(pool);
+      }
+
+      const long long first = std::max(0LL, range->element[0]->integer);
+      const long long last =
+          std::min<long long>(slot_count - 1, range->element[1]->integer);
+      for (long long slot = first; slot <= last; ++slot) {
+        slots[slot] = pool;
+      }
+    }
+    if (masters.empty()) {
+      continue;
+    }
+
+    m_refreshes->inc();
+    logger::redis()->info("Redis Cluster slot map loaded from {}, {} masters",
+                          address, masters.size());
+    std::unique_lock<std::shared_mutex> _lckg(m_mtx);
+    std::copy(slots.begin(), slots.end(), m_slots.begin());
+    m_masters = std::move(masters);
+    return true;
+  }
+  return false;
+}
+
+void redis::RedisCluster::refreshIfDue() {
+  std::unique_lock<std::mutex> _lckg(m_refresh_mtx, std::try_to_lock);
+  if (!_lckg.owns_lock()) {
+    return;
+  }
+
+  const auto now = std::chrono::steady_clock::now();
+  if (now - m_last_refresh < m_refresh_interval) {
+    return;
+  }
+  m_last_refresh = now;
+  refresh();
+}
@@ -1,32 +1,51 @@
+#include <redis/RedisClientCache.hpp>
 #include <redis/RedisContextRAII.hpp>
 #include <redis/RedisReplyRAII.hpp>
-#include <spdlog/spdlog.h>
+#include <log/LogManager.hpp>
 
 redis::RedisContext::RedisContext() noexcept
     : m_valid(false), m_redisContext(nullptr) {}
 
 redis::RedisContext::RedisContext(const std::string &ip, unsigned short port,
-                                  const std::string &password) noexcept
-    : m_valid(false), m_redisContext(redisConnect(ip.c_str(), port)) {
+                                  const std::string &password,
+                                  RedisClientCache *cache) noexcept
+    : m_valid(false), m_redisContext(redisConnect(ip.c_str(), port)),
+      m_cache(cache) {
   /*error occured*/
   if (!checkError()) {
     m_redisContext.reset();
   } else {
-    spdlog::info("Connection to Redis server success!");
+    logger::redis()->info("Connection to Redis server success!");
     checkAuth(password);
+    loadScripts();
   }
 }
 
-bool redis::RedisContext::isValid() { return m_valid; }
+redis::RedisContext::RedisContext(RedisCluster *cluster) noexcept
+    : m_valid(true), m_redisContext(nullptr), m_cluster(cluster) {}
+
+bool redis::RedisContext::isValid() {
+  /*node connections are checked by their own pools*/
+  if (m_cluster != nullptr) {
+    return m_valid;
+  }
+
+  /*hiredis sets err once the connection is lost*/
+  return m_valid && m_redisContext.get() != nullptr && !m_redisContext->err;
+}
 
 bool redis::RedisContext::setValue(const std::string &key,
                                    const std::string &value) {
   std::unique_ptr<RedisReply> m_replyDelegate = std::make_unique<RedisReply>();
   auto status = m_replyDelegate->redisCommand(*this, std::string("SET %s %s"),
                                               key.c_str(), value.c_str());
+  if (m_cache != nullptr) {
+    m_cache->invalidate(key);
+  }
   if (status) {
-    spdlog::info("Excute command [ SET key = {0}, value = {1}] successfully!",
-                 key.c_str(), value.c_str());
+    logger::redis()->debug(
+        "Excute command [ SET key = {0}, value = {1}] successfully!",
+        key.c_str(), value.c_str());
     return true;
   }
   return false;
@@ -41,9 +60,9 @@ bool redis::RedisContext::setValue2Hash(const std::string &key,
                                     key.c_str(), field.c_str(), value.c_str());
 
   if (status) {
-    spdlog::info("Excute command [ HSET key = {0}, field = {1}, value = {2}] "
-                 "successfully!",
-                 key.c_str(), field.c_str(), value.c_str());
+    logger::redis()->debug("Excute command [ HSET key = {0}, field = {1}, "
+                           "value = {2}] successfully!",
+                           key.c_str(), field.c_str(), value.c_str());
     return true;
   }
   return false;
@@ -56,12 +75,12 @@ bool redis::RedisContext::delValueFromHash(const std::string &key,
                                               key.c_str(), field.c_str());
 
   if (status) {
-    spdlog::info("Excute command [ HDEL key = {0}, field = {1}] "
-                 "successfully!",
-                 key.c_str(), field.c_str());
+    logger::redis()->debug(
+        "Excute command [ HDEL key = {0}, field = {1}] successfully!",
+        key.c_str(), field.c_str());
     return true;
   }
-  spdlog::error("The command did not execute successfully");
+  logger::redis()->error("The command did not execute successfully");
   return false;
 }
 
@@ -71,7 +90,7 @@ bool redis::RedisContext::leftPush(const std::string &key,
   auto status = m_replyDelegate->redisCommand(*this, std::string("LPUSH %s %s"),
                                               key.c_str(), value.c_str());
   if (status) {
-    spdlog::info(
+    logger::redis()->debug(
         "Excute command  [ LPUSH key = {0}, value = {1}]  successfully!",
         key.c_str(), value.c_str());
     return true;
@@ -85,7 +104,7 @@ bool redis::RedisContext::rightPush(const std::string &key,
   auto status = m_replyDelegate->redisCommand(*this, std::string("RPUSH %s %s"),
                                               key.c_str(), value.c_str());
   if (status) {
-    spdlog::info(
+    logger::redis()->debug(
         "Excute command  [ RPUSH key = {0}, value = {1}]  successfully!",
         key.c_str(), value.c_str());
     return true;
@@ -97,8 +116,13 @@ bool redis::RedisContext::delPair(const std::string &key) {
   std::unique_ptr<RedisReply> m_replyDelegate = std::make_unique<RedisReply>();
   auto status =
       m_replyDelegate->redisCommand(*this, std::string("DEL %s"), key.c_str());
+  if (m_cache != nullptr) {
+    m_cache->invalidate(key);
+  }
   if (status) {
-    spdlog::info("Excute command [ DEL key = {} ]successfully!", key.c_str());
+    logger::redis()->debug(
+        "Excute command [ DEL key = {} ]successfully!",
+        key.c_str());
     return true;
   }
   return false;
@@ -109,8 +133,9 @@ bool redis::RedisContext::existKey(const std::string &key) {
   auto status = m_replyDelegate->redisCommand(*this, std::string("exists %s"),
                                               key.c_str());
   if (status) {
-    spdlog::info("Excute command [ exists key = {}] successfully!",
-                 key.c_str());
+    logger::redis()->debug(
+        "Excute command [ exists key = {}] successfully!",
+        key.c_str());
     return true;
   }
   return false;
@@ -118,6 +143,15 @@ bool redis::RedisContext::existKey(const std::string &key) {
 
 std::optional<std::string>
 redis::RedisContext::checkValue(const std::string &key) {
+  const bool tracked = m_cache != nullptr && m_cache->covers(key);
+  std::uint64_t epoch = 0;
+  if (tracked) {
+    if (auto cached = m_cache->get(key); cached.has_value()) {
+      return cached;
+    }
+    epoch = m_cache->epoch(key);
+  }
+
   std::unique_ptr<RedisReply> m_replyDelegate = std::make_unique<RedisReply>();
   if (!m_replyDelegate->redisCommand(*this, std::string("GET %s"),
                                      key.c_str())) {
@@ -127,8 +161,15 @@ redis::RedisContext::checkValue(const std::string &key) {
       m_replyDelegate->getType().value() != REDIS_REPLY_STRING) {
     return std::nullopt;
   }
-  spdlog::info("Excute command [ GET key = %s ] successfully!", key.c_str());
-  return m_replyDelegate->getMessage();
+  logger::redis()->debug(
+      "Excute command [ GET key = {} ] successfully!",
+      key.c_str());
+
+  std::optional<std::string> value = m_replyDelegate->getMessage();
+  if (tracked && value.has_value()) {
+    m_cache->put(key, *value, epoch);
+  }
+  return value;
 }
 
 std::optional<std::string>
@@ -145,7 +186,9 @@ redis::RedisContext::leftPop(const std::string &key) {
       m_replyDelegate->getType().value() == REDIS_REPLY_NIL) {
     return std::nullopt;
   }
-  spdlog::info("Excute command [ LPOP key = {} ] successfully!", key.c_str());
+  logger::redis()->debug(
+      "Excute command [ LPOP key = {} ] successfully!",
+      key.c_str());
   return m_replyDelegate->getMessage();
 }
 
@@ -160,7 +203,9 @@ redis::RedisContext::rightPop(const std::string &key) {
       m_replyDelegate->getType().value() == REDIS_REPLY_NIL) {
     return std::nullopt;
   }
-  spdlog::info("Excute command  [ RPOP key = {}] successfully!", key.c_str());
+  logger::redis()->debug(
+      "Excute command  [ RPOP key = {}] successfully!",
+      key.c_str());
   return m_replyDelegate->getMessage();
 }
 
@@ -178,21 +223,81 @@ redis::RedisContext::getValueFromHash(const std::string &key,
     return std::nullopt;
   }
 
-  spdlog::info("Excute command [ HGET key = {0}, field = {1} ] successfully!",
-               key.c_str(), field.c_str());
+  logger::redis()->debug(
+      "Excute command [ HGET key = {0}, field = {1} ] successfully!",
+      key.c_str(), field.c_str());
   return m_replyDelegate->getMessage();
 }
 
+std::optional<long long>
+redis::RedisContext::evalInteger(const RedisScript &script,
+                                 std::string_view key,
+                                 std::initializer_list<std::string_view> args) {
+  std::vector<std::string_view> argv{"EVALSHA", script.sha(), "1", key};
+  argv.insert(argv.end(), args.begin(), args.end());
+
+  /*negative integers are valid results, only the reply type is checked*/
+  std::unique_ptr<RedisReply> m_replyDelegate = std::make_unique<RedisReply>();
+  m_replyDelegate->redisCommandArgv(*this, argv, key);
+
+  /*server restarted or SCRIPT FLUSH, EVAL caches the script again*/
+  if (m_replyDelegate->getType() == REDIS_REPLY_ERROR &&
+      m_replyDelegate->getMessage().value_or("").rfind("NOSCRIPT", 0) == 0) {
+    logger::redis()->warn("Script {} is not cached by redis, send it again",
+                          script.sha());
+    argv[0] = "EVAL";
+    argv[1] = script.source();
+    m_replyDelegate->redisCommandArgv(*this, argv, key);
+  }
+
+  if (m_replyDelegate->getType() != REDIS_REPLY_INTEGER) {
+    logger::redis()->error("Excute command [ EVALSHA key = {} ] failed!", key);
+    return std::nullopt;
+  }
+  return m_replyDelegate->getInterger();
+}
+
+std::optional<int>
+redis::RedisContext::swapValue(const std::string &key,
+                               std::string_view expected,
+                               std::string_view desired) {
+  auto res = evalInteger(scripts::compare_and_swap, key, {expected, desired});
+  if (m_cache != nullptr) {
+    m_cache->invalidate(key);
+  }
+  if (!res.has_value()) {
+    return std::nullopt;
+  }
+  logger::redis()->debug(
+      "Excute command [ compare and swap key = {} ] successfully!", key);
+  return static_cast<int>(res.value());
+}
+
+void redis::RedisContext::loadScripts() {
+  for (const RedisScript *script : RedisScript::registered()) {
+    std::unique_ptr<RedisReply> m_replyDelegate =
+        std::make_unique<RedisReply>();
+    if (!m_replyDelegate->redisCommandArgv(
+            *this, {"SCRIPT", "LOAD", script->source()}) ||
+        m_replyDelegate->getMessage() != script->sha()) {
+      /*not fatal, evalInteger falls back to EVAL*/
+      logger::redis()->warn("Excute command [ SCRIPT LOAD {} ] failed!",
+                            script->sha());
+    }
+  }
+}
+
 bool redis::RedisContext::checkError() {
   if (m_redisContext.get() == nullptr) {
-    spdlog::error("Connection to Redis server failed! No instance!");
+    logger::redis()->error("Connection to Redis server failed! No instance!");
     return m_valid; // false;
   }
 
   /*error occured*/
   if (m_redisContext->err) {
-    spdlog::error("Connection to Redis server failed! error code {}",
-                  m_redisContext->errstr);
+    logger::redis()->error(
+        "Connection to Redis server failed! error code {}",
+        m_redisContext->errstr);
     return m_valid;
   }
 
@@ -205,13 +310,13 @@ bool redis::RedisContext::checkAuth(std::string_view sv) {
   auto status =
       m_replyDelegate->redisCommand(*this, std::string("AUTH %s"), sv.data());
   if (status) {
-    spdlog::info("Excute command  [ AUTH ] successfully!");
+    logger::redis()->debug("Excute command  [ AUTH ] successfully!");
   }
   return status;
 }
 
 std::optional<tools::RedisContextWrapper> redis::RedisContext::operator->() {
-  if (isValid()) {
+  if (m_cluster == nullptr && isValid()) {
     return tools::RedisContextWrapper(m_redisContext.get());
   }
   return std::nullopt;
@@ -1,5 +1,73 @@
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <redis/RedisCluster.hpp>
 #include <redis/RedisReplyRAII.hpp>
 
+metrics::Histogram &
+redis::RedisReply::commandLatency(std::string_view command) {
+  /*every thread caches histograms it has seen, registry is locked only once*/
+  thread_local std::map<std::string, metrics::Histogram *, std::less<>> cache;
+
+  std::string_view verb = command.substr(0, command.find(' '));
+  auto it = cache.find(verb);
+  if (it != cache.end()) {
+    return *it->second;
+  }
+
+  std::string upper(verb);
+  std::transform(upper.begin(), upper.end(), upper.begin(),
+                 [](unsigned char c) { return std::toupper(c); });
+
+  auto *histogram = &metrics::MetricsRegistry::get_instance()->histogram(
+      "gateway_redis_command_duration_seconds", "Redis command latency",
+      "command=\"" + upper + "\"");
+  cache.emplace(std::string(verb), histogram);
+  return *histogram;
+}
+
+bool redis::RedisReply::redisCommandArgv(
+    RedisContext &context, const std::vector<std::string_view> &argv,
+    std::string_view key) {
+  trace::Span span("redis.command", argv.front(), trace::SpanKind::CLIENT);
+  metrics::ScopedTimer timer(commandLatency(argv.front()));
+
+  std::vector<const char *> args;
+  std::vector<std::size_t> lengths;
+  args.reserve(argv.size());
+  lengths.reserve(argv.size());
+  for (const auto &arg : argv) {
+    args.push_back(arg.data());
+    lengths.push_back(arg.size());
+  }
+
+  auto send = [&args, &lengths](redisContext *node) {
+    return ::redisCommandArgv(node, static_cast<int>(args.size()), args.data(),
+                              lengths.data());
+  };
+  if (context.m_cluster != nullptr) {
+    routeCommand(context, key, send);
+  } else {
+    m_redisReply.reset(
+        reinterpret_cast<redisReply *>(send(context.m_redisContext.get())));
+  }
+  return isSuccessful();
+}
+
+void redis::RedisReply::routeCommand(
+    RedisContext &context, std::string_view key,
+    const std::function<void *(redisContext *)> &send) {
+  context.m_cluster->execute(
+      key, [this, &send](redisContext *node, bool asking) {
+        if (asking) {
+          tools::RedisSmartPtr<redisReply> ok(reinterpret_cast<redisReply *>(
+              ::redisCommand(node, "ASKING")));
+        }
+        m_redisReply.reset(reinterpret_cast<redisReply *>(send(node)));
+        return m_redisReply.get();
+      });
+}
+
 bool redis::RedisReply::isSuccessful() const {
   if (m_redisReply.get() == nullptr) {
     return false;
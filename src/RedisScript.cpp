@@ -0,0 +1,46 @@
+#include <openssl/evp.h>
+#include <redis/RedisScript.hpp>
+
+redis::RedisScript::RedisScript(std::string_view source) : m_source(source) {
+  /*the same digest Redis uses to name cached scripts*/
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int length = 0;
+  EVP_Digest(source.data(), source.size(), digest, &length, EVP_sha1(),
+             nullptr);
+
+  static constexpr char digits[] = "0123456789abcdef";
+  m_sha.reserve(length * 2);
+  for (unsigned int i = 0; i < length; ++i) {
+    m_sha.push_back(digits[digest[i] >> 4]);
+    m_sha.push_back(digits[digest[i] & 0xf]);
+  }
+  registry().push_back(this);
+}
+
+const std::vector<const redis::RedisScript *> &
+redis::RedisScript::registered() {
+  return registry();
+}
+
+std::vector<const redis::RedisScript *> &redis::RedisScript::registry() {
+  /*constructed on first use, scripts of other files may register first*/
+  static std::vector<const RedisScript *> scripts;
+  return scripts;
+}
+
+const redis::RedisScript redis::scripts::compare_and_swap(R"(
+local value = redis.call('GET', KEYS[1])
+if not value then
+  return -1
+end
+if value ~= ARGV[1] then
+  return 0
+end
+local ttl = redis.call('PTTL', KEYS[1])
+if ttl == -1 then
+  redis.call('SET', KEYS[1], ARGV[2])
+else
+  redis.call('SET', KEYS[1], ARGV[2], 'PX', math.max(ttl, 1))
+end
+return 1
+)");
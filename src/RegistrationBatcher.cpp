@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <config/ServerConfig.hpp>
+#include <iterator>
+#include <metrics/MetricsRegistry.hpp>
+#include <sql/MySQLConnectionPool.hpp>
+#include <sql/RegistrationBatcher.hpp>
+
+mysql::RegistrationBatcher::RegistrationBatcher()
+    : m_enabled(ServerConfig::get_instance()->RegistrationBatch_enabled),
+      m_max_rows(std::max<std::size_t>(
+          1, ServerConfig::get_instance()->RegistrationBatch_max_rows)),
+      m_window(std::chrono::milliseconds(
+          ServerConfig::get_instance()->RegistrationBatch_window_ms)) {
+  auto registry = metrics::MetricsRegistry::get_instance();
+  m_batches = &registry->counter("gateway_mysql_insert_batches_total",
+                                 "Multi-row inserts of new users");
+  m_rows = &registry->counter("gateway_mysql_insert_batch_rows_total",
+                              "Rows sent by multi-row inserts of new users");
+  m_queue_wait =
+      &registry->histogram("gateway_mysql_insert_batch_wait_seconds",
+                           "Time registrations wait for their batch");
+  m_insert_latency =
+      &registry->histogram("gateway_mysql_insert_batch_seconds",
+                           "Time a multi-row insert of new users takes");
+  registry->gauge("gateway_mysql_insert_batch_pending",
+                  "Registrations queued for the next batch", "",
+                  [this]() { return static_cast<double>(pending()); });
+
+  if (m_enabled) {
+    m_thread = std::thread([this]() { run(); });
+  }
+}
+
+mysql::RegistrationBatcher::~RegistrationBatcher() { shutdown(); }
+
+void mysql::RegistrationBatcher::shutdown() {
+  {
+    std::lock_guard<std::mutex> _lckg(m_mtx);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+
+  /*queued rows are still inserted, their connections are waiting for them*/
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+bool mysql::RegistrationBatcher::enabled() const { return m_enabled; }
+
+bool mysql::RegistrationBatcher::submit(std::string username,
+                                        std::string password,
+                                        std::string email, callback done) {
+  bool wakeup = false;
+  {
+    std::lock_guard<std::mutex> _lckg(m_mtx);
+    if (!m_enabled || m_stop) {
+      return false;
+    }
+    m_queue.push_back(Pending{std::move(username), std::move(password),
+                              std::move(email), std::move(done),
+                              std::chrono::steady_clock::now()});
+
+    /*first row opens the window, a full batch closes it*/
+    wakeup = m_queue.size() == 1 || m_queue.size() >= m_max_rows;
+  }
+  if (wakeup) {
+    m_cv.notify_one();
+  }
+  return true;
+}
+
+std::size_t mysql::RegistrationBatcher::pending() {
+  std::lock_guard<std::mutex> _lckg(m_mtx);
+  return m_queue.size();
+}
+
+void mysql::RegistrationBatcher::run() {
+  for (;;) {
+    std::deque<Pending> batch;
+    {
+      std::unique_lock<std::mutex> _lckg(m_mtx);
+      m_cv.wait(_lckg, [this]() { return m_stop || !m_queue.empty(); });
+      if (m_queue.empty()) {
+        return;
+      }
+
+      /*
+       * oldest row waits at most one window for others to join, rows which
+       * queued while the last batch was written are usually late already
+       */
+      m_cv.wait_until(_lckg, m_queue.front().queued + m_window, [this]() {
+        return m_stop || m_queue.size() >= m_max_rows;
+      });
+
+      const std::size_t rows = std::min(m_queue.size(), m_max_rows);
+      batch.insert(batch.end(), std::make_move_iterator(m_queue.begin()),
+                   std::make_move_iterator(m_queue.begin() + rows));
+      m_queue.erase(m_queue.begin(), m_queue.begin() + rows);
+    }
+    insert(batch);
+  }
+}
+
+void mysql::RegistrationBatcher::insert(std::deque<Pending> &batch) {
+  const auto now = std::chrono::steady_clock::now();
+  for (const auto &row : batch) {
+    m_queue_wait->observe(now - row.queued);
+  }
+
+  std::vector<std::optional<std::size_t>> uuids(batch.size());
+  {
+    metrics::ScopedTimer timer(*m_insert_latency);
+    connection::ConnectionRAII<MySQLConnectionPool, MySQLConnection> mysql;
+    if (mysql) {
+      std::vector<MySQLRequestStruct> requests;
+      requests.reserve(batch.size());
+      for (const auto &row : batch) {
+        requests.push_back(
+            MySQLRequestStruct{row.username, row.password, row.email});
+      }
+      uuids = mysql->get()->registerNewUsers(requests);
+    }
+  }
+  m_batches->inc();
+  m_rows->inc(batch.size());
+
+  for (std::size_t i = 0; i < batch.size(); ++i) {
+    batch[i].done(uuids[i]);
+  }
+}
@@ -0,0 +1,119 @@
+#include <service/TimingWheel.hpp>
+
+connection::TimingWheel::TimingWheel(boost::asio::io_context &ioc,
+                                     std::chrono::milliseconds tick,
+                                     std::size_t slots)
+    : m_timer(ioc), m_tick(tick.count() > 0 ? tick
+                                            : std::chrono::milliseconds(1)),
+      m_slots(nullptr), m_slot_count(slots < 1 ? 1 : slots), m_cursor(0),
+      m_size(0), m_stop(true) {
+  m_slots = std::make_unique<TimerNode[]>(m_slot_count);
+  for (std::size_t i = 0; i < m_slot_count; ++i) {
+    m_slots[i].prev = m_slots[i].next = &m_slots[i];
+  }
+}
+
+connection::TimingWheel::~TimingWheel() { stop(); }
+
+void connection::TimingWheel::start() {
+  m_stop = false;
+  m_next_tick = std::chrono::steady_clock::now() + m_tick;
+  schedule();
+}
+
+void connection::TimingWheel::stop() {
+  m_stop = true;
+  m_timer.cancel();
+}
+
+void connection::TimingWheel::arm(TimerNode &node,
+                                  std::chrono::milliseconds timeout) {
+  if (node.armed()) {
+    unlink(node);
+    --m_size;
+  }
+
+  /*at least one tick, round up*/
+  std::size_t ticks = static_cast<std::size_t>(
+      (timeout.count() + m_tick.count() - 1) / m_tick.count());
+  if (ticks == 0) {
+    ticks = 1;
+  }
+
+  node.rounds = (ticks - 1) / m_slot_count;
+  link(m_slots[(m_cursor + ticks) % m_slot_count], node);
+  ++m_size;
+}
+
+void connection::TimingWheel::cancel(TimerNode &node) {
+  if (node.armed()) {
+    unlink(node);
+    --m_size;
+  }
+}
+
+std::size_t connection::TimingWheel::size() const { return m_size; }
+
+void connection::TimingWheel::schedule() {
+  m_timer.expires_at(m_next_tick);
+  m_timer.async_wait([this](boost::system::error_code ec) {
+    if (ec || m_stop) {
+      return;
+    }
+    onTick();
+  });
+}
+
+void connection::TimingWheel::onTick() {
+  /*catch up, if the io thread was blocked for several ticks*/
+  auto now = std::chrono::steady_clock::now();
+  while (m_next_tick <= now) {
+    m_cursor = (m_cursor + 1) % m_slot_count;
+    m_next_tick += m_tick;
+
+    /*
+     * move the whole slot into a local list first, callbacks are allowed to
+     * rearm or cancel any node, even into this slot
+     */
+    TimerNode pending;
+    pending.prev = pending.next = &pending;
+    splice(m_slots[m_cursor], pending);
+
+    while (pending.next != &pending) {
+      TimerNode *node = pending.next;
+      unlink(*node);
+      if (node->rounds > 0) {
+        --node->rounds;
+        link(m_slots[m_cursor], *node);
+      } else {
+        --m_size;
+        node->callback(node->owner);
+      }
+    }
+  }
+  schedule();
+}
+
+void connection::TimingWheel::link(TimerNode &head, TimerNode &node) {
+  node.prev = head.prev;
+  node.next = &head;
+  head.prev->next = &node;
+  head.prev = &node;
+}
+
+void connection::TimingWheel::splice(TimerNode &from, TimerNode &to) {
+  if (from.next == &from) {
+    return;
+  }
+  from.next->prev = &to;
+  from.prev->next = &to;
+  to.next = from.next;
+  to.prev = from.prev;
+  from.prev = from.next = &from;
+}
+
+void connection::TimingWheel::unlink(TimerNode &node) {
+  node.prev->next = node.next;
+  node.next->prev = node.prev;
+  node.prev = node.next = nullptr;
+}
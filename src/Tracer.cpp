@@ -0,0 +1,341 @@
+#include <algorithm>
+#include <config/ServerConfig.hpp>
+#include <cstring>
+#include <log/LogManager.hpp>
+#include <metrics/MetricsRegistry.hpp>
+#include <random>
+#include <trace/Tracer.hpp>
+
+namespace {
+/*innermost living span of current thread*/
+thread_local trace::Span *current_span = nullptr;
+
+uint64_t randomId() {
+  thread_local std::mt19937_64 engine(
+      std::random_device{}() ^
+      std::hash<std::thread::id>{}(std::this_thread::get_id()));
+  uint64_t id = 0;
+  while (id == 0) {
+    id = engine();
+  }
+  return id;
+}
+
+uint64_t unixNanos(std::chrono::system_clock::time_point tp) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          tp.time_since_epoch())
+          .count());
+}
+
+void writeHex(std::string &out, uint64_t value) {
+  static constexpr char digits[] = "0123456789abcdef";
+  for (int shift = 60; shift >= 0; shift -= 4) {
+    out += digits[(value >> shift) & 0xf];
+  }
+}
+
+bool readHex(std::string_view in, uint64_t &value) {
+  value = 0;
+  for (char c : in) {
+    value <<= 4;
+    if (c >= '0' && c <= '9') {
+      value |= static_cast<uint64_t>(c - '0');
+    } else if (c >= 'a' && c <= 'f') {
+      value |= static_cast<uint64_t>(c - 'a' + 10);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+void copyText(char *dst, std::size_t size, std::string_view src) {
+  std::size_t length = std::min(size - 1, src.size());
+  std::memcpy(dst, src.data(), length);
+  dst[length] = '\0';
+}
+
+/*escape span detail, it may contain url path*/
+void writeJsonString(std::string &out, const char *str) {
+  out += '"';
+  for (; *str != '\0'; ++str) {
+    unsigned char c = static_cast<unsigned char>(*str);
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += static_cast<char>(c);
+    } else if (c < 0x20) {
+      out += ' ';
+    } else {
+      out += static_cast<char>(c);
+    }
+  }
+  out += '"';
+}
+} // namespace
+
+std::string trace::SpanContext::traceparent() const {
+  std::string ret;
+  ret.reserve(55);
+  ret += "00-";
+  writeHex(ret, trace_id[0]);
+  writeHex(ret, trace_id[1]);
+  ret += '-';
+  writeHex(ret, span_id);
+  ret += sampled ? "-01" : "-00";
+  return ret;
+}
+
+std::optional<trace::SpanContext>
+trace::SpanContext::parse(std::string_view traceparent) {
+  /*version(2)-trace_id(32)-parent_id(16)-flags(2)*/
+  if (traceparent.size() != 55 || traceparent.substr(0, 3) != "00-" ||
+      traceparent[35] != '-' || traceparent[52] != '-') {
+    return std::nullopt;
+  }
+
+  SpanContext ctx;
+  uint64_t flags = 0;
+  if (!readHex(traceparent.substr(3, 16), ctx.trace_id[0]) ||
+      !readHex(traceparent.substr(19, 16), ctx.trace_id[1]) ||
+      !readHex(traceparent.substr(36, 16), ctx.span_id) ||
+      !readHex(traceparent.substr(53, 2), flags) || !ctx.valid()) {
+    return std::nullopt;
+  }
+  ctx.sampled = flags & 0x01;
+  return ctx;
+}
+
+trace::Span::Span(const char *name, std::string_view detail, SpanKind kind) {
+  if (current_span == nullptr || !current_span->m_active) {
+    return;
+  }
+
+  m_record.context.trace_id = current_span->m_record.context.trace_id;
+  m_record.parent_id = current_span->m_record.context.span_id;
+  m_record.start_ns = unixNanos(std::chrono::system_clock::now());
+  begin(name, detail, kind);
+}
+
+trace::Span::Span(root_t, const char *name, std::string_view detail,
+                  std::string_view traceparent,
+                  std::chrono::steady_clock::time_point start) {
+  auto tracer = Tracer::get_instance();
+  if (!tracer->enabled()) {
+    return;
+  }
+
+  /*parent-based sampling, follow client's decision if there is one*/
+  auto parent = SpanContext::parse(traceparent);
+  if (parent.has_value()) {
+    if (!parent->sampled) {
+      return;
+    }
+    m_record.context.trace_id = parent->trace_id;
+    m_record.parent_id = parent->span_id;
+  } else {
+    if (!tracer->sample()) {
+      return;
+    }
+    m_record.context.trace_id = {randomId(), randomId()};
+    m_record.parent_id = 0;
+  }
+
+  /*convert steady start time into unix time*/
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  m_record.start_ns = unixNanos(
+      std::chrono::system_clock::now() -
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(
+          elapsed));
+  begin(name, detail, SpanKind::SERVER);
+}
+
+void trace::Span::begin(const char *name, std::string_view detail,
+                        SpanKind kind) {
+  m_active = true;
+  m_record.context.span_id = randomId();
+  m_record.context.sampled = true;
+  m_record.kind = kind;
+  m_record.error = false;
+  copyText(m_record.name, sizeof(m_record.name), name);
+  copyText(m_record.detail, sizeof(m_record.detail), detail);
+
+  m_parent = current_span;
+  current_span = this;
+  m_attached = true;
+}
+
+void trace::Span::suspend() {
+  if (!m_attached) {
+    return;
+  }
+  current_span = m_parent;
+  m_attached = false;
+}
+
+void trace::Span::resume() {
+  if (!m_active || m_attached) {
+    return;
+  }
+  m_parent = current_span;
+  current_span = this;
+  m_attached = true;
+}
+
+trace::Span::~Span() {
+  if (!m_active) {
+    return;
+  }
+  suspend();
+  m_record.end_ns = unixNanos(std::chrono::system_clock::now());
+  Tracer::get_instance()->submit(m_record);
+}
+
+trace::Tracer::Tracer()
+    : m_enabled(ServerConfig::get_instance()->Trace_enabled),
+      m_sample_rate(ServerConfig::get_instance()->Trace_sample_rate),
+      m_flush_interval(ServerConfig::get_instance()->Trace_flush_interval_ms),
+      m_mask(0), m_enqueue(0), m_dequeue(0), m_stop(false),
+      m_exported(&metrics::MetricsRegistry::get_instance()->counter(
+          "gateway_trace_spans_exported_total", "Spans written by exporter")),
+      m_dropped(&metrics::MetricsRegistry::get_instance()->counter(
+          "gateway_trace_spans_dropped_total",
+          "Spans dropped because trace ring is full")) {
+  if (!m_enabled) {
+    return;
+  }
+
+  auto config = ServerConfig::get_instance();
+  m_file.open(config->Trace_file, std::ios::out | std::ios::app);
+  if (!m_file.is_open()) {
+    logger::LogManager::get_instance()->get(logger::Subsystem::GATEWAY)
+        ->error("Open trace file {} failed, tracing disabled",
+                config->Trace_file);
+    m_enabled = false;
+    return;
+  }
+
+  /*round capacity up to power of two*/
+  std::size_t capacity = 2;
+  while (capacity < config->Trace_ring_size) {
+    capacity <<= 1;
+  }
+  m_mask = capacity - 1;
+  m_cells = std::make_unique<Cell[]>(capacity);
+  for (std::size_t i = 0; i < capacity; ++i) {
+    m_cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  m_exporter = std::thread(&Tracer::exportLoop, this);
+}
+
+trace::Tracer::~Tracer() { shutdown(); }
+
+void trace::Tracer::shutdown() {
+  if (m_stop.exchange(true)) {
+    return;
+  }
+  m_cv.notify_all();
+  if (m_exporter.joinable()) {
+    m_exporter.join();
+  }
+}
+
+bool trace::Tracer::sample() {
+  thread_local std::mt19937_64 engine(std::random_device{}());
+  return std::uniform_real_distribution<double>(0.0, 1.0)(engine) <
+         m_sample_rate;
+}
+
+void trace::Tracer::submit(const SpanRecord &record) {
+  std::size_t pos = m_enqueue.load(std::memory_order_relaxed);
+  for (;;) {
+    Cell &cell = m_cells[pos & m_mask];
+    std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+    auto diff = static_cast<std::ptrdiff_t>(seq) -
+                static_cast<std::ptrdiff_t>(pos);
+
+    if (diff == 0) {
+      if (m_enqueue.compare_exchange_weak(pos, pos + 1,
+                                          std::memory_order_relaxed)) {
+        cell.record = record;
+        cell.sequence.store(pos + 1, std::memory_order_release);
+        return;
+      }
+    } else if (diff < 0) {
+      /*exporter is behind, never block io threads*/
+      m_dropped->inc();
+      return;
+    } else {
+      pos = m_enqueue.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void trace::Tracer::exportLoop() {
+  while (!m_stop) {
+    {
+      std::unique_lock<std::mutex> _lckg(m_mtx);
+      m_cv.wait_for(_lckg, m_flush_interval, [this]() { return m_stop.load(); });
+    }
+    drain();
+  }
+  drain();
+}
+
+void trace::Tracer::drain() {
+  /*one OTLP/JSON ExportTraceServiceRequest per line*/
+  m_batch.clear();
+  m_batch += R"({"resourceSpans":[{"resource":{"attributes":[{"key":)"
+             R"("service.name","value":{"stringValue":"gateway-server"}}]},)"
+             R"("scopeSpans":[{"scope":{"name":"gateway"},"spans":[)";
+
+  std::size_t count = 0;
+  for (;; ++m_dequeue) {
+    Cell &cell = m_cells[m_dequeue & m_mask];
+    if (cell.sequence.load(std::memory_order_acquire) != m_dequeue + 1) {
+      break;
+    }
+    const SpanRecord &rec = cell.record;
+
+    m_batch += count++ == 0 ? "{" : ",{";
+    m_batch += R"("traceId":")";
+    writeHex(m_batch, rec.context.trace_id[0]);
+    writeHex(m_batch, rec.context.trace_id[1]);
+    m_batch += R"(","spanId":")";
+    writeHex(m_batch, rec.context.span_id);
+    if (rec.parent_id != 0) {
+      m_batch += R"(","parentSpanId":")";
+      writeHex(m_batch, rec.parent_id);
+    }
+    m_batch += R"(","name":)";
+    writeJsonString(m_batch, rec.name);
+    m_batch += R"(,"kind":)";
+    m_batch += std::to_string(static_cast<int>(rec.kind));
+    m_batch += R"(,"startTimeUnixNano":")";
+    m_batch += std::to_string(rec.start_ns);
+    m_batch += R"(","endTimeUnixNano":")";
+    m_batch += std::to_string(rec.end_ns);
+    m_batch += '"';
+    if (rec.detail[0] != '\0') {
+      m_batch += R"(,"attributes":[{"key":"gateway.detail","value":)"
+                 R"({"stringValue":)";
+      writeJsonString(m_batch, rec.detail);
+      m_batch += "}}]";
+    }
+    if (rec.error) {
+      m_batch += R"(,"status":{"code":2})";
+    }
+    m_batch += '}';
+
+    cell.sequence.store(m_dequeue + m_mask + 1, std::memory_order_release);
+  }
+
+  if (count == 0) {
+    return;
+  }
+  m_batch += "]}]}]}\n";
+  m_file << m_batch;
+  m_file.flush();
+  m_exported->inc(count);
+}
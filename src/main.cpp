@@ -1,49 +1,156 @@
 #include <config/ServerConfig.hpp>
+#include <future>
 #include <grpc/BalanceServicePool.hpp>
 #include <grpc/VerificationServicePool.hpp>
+#include <handler/HandleMethod.hpp>
 #include <iostream>
+#include <log/LogManager.hpp>
 #include <redis/RedisManager.hpp>
 #include <server/GateServer.hpp>
+#include <server/ListenerHandoff.hpp>
+#include <service/CPUWorkerPool.hpp>
 #include <service/IOServicePool.hpp>
+#include <sql/AccountFilter.hpp>
 #include <sql/MySQLConnectionPool.hpp>
+#include <sql/RegistrationBatcher.hpp>
+#include <trace/Tracer.hpp>
+#include <utility>
+#include <vector>
 
 int main() {
+  int status = 0;
   try {
+    /*async loggers have to be ready before anything else logs*/
+    [[maybe_unused]] auto &log = logger::LogManager::get_instance();
+    [[maybe_unused]] auto &tracer = trace::Tracer::get_instance();
+
     /*init all kinds of pools in advance
      * 1. IOServicePool
      * 2. MySQLConnectionPool
      * 3. RedisConnectionPool
      * 4. VerificationServicePool
      * 5. BalancerServicePool
+     * 6. CPUWorkerPool
+     * 7. RegistrationBatcher
      * */
-    [[maybe_unused]] auto &service_pool = IOServicePool::get_instance();
-    [[maybe_unused]] auto &sql = mysql::MySQLConnectionPool::get_instance();
-    [[maybe_unused]] auto &redis = redis::RedisConnectionPool::get_instance();
-    [[maybe_unused]] auto &verification =
-        stubpool::VerificationServicePool::get_instance();
-    [[maybe_unused]] auto &balance =
-        stubpool::BalancerServicePool::get_instance();
+    auto &service_pool = IOServicePool::get_instance();
+    auto &sql = mysql::MySQLConnectionPool::get_instance();
+    auto &redis = redis::RedisConnectionPool::get_instance();
+    auto &verification = stubpool::VerificationServicePool::get_instance();
+    auto &balance = stubpool::BalancerServicePool::get_instance();
+    auto &cpu_pool = CPUWorkerPool::get_instance();
+    auto &batcher = mysql::RegistrationBatcher::get_instance();
 
-    /*setting up signal*/
+    /*
+     * pools dial their connections in parallel with each other, so startup
+     * takes the slowest backend's round trips instead of the sum of them.
+     * requests which arrive earlier wait inside acquire()
+     */
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::future<void>> warmups;
+    warmups.push_back(std::async(std::launch::async, [&sql]() {
+      sql->warmup();
+
+      /*usernames and emails which exist before the server starts*/
+      mysql::AccountFilter::get_instance()->load();
+    }));
+    warmups.push_back(
+        std::async(std::launch::async, [&redis]() { redis->warmup(); }));
+    warmups.push_back(std::async(std::launch::async, [&verification]() {
+      verification->warmup();
+    }));
+    warmups.push_back(
+        std::async(std::launch::async, [&balance]() { balance->warmup(); }));
+
+    /*routes and the dummy login hash, startup fails without them*/
+    [[maybe_unused]] auto &handler = HandleMethod::get_instance();
+
+    auto config = ServerConfig::get_instance();
     boost::asio::io_context ioc;
+
+    /*hot restart: take over the listening socket of the running process*/
+    ListenerHandoff handoff(ioc, config->GateServer_handoff_path);
+    std::optional<ListenerHandoff::native_handle_type> inherited =
+        handoff.receive();
+
+    auto warmed = [&warmups, start]() {
+      for (auto &warmup : warmups) {
+        warmup.get();
+      }
+      spdlog::info("Backend pools warmed up in {}ms",
+                   std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count());
+    };
+
+    std::shared_ptr<GateServer> server;
+    if (inherited.has_value()) {
+      /*
+       * previous process keeps serving until this one is warm, accepting
+       * from the shared socket earlier would park requests in our acquire()
+       */
+      warmed();
+      server = std::make_shared<GateServer>(
+          IOServicePool::get_instance()->getIOServiceContext(),
+          inherited.value());
+      server->serverStart();
+      handoff.acknowledge();
+    } else {
+      server = std::make_shared<GateServer>(
+          IOServicePool::get_instance()->getIOServiceContext(),
+          config->GateServerPort);
+      server->serverStart();
+      warmed();
+    }
+
+    /*
+     * stop accepting, let in-flight requests finish, then release pools
+     * runs on ioc, triggered by SIGINT/SIGTERM or by a finished handoff
+     */
+    bool draining = false;
+    auto drain = [&]() {
+      if (std::exchange(draining, true)) {
+        return;
+      }
+      handoff.close();
+      server->stopAccept();
+      server->drain(
+          std::chrono::milliseconds(config->GateServer_drain_timeout_ms));
+
+      /*finish queued hashes first, they post results to io threads*/
+      cpu_pool->shutdown();
+      batcher->shutdown();
+      service_pool->shutdown();
+
+      /*close idle backend connections instead of leaving them to the OS*/
+      sql->shutdown();
+      redis->shutdown();
+      verification->shutdown();
+      balance->shutdown();
+      ioc.stop();
+    };
+
+    /*setting up signal*/
     boost::asio::signal_set signal{ioc, SIGINT, SIGTERM};
-    signal.async_wait(
-        [&ioc, &service_pool](boost::system::error_code ec, int sig_number) {
-          if (ec) {
-            return;
-          }
-          service_pool->shutdown();
-          ioc.stop();
-        });
-
-    std::shared_ptr<GateServer> server = std::make_shared<GateServer>(
-        IOServicePool::get_instance()->getIOServiceContext(), // get ioc
-        ServerConfig::get_instance()->GateServerPort // get port configuration
-    );
-    server->serverStart();
+    signal.async_wait([&drain](boost::system::error_code ec, int sig_number) {
+      if (ec) {
+        return;
+      }
+      spdlog::info("Signal {} received, draining", sig_number);
+      drain();
+    });
+
+    handoff.serve(server->listener(), drain);
     ioc.run();
   } catch (const std::exception &e) {
     std::cerr << e.what() << '\n';
+    status = 1;
   }
-  return 0;
+
+  /*write remaining spans, then drain async log queue*/
+  trace::Tracer::get_instance()->shutdown();
+
+  logger::LogManager::get_instance()->shutdown();
+  spdlog::shutdown();
+  return status;
 }